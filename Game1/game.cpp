@@ -13,16 +13,9 @@ Game::Game() {
 // Destructor
 Game::~Game() {
     delete this->window;
-    // Release each map's enemy and item references
+    // Release each map, along with the enemies and items it spawned from its level manifest
     for (auto map : this->maps) {
-        // Enemies
-        for (auto enemy : *map.getEnemies()) {
-            delete enemy;
-        }
-        // Items
-        for (auto item : *map.getItems()) {
-            delete item;
-        }
+        delete map;
     }
     // Sounds
     delete this->music;
@@ -88,14 +81,14 @@ void Game::initMaps() {
     this->maps = Maps::initMaps(this->tile_size);
     // Set the current map to be the first one
     this->current_map = this->maps[this->map_index];
-    this->numCheckpoints = this->current_map.checkpointList.size();
+    this->numCheckpoints = this->current_map->checkpointList.size();
 }
 
 
 // Initialize the player
 void Game::initPlayer() {
     this->player = Player();
-    this->player.p.setMap(this->current_map);
+    this->player.p.setMap(*this->current_map);
     this->player.p.setSize((int)(this->tile_size*0.8), (int)(this->tile_size*0.8), true);
     this->player.p.setMovementKeys(sf::Keyboard::W,sf::Keyboard::A,
                                    sf::Keyboard::S, sf::Keyboard::D);
@@ -125,42 +118,42 @@ void Game::update() {
 
     if (this->player.p.onCheckpoint()) {
         this->player.p.setCheckpoint();
-        if(this->player.p.getCheckpoint().row == this->current_map.checkpointList[abs(numCheckpoints-5)].x && this->player.p.getCheckpoint().col == this->current_map.checkpointList[abs(numCheckpoints-5)].y) {
+        if(this->player.p.getCheckpoint().row == this->current_map->checkpointList[abs(numCheckpoints-5)].x && this->player.p.getCheckpoint().col == this->current_map->checkpointList[abs(numCheckpoints-5)].y) {
             numCheckpoints--;
             std::cout << numCheckpoints << std::endl;
         }
-        else if (this->player.p.getCheckpoint().row == this->current_map.checkpointList[abs(numCheckpoints-4)].x && this->player.p.getCheckpoint().col == this->current_map.checkpointList[abs(numCheckpoints-4)].y) {
+        else if (this->player.p.getCheckpoint().row == this->current_map->checkpointList[abs(numCheckpoints-4)].x && this->player.p.getCheckpoint().col == this->current_map->checkpointList[abs(numCheckpoints-4)].y) {
 
         }
         else {
-            numCheckpoints = this->current_map.checkpointList.size();
+            numCheckpoints = this->current_map->checkpointList.size();
         }
     }
 
+    // Open the door once all checkpoints are lit, and close it again if the order is broken
+    if ((numCheckpoints == 0) != this->doorOpen) {
+        this->setDoorOpen(numCheckpoints == 0);
+    }
+
     // Move enemies
-    this->current_map.moveEnemies(this->elapsed);
+    this->current_map->moveEnemies(this->elapsed);
 
     // Handle enemy collision
-    if (this->player.p.isTouchingEnemy()) {
-        for (auto enemy: this->player.p.getTouchingEnemies()) {
-            this->player.p.loseHealth(enemy->getHarm());
-        }
+    for (auto enemy: this->player.p.getTouchingEnemies()) {
+        this->player.p.loseHealth(enemy->getHarm());
     }
 
     // Handle item collision
-    if (this->player.p.isTouchingItem()) {
-        std::vector<td::Item*> touching_items = this->player.p.getTouchingItems();
-        for (auto item: touching_items) {
-            this->player.p.obtainItem(item);
-        }
+    for (auto item: this->player.p.getTouchingItems()) {
+        this->player.p.obtainItem(item);
     }
 
     // Respawn if player is dead
     if (this->player.p.isDead()) {
         lives--;
         std::cout << lives << std::endl;
-        std::vector<td::Item*> touching_items = *this->current_map.getItems();
-        this->player.p.obtainItem(touching_items[abs(lives-2)]);
+        td::View<td::Item*> life_items = this->current_map->getItemView();
+        this->player.p.obtainItem(life_items[abs(lives-2)]);
         if(lives == 0){
             this->window->close();
         }
@@ -199,32 +192,25 @@ void Game::render() {
     #endif
     this->view.reset(sf::FloatRect(0, 0, this->videoMode.width, this->videoMode.height));
     this->view.rotate(this->angle);
-    this->view.setCenter((float)(this->current_map.getMapSize().x)/2 + this->SCREEN_OFFSET,(float)(this->current_map.getMapSize().y)/2);
+    this->view.setCenter((float)(this->current_map->getMapSize().x)/2 + this->SCREEN_OFFSET,(float)(this->current_map->getMapSize().y)/2);
     this->view.zoom(0.16);
     this->window->setView(this->view);
 
     // Render the map
-    this->current_map.draw(this->window);
+    this->current_map->draw(this->window);
 
     // Mark current checkpoint
     for(int i=0; i < abs(numCheckpoints-5); i++) {
-        this->player.p.drawCP(this->window, this->current_map.checkpointList[i].y, this->current_map.checkpointList[i].x);
-    }
-
-    // Open door if all checkpoints lit
-    if(numCheckpoints == 0){
-        this->player.p.drawFileImage(this->window,5,19,"../assets/sprites/OCTR.png");
-        this->player.p.drawFileImage(this->window,6,19,"../assets/sprites/newFloor2.png");
-        this->player.p.drawFileImage(this->window,7,19,"../assets/sprites/OCBR.png");
+        this->player.p.drawCP(this->window, this->current_map->checkpointList[i].y, this->current_map->checkpointList[i].x);
     }
 
     // Render the player
     this->player.p.draw(this->window);
 
     // Render enemies
-    this->current_map.drawEnemies(this->window);
+    this->current_map->drawEnemies(this->window);
     // Render items
-    this->current_map.drawItems(this->window);
+    this->current_map->drawItems(this->window);
 
     // Display what has been rendered
     this->window->display();
@@ -264,6 +250,17 @@ void Game::loadNextMap() {
     // Get the next map
     this->current_map = this->maps[this->map_index];
     // Configure player to use the new map
-    this->player.p.setMap(this->current_map);
+    this->player.p.setMap(*this->current_map);
     this->player.p.clearInventory();
+    // The map may have been played before, with its door left open
+    this->setDoorOpen(false);
+}
+
+
+// Open or close the exit door on the right side of the current map
+void Game::setDoorOpen(bool open) {
+    this->current_map->setTile(5, 19, open ? '1' : 'r', '#');
+    this->current_map->setTile(6, 19, open ? 'f' : 'e', 'e');
+    this->current_map->setTile(7, 19, open ? '3' : 'r', '#');
+    this->doorOpen = open;
 }
@@ -18,8 +18,8 @@ private:
     float SCREEN_OFFSET;
 
     // Map
-    td::Map current_map;
-    std::vector<td::Map> maps;
+    td::Map* current_map{};
+    std::vector<td::Map*> maps;
     int map_index{};
 
     // Map config
@@ -31,6 +31,7 @@ private:
     Player player;
     int lives = 3;
     int numCheckpoints;
+    bool doorOpen{};
 
     // Fonts/text
     sf::Font font;
@@ -60,6 +61,7 @@ private:
     // Gameplay
     void pauseRespawn();
     void loadNextMap();
+    void setDoorOpen(bool open);
 
 public:
     // Constructor/destructor
@@ -1,4 +1,6 @@
 #include "Game.h"
+#include "game2_assets.hpp"
+#include "game2_maps.hpp"
 
 // Constructor
 Game::Game() {
@@ -8,24 +10,19 @@ Game::Game() {
     this->initMaps();
     this->initView();
     this->initPlayer();
+    this->initContacts();
     this->initSounds();
     this->initMenus();
+    this->initHUD();
 }
 
 
 // Destructor
 Game::~Game() {
     delete this->window;
-    // Release each map's enemy and item references
+    // Release each map, along with the enemies and items it spawned from its level manifest
     for (auto map : this->maps) {
-        // Enemies
-        for (auto enemy : *map.getEnemies()) {
-            delete enemy;
-        }
-        // Items
-        for (auto item : *map.getItems()) {
-            delete item;
-        }
+        delete map;
     }
     // Sounds
     delete this->music;
@@ -95,6 +92,10 @@ void Game::initMaps() {
     this->tile_size = 64;  // Tile size
     this->map_index = 0;   // Default is first map
 
+    // The compiled maps and the textures are built into the game. Paths under ../assets/ find them there
+    td::Embedded::mount(game2_maps::files, "../assets/");
+    td::Embedded::mount(game2_assets::files, "../assets/");
+
     // Set up the base title screen "map"
     td::SpriteSheet title_sprite_sheet = td::SpriteSheet();
     title_sprite_sheet.addSprite('H', sf::Color::Black);
@@ -112,7 +113,7 @@ void Game::initMaps() {
     title_sprite_sheet.addSprite('l', sf::Color(253, 253, 253));
     title_sprite_sheet.addSprite('m', sf::Color(255, 255, 255));
 
-    this->titleScreenBackground = td::Map("../assets/maps/title.txt");
+    this->titleScreenBackground = td::Map("../assets/maps/title.tdmap");
     this->titleScreenBackground.setTileSize(this->tile_size);
     this->titleScreenBackground.setSpriteSheet(title_sprite_sheet);
 
@@ -136,7 +137,7 @@ void Game::initView() {
 
     this->view.reset(sf::FloatRect(0, 0, this->videoMode.width, this->videoMode.height));
     this->view.rotate(this->angle);
-    this->view.setCenter((float)(this->current_map.getMapSize().x)/2 + this->SCREEN_OFFSET,(float)(this->current_map.getMapSize().y)/2);
+    this->view.setCenter((float)(this->current_map->getMapSize().x)/2 + this->SCREEN_OFFSET,(float)(this->current_map->getMapSize().y)/2);
     this->view.zoom(this->zoom);
     this->window->setView(this->view);
 }
@@ -145,7 +146,7 @@ void Game::initView() {
 // Initialize the player
 void Game::initPlayer() {
     this->player = td::Player();
-    this->player.setMap(this->current_map);
+    this->player.setMap(*this->current_map);
     this->player.setSize((int)(this->tile_size*0.7), (int)(this->tile_size*0.7), true);
     this->player.setMovementKeys(sf::Keyboard::W,sf::Keyboard::A,
                                    sf::Keyboard::S, sf::Keyboard::D);
@@ -154,6 +155,34 @@ void Game::initPlayer() {
 }
 
 
+// Initialize what happens when the player touches checkpoints, enemies, items, and the end
+void Game::initContacts() {
+    // Sweep enemies along each frame's moves, so that fast enemies can't pass through the player at low frame rates
+    this->contacts.setEnemyShape(td::ContactManifold::SWEPT_CIRCLES);
+
+    // Stepping onto a checkpoint moves the player's respawn point there. Checkpoints and the end are tile triggers,
+    // so they are only looked at when the player crosses into other tiles
+    this->triggers.addTrigger(td::TileTriggers::ENTER, td::Map::mask(td::Map::TileTypes::CHECKPOINT),
+                              [this](td::RenderObject&, const td::Tile& tile, td::TileTriggers::Phase) {
+        this->player.setCheckpoint(tile);
+    });
+    // The end is only tracked here, and checked in update once the player is known to have survived the frame
+    this->triggers.addTrigger(td::TileTriggers::ENTER, td::Map::mask(td::Map::TileTypes::END), nullptr);
+
+    // Enemies deal harm for as long as they touch the player
+    this->contacts.addEnemyListener(td::ContactManifold::ENTER | td::ContactManifold::STAY,
+                                    [this](const td::ContactManifold::Contact& contact, td::ContactManifold::Phase) {
+        this->player.loseHealth(contact.enemy->getHarm());
+    });
+
+    // Items are picked up on touch. STAY covers items that were reset under the player on a respawn
+    this->contacts.addItemListener(td::ContactManifold::ENTER | td::ContactManifold::STAY,
+                                   [this](const td::ContactManifold::Contact& contact, td::ContactManifold::Phase) {
+        this->player.obtainItem(contact.item);
+    });
+}
+
+
 // Initialize game music and sound effects
 void Game::initSounds() {
     // Game music
@@ -211,6 +240,19 @@ void Game::initMenus() {
 }
 
 
+// Initialize the HUD text, bound to the level number and fail count
+// The text is only re-formatted when one of those values changes
+void Game::initHUD() {
+    this->levelHUD = td::HUDWidget("LEVEL: ",
+                                   {.font=this->capsFont, .x=(int)(this->window->getSize().x * 0.02), .y=-5, .size=60, .align=td::Text::Align::LEFT});
+    this->levelHUD.bind(&this->map_index, 1);
+
+    this->failsHUD = td::HUDWidget("FAILS: ",
+                                   {.font=this->capsFont, .x=(int)(this->window->getSize().x * 0.98), .y=-5, .size=60, .align=td::Text::Align::RIGHT});
+    this->failsHUD.bind(&this->numDeaths);
+}
+
+
 // Update
 void Game::update() {
     this->pollEvents();  // Poll for game loop events
@@ -226,9 +268,9 @@ void Game::update() {
 
     // Handle player movement
     this->player.move(this->elapsed);
+    this->triggers.update(this->player);
 
-    if (this->player.onCheckpoint()) {
-        this->player.setCheckpoint();
+    if (this->triggers.touches(this->player, td::Map::mask(td::Map::TileTypes::CHECKPOINT))) {
         // Commit all items in the player's inventory
         // This way, it's a true checkpoint
         for (auto item : this->player.getInventory()) {
@@ -237,21 +279,11 @@ void Game::update() {
     }
 
     // Move enemies
-    this->current_map.moveEnemies(this->elapsed);
+    this->current_map->moveEnemies(this->elapsed);
 
-    // Handle enemy collision. It's important that the enemies have moved before this point
-    if (this->player.isTouchingCircleEnemy()) {
-        for (auto enemy: this->player.getTouchingCircleEnemies()) {
-            this->player.loseHealth(enemy->getHarm());
-        }
-    }
-
-    // Handle item collision
-    if (this->player.isTouchingItem()) {
-        for (auto item: this->player.getTouchingItems()) {
-            this->player.obtainItem(item);
-        }
-    }
+    // Handle enemy and item contacts, all in one pass. See initContacts.
+    // It's important that the enemies have moved before this point
+    this->contacts.update(this->player);
 
     // Respawn if player is dead
     if (this->player.isDead()) {
@@ -264,9 +296,9 @@ void Game::update() {
     }
 
     // Check if the player has reached the end goal
-    if (this->player.onEnd()) {
+    if (this->triggers.touches(this->player, td::Map::mask(td::Map::TileTypes::END))) {
         // Don't advance to the next map if the player hasn't collected all the map's coins
-        if (this->player.getInventory().size() == this->current_map.getItems()->size()) {
+        if (this->player.getInventory().size() == this->current_map->getItemView().size()) {
             this->map_index++;
             if (this->map_index >= this->maps.size()) {
                 this->state = State::WIN;
@@ -311,7 +343,7 @@ void Game::render() {
     }
 
     // Render the map
-    this->current_map.draw(this->window);
+    this->current_map->draw(this->window);
 
     // Draw the HUD
     this->drawHUD();
@@ -320,9 +352,9 @@ void Game::render() {
     this->player.draw(this->window);
 
     // Render items
-    this->current_map.drawItems(this->window);
+    this->current_map->drawItems(this->window);
     // Render enemies
-    this->current_map.drawEnemies(this->window);
+    this->current_map->drawEnemies(this->window);
 
     // Display what has been rendered
     this->window->display();
@@ -398,16 +430,18 @@ void Game::pauseRespawn() {
 void Game::loadMap(int map_idx) {
     this->mapTitleScreenSound->play();
 
-    // Get the next map
+    // Get the next map. Maps are not copied; the game plays on the map instance directly
     this->current_map = this->maps[map_idx];
 
     // Configure player to use the new map
-    this->player.setMap(this->current_map);
+    this->player.setMap(*this->current_map);
     this->player.resetInventory();
+    this->contacts.clear();
+    this->triggers.clear();
 
     // Reset map items
-    this->current_map.resetEnemies();
-    this->current_map.resetItems();
+    this->current_map->resetEnemies();
+    this->current_map->resetItems();
 
     // Display the map's title screen
     this->state = State::MAP_TITLE_SCREEN;
@@ -538,17 +572,9 @@ void Game::drawWinScreen() {
 // Render the level text, number of fails, and a button to go back to the Main Menu
 // Drawn when state is PLAYING
 void Game::drawHUD() {
-    std::stringstream ss;
-    // Print the current level number
-    ss << "LEVEL: " << this->map_index+1;
-    td::Text::print(this->window, ss.str(),
-                    {.font=this->capsFont, .x=(int)(this->window->getSize().x * 0.02), .y=-5, .size=60, .align=td::Text::Align::LEFT});
-
-    // Print the number of fails
-    ss.str(std::string());
-    ss << "FAILS: " << this->numDeaths;
-    td::Text::print(this->window, ss.str(),
-                    {.font=this->capsFont, .x=(int)(this->window->getSize().x * 0.98), .y=-5, .size=60, .align=td::Text::Align::RIGHT});
+    // Print the current level number and the number of fails
+    this->levelHUD.draw(this->window);
+    this->failsHUD.draw(this->window);
 
     // Draw the "MENU" button
     this->mainMenuButton.drawMenu();
@@ -34,9 +34,13 @@ class Game {
         td::ClickableMenu muteButton;
         td::ClickableMenu levelSelectMenu;
 
+        // HUD
+        td::HUDWidget levelHUD;
+        td::HUDWidget failsHUD;
+
         // Map
-        td::Map current_map;
-        std::vector<td::Map> maps;
+        td::Map* current_map{};
+        std::vector<td::Map*> maps;
         td::Map titleScreenBackground;
         int map_index{};
 
@@ -51,6 +55,8 @@ class Game {
 
         // Gameplay
         td::Player player;
+        td::ContactManifold contacts;
+        td::TileTriggers triggers;
 
         // Fonts/text
         sf::Font regFont;
@@ -76,8 +82,10 @@ class Game {
         void initMaps();
         void initView();
         void initPlayer();
+        void initContacts();
         void initSounds();
         void initMenus();
+        void initHUD();
 
         // Game functions
         void pollEvents();
@@ -4,19 +4,8 @@
 #include <TDAHelper/library.hpp>
 
 namespace Maps {
-    static int enemy_width;
-    static int enemy_height;
-    static int enemy_harm;
-    static int coin_width;
-    static int coin_height;
-    std::vector<td::Map> initMaps(int tile_size);
+    std::vector<td::Map*> initMaps(int tile_size);
     std::vector<std::string> initTitleScreens();
-    void addEnemy(td::Map& map, const std::vector<sf::Vector2f>& waypoints,
-                  int speed = 50, bool tiles=true, int enemy_move_option = td::Enemy::MoveOptions::LOOP,
-                  int width = Maps::enemy_width, int height = Maps::enemy_height,
-                  sf::Color color = sf::Color::Blue, int harm = Maps::enemy_harm);
-    void addCoin(td::Map& map, int row, int col, int width = Maps::coin_width, int height = Maps::coin_height,
-                 sf::Color color = sf::Color::Yellow);
 };
 
 
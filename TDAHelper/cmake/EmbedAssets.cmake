@@ -0,0 +1,99 @@
+# Compile asset files (maps, level manifests, textures) into a program as constexpr data, for use with td::Embedded.
+#
+#   include(../TDAHelper/cmake/EmbedAssets.cmake)
+#   td_embed_assets(<target> <name> BASE_DIR <dir> FILES <file>...)
+#
+# Generates <name>.hpp at build time, which defines <name>::files, a table of td::EmbeddedFile whose paths are
+# relative to BASE_DIR. Include the header in exactly one source file of <target> and mount the table there:
+#
+#   #include "<name>.hpp"
+#   td::Embedded::mount(<name>::files, "../assets/");
+#
+# The header is regenerated whenever one of the files changes.
+# When run as a script (cmake -P), this file writes the header instead.
+#
+# Maps and level manifests can be compiled to .tdmap at build time first, so that the embedded copies load without
+# parsing:
+#
+#   td_compile_maps(<variable> COMPILER <tdmapc target> OUTPUT_DIR <dir> FILES <file>... [DEPENDS <file>...])
+#
+# Sets <variable> to the compiled files, OUTPUT_DIR/<file name>.tdmap, ready to be given to td_embed_assets.
+# DEPENDS lists other files the maps read, such as manifests they include.
+
+if (CMAKE_SCRIPT_MODE_FILE)
+    # Build step: write the header. Arguments: NAME, BASE_DIR, OUTPUT, and FILES (separated by |)
+    string(REPLACE "|" ";" FILES "${FILES}")
+    set(arrays "")
+    set(table "")
+    set(index 0)
+    foreach (file ${FILES})
+        file(READ "${file}" hex HEX)
+        string(LENGTH "${hex}" hex_length)
+        math(EXPR size "${hex_length} / 2")
+        string(REGEX REPLACE "(................................................)" "\\1\n        " bytes "${hex}")  # 24 bytes per line
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${bytes}")
+        file(RELATIVE_PATH path "${BASE_DIR}" "${file}")
+        string(APPEND arrays "    // ${path}\n")
+        string(APPEND arrays "    alignas(8) constexpr unsigned char file${index}[] = {\n        ${bytes}0x00\n    };\n")
+        string(APPEND table "        {\"${path}\", file${index}, ${size}},\n")
+        math(EXPR index "${index} + 1")
+    endforeach ()
+    string(TOUPPER "${NAME}_HPP" guard)
+    file(WRITE "${OUTPUT}"
+            "// Generated by td_embed_assets (TDAHelper/cmake/EmbedAssets.cmake). Do not edit.\n"
+            "#ifndef ${guard}\n#define ${guard}\n\n"
+            "#include <TDAHelper/library.hpp>\n\n"
+            "namespace ${NAME} {\n${arrays}\n"
+            "    constexpr td::EmbeddedFile files[] = {\n${table}    };\n"
+            "}\n\n#endif //${guard}\n")
+    return()
+endif ()
+
+set(TD_EMBED_ASSETS_SCRIPT ${CMAKE_CURRENT_LIST_FILE})
+
+function(td_embed_assets target name)
+    cmake_parse_arguments(EMBED "" "BASE_DIR" "FILES" ${ARGN})
+    get_filename_component(base_dir "${EMBED_BASE_DIR}" ABSOLUTE)
+    set(files "")
+    foreach (file ${EMBED_FILES})
+        get_filename_component(file "${file}" ABSOLUTE)
+        list(APPEND files "${file}")
+    endforeach ()
+    string(REPLACE ";" "|" file_args "${files}")
+
+    set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/embedded)
+    add_custom_command(
+            OUTPUT ${output_dir}/${name}.hpp
+            COMMAND ${CMAKE_COMMAND} -DNAME=${name} -DBASE_DIR=${base_dir} -DOUTPUT=${output_dir}/${name}.hpp
+                    -DFILES=${file_args} -P ${TD_EMBED_ASSETS_SCRIPT}
+            DEPENDS ${files} ${TD_EMBED_ASSETS_SCRIPT}
+            COMMENT "Embedding ${name}"
+            VERBATIM)
+    target_sources(${target} PRIVATE ${output_dir}/${name}.hpp)
+    target_include_directories(${target} PRIVATE ${output_dir})
+endfunction()
+
+function(td_compile_maps variable)
+    cmake_parse_arguments(MAPS "" "COMPILER;OUTPUT_DIR" "FILES;DEPENDS" ${ARGN})
+    set(depends "")
+    foreach (file ${MAPS_DEPENDS})
+        get_filename_component(file "${file}" ABSOLUTE)
+        list(APPEND depends "${file}")
+    endforeach ()
+
+    set(outputs "")
+    foreach (file ${MAPS_FILES})
+        get_filename_component(file "${file}" ABSOLUTE)
+        get_filename_component(name "${file}" NAME_WE)
+        set(output ${MAPS_OUTPUT_DIR}/${name}.tdmap)
+        add_custom_command(
+                OUTPUT ${output}
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${MAPS_OUTPUT_DIR}
+                COMMAND ${MAPS_COMPILER} -o ${output} ${file}
+                DEPENDS ${file} ${depends} ${MAPS_COMPILER}
+                COMMENT "Compiling ${name}.tdmap"
+                VERBATIM)
+        list(APPEND outputs ${output})
+    endforeach ()
+    set(${variable} ${outputs} PARENT_SCOPE)
+endfunction()
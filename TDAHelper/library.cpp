@@ -8,6 +8,28 @@
 
 #include "library.hpp"
 
+// Platform file mapping, used by td::MappedFile
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Vector instructions for the batched collision tests in td::Util. x86-64 always has SSE2; AVX2 is used when the
+// library is built with it (the TDAHELPER_AVX2 CMake option). Other platforms test one shape at a time
+#if defined(__AVX2__)
+#define TD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TD_SSE2
+#include <emmintrin.h>
+#endif
+
 /* Util */
 
 /**
@@ -18,7 +40,7 @@
  * @return The integer index of the value, or -1 if not found.
  */
 template<typename V>
-int td::Util::find(std::vector<V> vector, V val) {
+int td::Util::find(const std::vector<V>& vector, const V& val) {
     auto it = std::find(vector.begin(), vector.end(), val);
     if (it != vector.end()) return it - vector.begin();
     return -1;
@@ -33,7 +55,7 @@ int td::Util::find(std::vector<V> vector, V val) {
  * @return True if the map contains the key, False otherwise.
  */
 template<typename K, typename V>
-bool td::Util::keyInMap(std::map<K, V> map, K key) {
+bool td::Util::keyInMap(const std::map<K, V>& map, const K& key) {
     if (map.count(key) != 0) return true;
     return false;
 }
@@ -58,19 +80,208 @@ float td::Util::dist(float x1, float y1, float x2, float y2) {
  * @return Boolean. True = collision, False = no collision.
  */
 bool td::Util::intersects(const sf::CircleShape &circle, const sf::RectangleShape &rect) {
-    sf::Vector2f circleDistance;
-    circleDistance.x = std::abs(circle.getPosition().x - (rect.getPosition().x + rect.getSize().x/2));
-    circleDistance.y = std::abs(circle.getPosition().y - (rect.getPosition().y + rect.getSize().y/2));
+    return td::Util::intersects(td::Circle::of(circle), td::AABB::of(rect));
+}
+
+/**
+ * @brief Check if a circle and a box are colliding/intersecting, without building SFML shapes: if the point of the
+ * box nearest to the circle's center is within the radius. The batched tests use the same arithmetic, so they agree
+ * exactly.
+ * @param circle The circle.
+ * @param box The box.
+ * @return Boolean. True = collision, False = no collision.
+ */
+bool td::Util::intersects(const td::Circle& circle, const td::AABB& box) {
+    return circle.intersects(box);
+}
+
+/**
+ * @brief Check which of a batch of circles touch a box, several circles at a time.
+ * Gives the same results as testing each circle with td::Util::intersects.
+ * @param circles The circles to test.
+ * @param box The box to test them against.
+ * @param hits Set to a bitmask with one bit per circle, in order: bit i%64 of hits[i/64] is set if circle i
+ * touches the box.
+ */
+void td::Util::intersects(const td::Util::Circles& circles, const td::AABB& box, std::vector<std::uint64_t>& hits) {
+    const std::size_t count = circles.size();
+    const float* xs = circles.x.data();
+    const float* ys = circles.y.data();
+    const float* radii = circles.radius.data();
+    hits.assign((count + 63) / 64, 0);
+
+    std::size_t i = 0;
+#if defined(TD_AVX2)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 left8 = _mm256_set1_ps(box.left), top8 = _mm256_set1_ps(box.top);
+    const __m256 right8 = _mm256_set1_ps(box.right), bottom8 = _mm256_set1_ps(box.bottom);
+    for (; i+8 <= count; i+=8) {
+        __m256 x = _mm256_loadu_ps(xs + i), y = _mm256_loadu_ps(ys + i), radius = _mm256_loadu_ps(radii + i);
+        __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(left8, x), _mm256_sub_ps(x, right8)), zero);
+        __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(top8, y), _mm256_sub_ps(y, bottom8)), zero);
+        __m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 hit = _mm256_cmp_ps(distance, _mm256_mul_ps(radius, radius), _CMP_LE_OQ);
+        hits[i/64] |= (std::uint64_t)_mm256_movemask_ps(hit) << (i % 64);
+    }
+#elif defined(TD_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 left4 = _mm_set1_ps(box.left), top4 = _mm_set1_ps(box.top);
+    const __m128 right4 = _mm_set1_ps(box.right), bottom4 = _mm_set1_ps(box.bottom);
+    for (; i+4 <= count; i+=4) {
+        __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i), radius = _mm_loadu_ps(radii + i);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(left4, x), _mm_sub_ps(x, right4)), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(top4, y), _mm_sub_ps(y, bottom4)), zero);
+        __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 hit = _mm_cmple_ps(distance, _mm_mul_ps(radius, radius));
+        hits[i/64] |= (std::uint64_t)_mm_movemask_ps(hit) << (i % 64);
+    }
+#endif
+    // The rest, or all of them without vector instructions
+    for (; i<count; i++) {
+        if (td::Circle(td::Vec2(xs[i], ys[i]), radii[i]).intersects(box)) hits[i/64] |= (std::uint64_t)1 << (i % 64);
+    }
+}
+
+/**
+ * @brief Check which of a batch of rectangles overlap a box, several rectangles at a time.
+ * Gives the same results as td::AABB::intersects.
+ * @param rects The rectangles to test.
+ * @param box The box to test them against.
+ * @param hits Set to a bitmask with one bit per rectangle, in order: bit i%64 of hits[i/64] is set if rectangle i
+ * overlaps the box.
+ */
+void td::Util::intersects(const td::Util::Rects& rects, const td::AABB& box, std::vector<std::uint64_t>& hits) {
+    const std::size_t count = rects.size();
+    const float* lefts = rects.left.data();
+    const float* tops = rects.top.data();
+    const float* rights = rects.right.data();
+    const float* bottoms = rects.bottom.data();
+    hits.assign((count + 63) / 64, 0);
+
+    std::size_t i = 0;
+#if defined(TD_AVX2)
+    const __m256 left8 = _mm256_set1_ps(box.left), top8 = _mm256_set1_ps(box.top);
+    const __m256 right8 = _mm256_set1_ps(box.right), bottom8 = _mm256_set1_ps(box.bottom);
+    for (; i+8 <= count; i+=8) {
+        __m256 left = _mm256_loadu_ps(lefts + i), top = _mm256_loadu_ps(tops + i);
+        __m256 other_right = _mm256_loadu_ps(rights + i), other_bottom = _mm256_loadu_ps(bottoms + i);
+        __m256 across = _mm256_cmp_ps(_mm256_max_ps(left, left8), _mm256_min_ps(other_right, right8), _CMP_LT_OQ);
+        __m256 down = _mm256_cmp_ps(_mm256_max_ps(top, top8), _mm256_min_ps(other_bottom, bottom8), _CMP_LT_OQ);
+        hits[i/64] |= (std::uint64_t)_mm256_movemask_ps(_mm256_and_ps(across, down)) << (i % 64);
+    }
+#elif defined(TD_SSE2)
+    const __m128 left4 = _mm_set1_ps(box.left), top4 = _mm_set1_ps(box.top);
+    const __m128 right4 = _mm_set1_ps(box.right), bottom4 = _mm_set1_ps(box.bottom);
+    for (; i+4 <= count; i+=4) {
+        __m128 left = _mm_loadu_ps(lefts + i), top = _mm_loadu_ps(tops + i);
+        __m128 other_right = _mm_loadu_ps(rights + i), other_bottom = _mm_loadu_ps(bottoms + i);
+        __m128 across = _mm_cmplt_ps(_mm_max_ps(left, left4), _mm_min_ps(other_right, right4));
+        __m128 down = _mm_cmplt_ps(_mm_max_ps(top, top4), _mm_min_ps(other_bottom, bottom4));
+        hits[i/64] |= (std::uint64_t)_mm_movemask_ps(_mm_and_ps(across, down)) << (i % 64);
+    }
+#endif
+    // The rest, or all of them without vector instructions
+    for (; i<count; i++) {
+        if (td::AABB(lefts[i], tops[i], rights[i], bottoms[i]).intersects(box))
+            hits[i/64] |= (std::uint64_t)1 << (i % 64);
+    }
+}
+
+/**
+ * @brief Get which vector instructions the batched td::Util::intersects tests were built with.
+ * @return "AVX2", "SSE2", or "scalar".
+ */
+const char* td::Util::batchInstructionSet() {
+#if defined(TD_AVX2)
+    return "AVX2";
+#elif defined(TD_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
 
-    if (circleDistance.x > (rect.getSize().x/2 + circle.getRadius())) { return false; }
-    if (circleDistance.y > (rect.getSize().y/2 + circle.getRadius())) { return false; }
+/**
+ * @brief Find when a moving circle first touches a rectangle.
+ * The circle touches the rectangle while its center is inside the rectangle grown by the radius, with rounded
+ * corners. That shape is made of two boxes, the rectangle grown only sideways and only up and down, and a circle
+ * around each corner, so the contact time is the earliest time the center enters any of them.
+ * @param circle The circle at the start of the motion.
+ * @param motion How far the circle moves, relative to the rectangle.
+ * @param box The rectangle.
+ * @return The fraction of the motion, from 0 to 1, at which the circle first touches the rectangle.
+ * 0 if they touch from the start, -1 if they never touch.
+ */
+float td::Util::contactTime(const td::Circle& circle, const td::Vec2& motion, const td::AABB& box) {
+    float earliest = 2;  // Later than any contact
+    const td::Vec2& center = circle.center;
+    const float radius = circle.radius;
+
+    // The time the center enters a box, from where it crosses each pair of sides
+    auto enterBox = [&](float left, float top, float right, float bottom) {
+        float enter = 0;
+        float leave = 1;
+        const float start[2] = {center.x, center.y};
+        const float delta[2] = {motion.x, motion.y};
+        const float low[2] = {left, top};
+        const float high[2] = {right, bottom};
+        for (int axis=0; axis<2; axis++) {
+            if (delta[axis] == 0) {
+                if (start[axis] < low[axis] || start[axis] > high[axis]) return;
+                continue;
+            }
+            float cross_low = (low[axis] - start[axis]) / delta[axis];
+            float cross_high = (high[axis] - start[axis]) / delta[axis];
+            enter = std::max(enter, std::min(cross_low, cross_high));
+            leave = std::min(leave, std::max(cross_low, cross_high));
+        }
+        if (enter <= leave) earliest = std::min(earliest, enter);
+    };
+    // The time the center comes within the radius of a corner, from |offset + motion * t| = radius
+    auto enterCorner = [&](float x, float y) {
+        td::Vec2 offset = center - td::Vec2(x, y);
+        float c = offset.lengthSquared() - radius*radius;
+        if (c <= 0) {
+            earliest = 0;
+            return;
+        }
+        float a = motion.lengthSquared();
+        float half_b = offset.dot(motion);
+        if (a == 0 || half_b >= 0) return;  // Not moving, or moving away from the corner
+        float discriminant = half_b*half_b - a*c;
+        if (discriminant < 0) return;
+        float t = (-half_b - std::sqrt(discriminant)) / a;
+        if (t <= 1) earliest = std::min(earliest, t);
+    };
 
-    if (circleDistance.x <= (rect.getSize().x/2)) { return true; }
-    if (circleDistance.y <= (rect.getSize().y/2)) { return true; }
+    enterBox(box.left - radius, box.top, box.right + radius, box.bottom);
+    enterBox(box.left, box.top - radius, box.right, box.bottom + radius);
+    enterCorner(box.left, box.top);
+    enterCorner(box.right, box.top);
+    enterCorner(box.left, box.bottom);
+    enterCorner(box.right, box.bottom);
+    return earliest <= 1 ? earliest : -1;
+}
 
-    double cornerDistance_sq = std::pow((circleDistance.x - rect.getSize().x/2), 2) + std::pow((circleDistance.y - rect.getSize().y/2), 2);
+/**
+ * @brief Get the directory part of a file path, including its trailing separator.
+ * @param path A file path.
+ * @return The directory, or an empty string if the path has none.
+ */
+std::string td::Util::directoryOf(const std::string& path) {
+    std::size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
 
-    return (cornerDistance_sq <= (std::pow(circle.getRadius(), 2)));
+/**
+ * @brief Resolve a path relative to a directory. Absolute paths are returned unchanged.
+ * @param directory A directory with a trailing separator, as returned by td::Util::directoryOf.
+ * @param path The path to resolve.
+ * @return The joined path.
+ */
+std::string td::Util::joinPath(const std::string& directory, const std::string& path) {
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+    return absolute ? path : directory + path;
 }
 //------------------------------------------------------------------------------------------------------------------
 
@@ -310,6 +521,9 @@ void td::ClickableMenu::initVariables() {
     this->buttonHeight = -1;
     this->menuItems = std::vector<std::vector<std::string>>();
     this->menuItemRects = std::vector<std::vector<sf::RectangleShape>>();
+    this->menuItemTexts = std::vector<std::vector<sf::Text>>();
+    this->menuItemOutlines = std::vector<std::vector<sf::RectangleShape>>();
+    this->renderCacheDirty = true;
     this->onHoverColor = sf::Color(140, 140, 140, 100);
     this->outlineColor = sf::Color::Transparent;
     this->outlineThickness = 0;
@@ -373,13 +587,54 @@ void td::ClickableMenu::createOnHoverRectangles() {
             }
         }
     }
+    this->renderCacheDirty = true;
+}
+
+/**
+ * @brief Build the cached text and outline objects that are drawn for each menu item.
+ * Called lazily by td::ClickableMenu::drawMenu whenever the menu's items or styling have changed,
+ * so that an unchanged menu draws without re-creating any text each frame.
+ */
+void td::ClickableMenu::createRenderCache() {
+    this->menuItemTexts.clear();
+    this->menuItemOutlines.clear();
+
+    sf::Color color = this->textConfig.color;
+    for (int r=0; r<this->menuItems.size(); r++) {
+        this->menuItemTexts.emplace_back(std::vector<sf::Text>());
+        this->menuItemOutlines.emplace_back(std::vector<sf::RectangleShape>());
+        for (int c=0; c<this->menuItems[r].size(); c++) {
+            const sf::RectangleShape& rect = this->menuItemRects[r][c];
+            sf::Text text = sf::Text(sf::String(this->menuItems[r][c]), this->textConfig.font, this->textConfig.size);
+
+            // Set the text's x and y based on the hover rectangle's position
+            int text_x = (int)(rect.getPosition().x + (rect.getSize().x * 0.5) - (text.getGlobalBounds().width * 0.5));
+            int text_y = (int)(rect.getPosition().y);
+            text.setPosition((float)text_x, (float)text_y);
+
+            // Option colors carry over to later options that don't specify their own
+            if (this->optionColors.size() >= r+1 && this->optionColors[r].size() >= c+1) {
+                color = this->optionColors[r][c];
+            }
+            text.setFillColor(color);
+            this->menuItemTexts[r].emplace_back(text);
+
+            // The outline will be invisible unless an outline color is set
+            sf::RectangleShape outline = rect;
+            outline.setFillColor(sf::Color::Transparent);
+            outline.setOutlineColor(this->outlineColor);
+            outline.setOutlineThickness(1);
+            this->menuItemOutlines[r].emplace_back(outline);
+        }
+    }
+    this->renderCacheDirty = false;
 }
 
 /**
  * @brief Return the string options available in the menu.
  * @return A 2D vector containing all menu item strings.
  */
-std::vector<std::vector<std::string>> td::ClickableMenu::getMenuItems() {
+const std::vector<std::vector<std::string>>& td::ClickableMenu::getMenuItems() const {
     return this->menuItems;
 }
 
@@ -440,6 +695,7 @@ void td::ClickableMenu::setMenuItems(const std::vector<std::vector<std::string>>
  */
 void td::ClickableMenu::setTextConfig(const td::Text::Config& config) {
     this->textConfig = config;
+    this->renderCacheDirty = true;
 }
 
 /**
@@ -459,6 +715,7 @@ void td::ClickableMenu::setButtonSize(int width, int height) {
  */
 void td::ClickableMenu::setOptionColors(const std::vector<std::vector<sf::Color>>& colors) {
     this->optionColors = colors;
+    this->renderCacheDirty = true;
 }
 
 /**
@@ -477,35 +734,26 @@ void td::ClickableMenu::setOnHoverColor(sf::Color color) {
 void td::ClickableMenu::setOutline(sf::Color color, int thickness) {
     this->outlineColor = color;
     this->outlineThickness = thickness;
+    this->renderCacheDirty = true;
 }
 
 /**
  * @brief Render the menu by printing the text options and hover rectangles.
+ * The text and outline objects are cached, and are only rebuilt when the menu's items or styling change.
  */
 void td::ClickableMenu::drawMenu() {
-    for (int r=0; r<this->menuItems.size(); r++) {
-        for (int c=0; c<this->menuItems[r].size(); c++) {
-            // Get the hover rectangle
-            sf::RectangleShape rect = this->menuItemRects[r][c];
-            sf::Text text = sf::Text(sf::String(this->menuItems[r][c]), this->textConfig.font, this->textConfig.size);
-
-            // Set the text's x and y based on the hover rectangle's position
-            this->textConfig.x = (int)(rect.getPosition().x + (rect.getSize().x * 0.5) - (text.getGlobalBounds().width * 0.5));
-            this->textConfig.y = (int)(rect.getPosition().y - (text.getGlobalBounds().height * 0.5) + (text.getGlobalBounds().height * 0.5));
-
-            this->textConfig.align = td::Text::Align::LEFT;
-            if (this->optionColors.size() >= r+1 && this->optionColors[r].size() >= c+1) {
-                this->textConfig.color = this->optionColors[r][c];
-            }
-
-            // Draw the text
-            td::Text::print(this->target, this->menuItems[r][c], this->textConfig, false);
-
-            // Draw the hover rectangle. Will be invisible unless an outline is set
-            rect.setFillColor(sf::Color::Transparent);
-            rect.setOutlineColor(this->outlineColor);
-            rect.setOutlineThickness(1);
-            this->target->draw(rect);
+    if (this->renderCacheDirty) this->createRenderCache();
+
+    for (std::size_t r=0; r<this->menuItemTexts.size(); r++) {
+        for (std::size_t c=0; c<this->menuItemTexts[r].size(); c++) {
+            // Re-point the text at this menu's font, in case the menu was copied since the cache was built.
+            // This is a no-op when the font is unchanged
+            sf::Text& text = this->menuItemTexts[r][c];
+            text.setFont(this->textConfig.font);
+
+            // Draw the text, then the outline
+            this->target->draw(text);
+            this->target->draw(this->menuItemOutlines[r][c]);
         }
     }
 }
@@ -553,6 +801,547 @@ std::string td::ClickableMenu::onMouseClick() {
 //------------------------------------------------------------------------------------------------------------------
 
 
+/* HUDWidget */
+
+/**
+ * @brief HUDWidget class constructor. Default, no parameters.
+ */
+td::HUDWidget::HUDWidget() {
+    this->initVariables();
+}
+/**
+ * @brief HUDWidget class constructor.
+ * @param label Text displayed before the bound value, such as "LEVEL: ".
+ * @param config An instance of td::Text::Config defining where and how the text should be rendered.
+ * @param relativeToView A boolean telling how to process the text's x and y position.
+ * True = relative to the render target's view. False = absolute to the render target as a whole.
+ */
+td::HUDWidget::HUDWidget(const std::string& label, const td::Text::Config& config, bool relativeToView) {
+    this->initVariables();
+    this->label = label;
+    this->config = config;
+    this->relativeToView = relativeToView;
+}
+/**
+ * @brief HUDWidget class destructor.
+ */
+td::HUDWidget::~HUDWidget() = default;
+
+/**
+ * @brief Initialize the class attributes to default values.
+ */
+void td::HUDWidget::initVariables() {
+    this->binding = Binding::NONE;
+    this->int_value = nullptr;
+    this->int_offset = 0;
+    this->string_value = nullptr;
+    this->timer_value = nullptr;
+    this->last_int = 0;
+    this->last_string = "";
+    this->last_seconds = 0;
+    this->last_view_rotation = 0;
+    this->label = "";
+    this->config = {};
+    this->relativeToView = true;
+    this->format_dirty = true;
+    this->layout_dirty = true;
+}
+
+/**
+ * @brief Check whether the bound value differs from the value currently displayed.
+ * Performs only comparisons, so that an unchanged frame does no formatting or allocation.
+ * @return Boolean. True = the text needs to be re-formatted, False = the cached text is still current.
+ */
+bool td::HUDWidget::valueChanged() const {
+    switch (this->binding) {
+        case Binding::INT:
+            return (*this->int_value + this->int_offset) != this->last_int;
+        case Binding::STRING:
+            return *this->string_value != this->last_string;
+        case Binding::TIMER:
+            return (int)*this->timer_value != this->last_seconds;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Check whether the render target's view differs from the one the text was last laid out for.
+ * @param target The render target the widget is drawn on.
+ * @return Boolean. True = the text needs to be re-positioned, False = the cached position is still current.
+ */
+bool td::HUDWidget::viewChanged(const sf::RenderTarget* target) const {
+    const sf::View& view = target->getView();
+    return view.getCenter() != this->last_view_center ||
+           view.getSize() != this->last_view_size ||
+           view.getRotation() != this->last_view_rotation ||
+           view.getViewport() != this->last_viewport ||
+           target->getSize() != this->last_target_size;
+}
+
+/**
+ * @brief Re-build the widget's string from its label and bound value, and remember the value displayed.
+ */
+void td::HUDWidget::format() {
+    char buffer[32] = "";
+    switch (this->binding) {
+        case Binding::INT:
+            this->last_int = *this->int_value + this->int_offset;
+            std::snprintf(buffer, sizeof(buffer), "%d", this->last_int);
+            break;
+        case Binding::STRING:
+            this->last_string = *this->string_value;
+            break;
+        case Binding::TIMER:
+            this->last_seconds = (int)*this->timer_value;
+            std::snprintf(buffer, sizeof(buffer), "%d:%02d", this->last_seconds / 60, this->last_seconds % 60);
+            break;
+        default:
+            break;
+    }
+    std::string s = this->label;
+    s += (this->binding == Binding::STRING) ? this->last_string : std::string(buffer);
+
+    this->text.setString(s);
+    this->text.setCharacterSize(this->config.size);
+    this->text.setFillColor(this->config.color);
+    this->format_dirty = false;
+    this->layout_dirty = true;
+}
+
+/**
+ * @brief Position the text on the render target, following the same alignment rules as td::Text::print.
+ * @param target The render target the widget is drawn on.
+ */
+void td::HUDWidget::layout(const sf::RenderTarget* target) {
+    auto x = (float)this->config.x;
+    auto y = (float)this->config.y;
+    if (this->relativeToView) {
+        sf::Vector2f viewPos = target->mapPixelToCoords({(int)this->config.x, (int)this->config.y});
+        x = viewPos.x;
+        y = viewPos.y;
+    }
+
+    // Set horizontal alignment
+    if (this->config.align == td::Text::Align::LEFT) {  // Align left
+        this->text.setPosition(x, y);
+    }
+    else if (this->config.align == td::Text::Align::CENTER) {  // Center text horizontally. Ignore the x given
+        this->text.setPosition(
+                (float)((target->getView().getSize().x * 0.5) - (this->text.getLocalBounds().width * 0.5)), y);
+    }
+    else {  // Align right
+        this->text.setPosition(x - this->text.getLocalBounds().width, y);
+    }
+
+    // Remember the view this layout is valid for
+    const sf::View& view = target->getView();
+    this->last_view_center = view.getCenter();
+    this->last_view_size = view.getSize();
+    this->last_view_rotation = view.getRotation();
+    this->last_viewport = view.getViewport();
+    this->last_target_size = target->getSize();
+    this->layout_dirty = false;
+}
+
+/**
+ * @brief Bind the widget to an integer, such as a level number or a fail count.
+ * @param value A pointer to the integer to display. Must outlive the widget's binding.
+ * @param offset An amount added to the value when displayed, e.g. 1 to show a 0-based index as 1-based.
+ * Default value: 0.
+ */
+void td::HUDWidget::bind(const int* value, int offset) {
+    this->unbind();
+    this->binding = Binding::INT;
+    this->int_value = value;
+    this->int_offset = offset;
+}
+
+/**
+ * @brief Bind the widget to a string.
+ * @param value A pointer to the string to display. Must outlive the widget's binding.
+ */
+void td::HUDWidget::bind(const std::string* value) {
+    this->unbind();
+    this->binding = Binding::STRING;
+    this->string_value = value;
+}
+
+/**
+ * @brief Bind the widget to a timer, displayed as minutes and seconds (m:ss).
+ * The text is only re-formatted when the displayed second changes.
+ * @param seconds A pointer to the float number of seconds to display. Must outlive the widget's binding.
+ */
+void td::HUDWidget::bindTimer(const float* seconds) {
+    this->unbind();
+    this->binding = Binding::TIMER;
+    this->timer_value = seconds;
+}
+
+/**
+ * @brief Remove the widget's binding. The widget will then only display its label.
+ */
+void td::HUDWidget::unbind() {
+    this->binding = Binding::NONE;
+    this->int_value = nullptr;
+    this->string_value = nullptr;
+    this->timer_value = nullptr;
+    this->format_dirty = true;
+}
+
+/**
+ * @brief Set the text displayed before the bound value.
+ * @param l The label string.
+ */
+void td::HUDWidget::setLabel(const std::string& l) {
+    this->label = l;
+    this->format_dirty = true;
+}
+
+/**
+ * @brief Set the widget's text styling and position.
+ * @param c An instance of td::Text::Config.
+ */
+void td::HUDWidget::setTextConfig(const td::Text::Config& c) {
+    this->config = c;
+    this->format_dirty = true;
+}
+
+/**
+ * @brief Force the widget to re-format and re-lay out its text on the next draw.
+ */
+void td::HUDWidget::invalidate() {
+    this->format_dirty = true;
+}
+
+/**
+ * @brief Draw the widget. Re-formats the text only if the bound value changed,
+ * and re-positions it only if the text or view changed. Otherwise the cached text is drawn as is.
+ * @param target The render target on which to display the widget.
+ */
+void td::HUDWidget::draw(sf::RenderTarget* target) {
+    // Re-point the text at this widget's font, in case the widget was copied. No-op when unchanged
+    this->text.setFont(this->config.font);
+
+    if (this->format_dirty || this->valueChanged()) this->format();
+    if (this->layout_dirty || this->viewChanged(target)) this->layout(target);
+
+    target->draw(this->text);
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* Embedded */
+
+std::vector<td::Embedded::Mount> td::Embedded::mounts;
+std::mutex td::Embedded::mutex;
+
+namespace {
+    /**
+     * @brief A read-only stream buffer over memory that is not owned, such as an embedded file.
+     */
+    class EmbeddedBuffer : public std::streambuf {
+    public:
+        EmbeddedBuffer(const unsigned char* data, std::size_t size) {
+            char* begin = const_cast<char*>((const char*)data);  // Only ever read from
+            this->setg(begin, begin, begin + size);
+        }
+    };
+    /**
+     * @brief An input stream over an embedded file. Reads the file's data in place.
+     */
+    class EmbeddedStream : public std::istream {
+    private:
+        EmbeddedBuffer buffer;
+    public:
+        explicit EmbeddedStream(const td::EmbeddedFile& file) : std::istream(nullptr), buffer(file.data, file.size) {
+            this->rdbuf(&this->buffer);
+        }
+    };
+}
+
+/**
+ * @brief Make a mounted table of embedded files available to TDAHelper's loaders.
+ * Only a pointer to the table is kept, so the table must live as long as the program (as a generated table does).
+ * @param files The table of files, such as the files table of a header generated by td_embed_assets.
+ * @param count The number of files in the table.
+ * @param prefix Prepended to each file's path in the table, so that it matches the path the game loads it by.
+ * For example, with files embedded relative to the assets directory, a prefix of "../assets/" lets
+ * "../assets/maps/map1.level" find the embedded "maps/map1.level".
+ */
+void td::Embedded::mount(const td::EmbeddedFile* files, std::size_t count, const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(td::Embedded::mutex);
+    td::Embedded::mounts.push_back({files, count, prefix});
+}
+
+/**
+ * @brief Find an embedded file by path. Paths are compared after removing "." and "dir/.." parts,
+ * so paths built from a level's directory, like "../assets/maps/../textures/coin.png", are found too.
+ * @param path The path the file would be loaded from.
+ * @return A pointer to the embedded file, or nullptr if no mounted table has it.
+ */
+const td::EmbeddedFile* td::Embedded::find(const std::string& path) {
+    std::lock_guard<std::mutex> lock(td::Embedded::mutex);
+    if (td::Embedded::mounts.empty()) return nullptr;
+    std::string wanted = td::Embedded::normalize(path);
+    for (const auto& mount : td::Embedded::mounts) {
+        for (std::size_t i=0; i<mount.count; i++) {
+            if (td::Embedded::normalize(mount.prefix + mount.files[i].path) == wanted) return &mount.files[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Open a file for reading: the embedded copy if there is one, read in place, and otherwise the file on disk.
+ * @param path The path to the file.
+ * @return A binary input stream over the file. Check it with operator! to see if the file could not be opened.
+ */
+std::unique_ptr<std::istream> td::Embedded::open(const std::string& path) {
+    const td::EmbeddedFile* embedded = td::Embedded::find(path);
+    if (embedded) return std::unique_ptr<std::istream>(new EmbeddedStream(*embedded));
+    return std::unique_ptr<std::istream>(new std::ifstream(path, std::ios::binary));
+}
+
+/**
+ * @brief Load a texture from its embedded copy if there is one, and otherwise from the file on disk.
+ * @param texture The texture to load into.
+ * @param file The path to the texture file.
+ * @return Boolean. True = loaded, False = the texture could not be loaded.
+ */
+bool td::Embedded::loadTexture(sf::Texture& texture, const std::string& file) {
+    const td::EmbeddedFile* embedded = td::Embedded::find(file);
+    if (embedded) return texture.loadFromMemory(embedded->data, embedded->size);
+    return texture.loadFromFile(file);
+}
+
+/**
+ * @brief Load an image from its embedded copy if there is one, and otherwise from the file on disk.
+ * @param image The image to load into.
+ * @param file The path to the image file.
+ * @return Boolean. True = loaded, False = the image could not be loaded.
+ */
+bool td::Embedded::loadImage(sf::Image& image, const std::string& file) {
+    const td::EmbeddedFile* embedded = td::Embedded::find(file);
+    if (embedded) return image.loadFromMemory(embedded->data, embedded->size);
+    return image.loadFromFile(file);
+}
+
+/**
+ * @brief Remove the "." and "dir/.." parts of a path, and use forward slashes throughout.
+ * @param path The path to normalize.
+ * @return The normalized path. Leading ".." parts are kept.
+ */
+std::string td::Embedded::normalize(const std::string& path) {
+    std::string unified = path;
+    std::replace(unified.begin(), unified.end(), '\\', '/');
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream stream(unified);
+    while (std::getline(stream, part, '/')) {
+        if (part.empty() || part == ".") continue;
+        if (part == ".." && !parts.empty() && parts.back() != "..") parts.pop_back();
+        else parts.push_back(part);
+    }
+    std::string normalized = !unified.empty() && unified[0] == '/' ? "/" : "";
+    for (std::size_t i=0; i<parts.size(); i++) {
+        if (i > 0) normalized += '/';
+        normalized += parts[i];
+    }
+    return normalized;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* TextureCache */
+
+std::map<std::string, std::weak_ptr<sf::Texture>> td::TextureCache::textures;
+std::mutex td::TextureCache::mutex;
+
+/**
+ * @brief Get the texture for a file, loading it only if it is not already in use.
+ * @param file The string path to a texture file.
+ * @return A shared pointer to the texture.
+ */
+std::shared_ptr<sf::Texture> td::TextureCache::load(const std::string& file) {
+    std::lock_guard<std::mutex> lock(td::TextureCache::mutex);
+    std::shared_ptr<sf::Texture> texture = td::TextureCache::textures[file].lock();
+    if (!texture) {
+        texture = std::make_shared<sf::Texture>();
+        if (!td::Embedded::loadTexture(*texture, file)) {
+            td::TextureCache::textures.erase(file);
+            throw std::invalid_argument("Could not load texture at path " + file);
+        }
+        td::TextureCache::textures[file] = texture;
+    }
+    return texture;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* CollisionMask */
+
+std::map<std::tuple<std::string, int, int>, std::weak_ptr<const td::CollisionMask>> td::CollisionMask::masks;
+std::mutex td::CollisionMask::mutex;
+const std::uint8_t td::CollisionMask::DEFAULT_MIN_ALPHA;
+
+/**
+ * @brief CollisionMask class constructor. Scales the image to the given size, taking the nearest pixel, and marks
+ * each pixel solid if it is at least as opaque as min_alpha.
+ * @param image The image, usually an object's texture.
+ * @param width The mask's width, usually the object's width.
+ * @param height The mask's height, usually the object's height.
+ * @param min_alpha The least alpha of a solid pixel. Default value: 128.
+ */
+td::CollisionMask::CollisionMask(const sf::Image& image, int width, int height, std::uint8_t min_alpha) {
+    if (width < 0 || height < 0) {
+        throw std::invalid_argument("The size of a collision mask cannot be negative");
+    }
+    this->width = width;
+    this->height = height;
+    this->words = (width + 63) / 64;
+    this->rows.assign((std::size_t)this->words * height, 0);
+
+    sf::Vector2u image_size = image.getSize();
+    const sf::Uint8* pixels = image.getPixelsPtr();
+    if (image_size.x == 0 || image_size.y == 0 || pixels == nullptr) return;
+    for (int y=0; y<height; y++) {
+        std::size_t image_y = (std::size_t)(((std::uint64_t)y * 2 + 1) * image_size.y / ((std::uint64_t)height * 2));
+        const sf::Uint8* image_row = pixels + image_y * image_size.x * 4;
+        std::uint64_t* row = this->rows.data() + (std::size_t)y * this->words;
+        for (int x=0; x<width; x++) {
+            std::size_t image_x = (std::size_t)(((std::uint64_t)x * 2 + 1) * image_size.x / ((std::uint64_t)width * 2));
+            if (image_row[image_x * 4 + 3] >= min_alpha) row[x >> 6] |= (std::uint64_t)1 << (x & 63);
+        }
+    }
+}
+
+/**
+ * @brief Get the mask for a texture file at a size, building it only if it is not already in use.
+ * @param file The string path to a texture file.
+ * @param width The mask's width.
+ * @param height The mask's height.
+ * @return A shared pointer to the mask.
+ */
+std::shared_ptr<const td::CollisionMask> td::CollisionMask::load(const std::string& file, int width, int height) {
+    std::lock_guard<std::mutex> lock(td::CollisionMask::mutex);
+    std::tuple<std::string, int, int> key(file, width, height);
+    std::shared_ptr<const td::CollisionMask> mask = td::CollisionMask::masks[key].lock();
+    if (!mask) {
+        sf::Image image;
+        if (!td::Embedded::loadImage(image, file)) {
+            td::CollisionMask::masks.erase(key);
+            throw std::invalid_argument("Could not load texture at path " + file);
+        }
+        mask = std::make_shared<const td::CollisionMask>(image, width, height);
+        td::CollisionMask::masks[key] = mask;
+    }
+    return mask;
+}
+
+/**
+ * @brief Get the mask's width.
+ * @return The width in pixels.
+ */
+int td::CollisionMask::getWidth() const {
+    return this->width;
+}
+
+/**
+ * @brief Get the mask's height.
+ * @return The height in pixels.
+ */
+int td::CollisionMask::getHeight() const {
+    return this->height;
+}
+
+/**
+ * @brief Check if a pixel of the mask is solid.
+ * @param x The pixel's column.
+ * @param y The pixel's row.
+ * @return Boolean. True = solid, False = clear or outside of the mask.
+ */
+bool td::CollisionMask::isSet(int x, int y) const {
+    if (x < 0 || y < 0 || x >= this->width || y >= this->height) return false;
+    return (this->rows[(std::size_t)y * this->words + (x >> 6)] >> (x & 63)) & 1;
+}
+
+/**
+ * @brief Get 64 pixels of a row as one word, which may straddle two of the row's words.
+ * @param row The row.
+ * @param first The column of the first pixel, which is put in the lowest bit. Pixels outside of the mask are clear.
+ * @return The pixels.
+ */
+std::uint64_t td::CollisionMask::bits(int row, int first) const {
+    if (first <= -64 || first >= this->words * 64) return 0;
+    int word = first >= 0 ? first / 64 : -1;
+    int shift = first - word * 64;
+    const std::uint64_t* data = this->rows.data() + (std::size_t)row * this->words;
+    std::uint64_t low = word >= 0 ? data[word] : 0;
+    if (shift == 0) return low;
+    std::uint64_t high = word + 1 < this->words ? data[word + 1] : 0;
+    return (low >> shift) | (high << (64 - shift));
+}
+
+/**
+ * @brief Check if any solid pixel of this mask lies on a solid pixel of another.
+ * Only the rows and words where the two masks meet are tested.
+ * @param other The other mask.
+ * @param dx The other mask's column offset from this one, in pixels.
+ * @param dy The other mask's row offset from this one, in pixels.
+ * @return Boolean. True = the masks overlap, False = they do not.
+ */
+bool td::CollisionMask::overlaps(const td::CollisionMask& other, int dx, int dy) const {
+    int first_row = std::max(0, dy);
+    int last_row = std::min(this->height, dy + other.height);
+    int first_column = std::max(0, dx);
+    int last_column = std::min(this->width, dx + other.width);
+    if (first_row >= last_row || first_column >= last_column) return false;
+
+    int first_word = first_column / 64;
+    int last_word = (last_column - 1) / 64;
+    for (int y=first_row; y<last_row; y++) {
+        const std::uint64_t* row = this->rows.data() + (std::size_t)y * this->words;
+        for (int word=first_word; word<=last_word; word++) {
+            if (row[word] & other.bits(y - dy, word * 64 - dx)) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Check if any solid pixel of the mask lies in a box, for objects that have no mask of their own.
+ * @param left The box's first column, in pixels from the mask's left edge.
+ * @param top The box's first row, in pixels from the mask's top edge.
+ * @param right The column just past the box.
+ * @param bottom The row just past the box.
+ * @return Boolean. True = the mask has a solid pixel in the box, False = it does not.
+ */
+bool td::CollisionMask::overlaps(int left, int top, int right, int bottom) const {
+    left = std::max(0, left);
+    top = std::max(0, top);
+    right = std::min(this->width, right);
+    bottom = std::min(this->height, bottom);
+    if (left >= right || top >= bottom) return false;
+
+    int first_word = left / 64;
+    int last_word = (right - 1) / 64;
+    for (int y=top; y<bottom; y++) {
+        const std::uint64_t* row = this->rows.data() + (std::size_t)y * this->words;
+        for (int word=first_word; word<=last_word; word++) {
+            // The columns of the box within this word
+            int from = std::max(left - word * 64, 0);
+            int to = std::min(right - word * 64, 64);
+            std::uint64_t columns = (to == 64 ? ~(std::uint64_t)0 : ((std::uint64_t)1 << to) - 1) &
+                                    ~(((std::uint64_t)1 << from) - 1);
+            if (row[word] & columns) return true;
+        }
+    }
+    return false;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
 /* SpriteSheet */
 
 /**
@@ -560,13 +1349,10 @@ std::string td::ClickableMenu::onMouseClick() {
  */
 td::SpriteSheet::SpriteSheet() = default;
 /**
- * @brief SpriteSheet class destructor. Frees each sprite's texture pointer.
+ * @brief SpriteSheet class destructor. Textures are shared between copies of the sheet,
+ * and are freed along with the last copy.
  */
-td::SpriteSheet::~SpriteSheet() {
-    for (auto const& key_val : this->mapping) {
-        delete key_val.second.getTexture();
-    }
-}
+td::SpriteSheet::~SpriteSheet() = default;
 
 /**
  * @brief Add a sprite to the sprite sheet. Creates a sprite with the given color and maps it to the given ID.
@@ -585,13 +1371,11 @@ void td::SpriteSheet::addSprite(char id, sf::Color color) {
  * @param file The sprite's texture. This takes precedence over any color given previously.
  */
 void td::SpriteSheet::addTexture(char id, const std::string& file) {
-    auto* texture = new sf::Texture();
-    if (!texture->loadFromFile(file)) {
-        throw std::invalid_argument("Could not load texture at path " + file);
-    }
+    std::shared_ptr<sf::Texture> texture = td::TextureCache::load(file);
     sf::RectangleShape rect;
-    rect.setTexture(texture);
+    rect.setTexture(texture.get());
     this->mapping[id] = rect;
+    this->textures.emplace_back(texture);
 }
 //------------------------------------------------------------------------------------------------------------------
 
@@ -635,12 +1419,13 @@ sf::RectangleShape td::Tile::getRect(int tile_size) const {
  * @param tile_size The tile size to use when getting the tile's bounding rectangle.
  * @return The RectangleShape that underlies the tile's sprite.
  */
-sf::RectangleShape td::Tile::getSprite(td::SpriteSheet& sprite_sheet, int tile_size) const {
+sf::RectangleShape td::Tile::getSprite(const td::SpriteSheet& sprite_sheet, int tile_size) const {
     sf::RectangleShape t = this->getRect(tile_size);
     // If the tile's sprite ID is mapped to a sprite, draw it
     // Otherwise, skip this tile and draw nothing (a transparent rect)
-    if (td::Util::keyInMap(sprite_sheet.mapping, this->sprite_id)) {
-        sf::RectangleShape sprite = sprite_sheet.mapping[this->sprite_id];
+    auto it = sprite_sheet.mapping.find(this->sprite_id);
+    if (it != sprite_sheet.mapping.end()) {
+        const sf::RectangleShape& sprite = it->second;
         if(sprite.getTexture() == nullptr) {
             t.setFillColor(sprite.getFillColor());
             return t;
@@ -664,95 +1449,645 @@ sf::Vector2i td::Tile::getPosition(int tile_size) const {
 //------------------------------------------------------------------------------------------------------------------
 
 
-/* Map */
+/* SpatialGrid */
 
 /**
- * @brief Map class constructor. Default, no parameters.
+ * @brief Get the cell under a point, clamped to the grid.
+ * @param x The point's x position.
+ * @param y The point's y position.
+ * @return The cell's index.
  */
-td::Map::Map() {
-    this->initVariables();
+int td::SpatialGrid::cellAt(float x, float y) const {
+    // Clamp while still in floats, so points far off the grid can not overflow the conversion to int
+    auto row = (int)std::min((float)(this->rows - 1), std::max(0.f, std::floor(y / this->cell_size)));
+    auto col = (int)std::min((float)(this->cols - 1), std::max(0.f, std::floor(x / this->cell_size)));
+    return row * this->cols + col;
 }
+
 /**
- * @brief Map class constructor.
- * @param path The string path to a map file txt.
- */
-td::Map::Map(const std::string& path) {
-    this->initVariables();
-    this->readMap(path);
+ * @brief Empty the grid and size it to cover an area.
+ * @param area The width and height of the area to cover, in pixels. Objects may still lie outside of it.
+ * @param size The width and height of a cell, in pixels. A cell a little larger than the objects works well.
+ * @param count The number of object ids to make room for.
+ */
+void td::SpatialGrid::reset(const sf::Vector2i& area, float size, std::size_t count) {
+    if (size <= 0)
+        throw std::invalid_argument("Spatial grid cell size must be positive.");
+    this->cell_size = size;
+    this->rows = std::max(1, (int)std::ceil((float)area.y / size));
+    this->cols = std::max(1, (int)std::ceil((float)area.x / size));
+    this->cells.assign((std::size_t)this->rows * this->cols, std::vector<std::uint32_t>());
+    this->slots.assign(count, Slot());
+    this->max_size = sf::Vector2f();
 }
+
 /**
- * @brief Map class destructor.
+ * @brief Remove every object, keeping the grid's size.
  */
-td::Map::~Map() = default;
+void td::SpatialGrid::clear() {
+    for (auto& cell : this->cells) cell.clear();
+    for (auto& slot : this->slots) slot = Slot();
+    this->max_size = sf::Vector2f();
+}
 
 /**
- * @brief Initialize map attributes to defaults.
- * Defines a default mapping of certain chars to tile types.
+ * @brief Add an object to the grid, or move it if it is already there.
+ * @param id The object's id, below the count given to reset().
+ * @param bounds The object's bounding box.
  */
-void td::Map::initVariables() {
-    this->tile_size = td::Tile::DEFAULT_TILE_SIZE;
-    this->max_allowed_tile_size = 1000;
-    this->tile_types = {
-            {td::Map::TileTypes::WALL, {'w'}},
-            {td::Map::TileTypes::START, {'s'}},
-            {td::Map::TileTypes::CHECKPOINT, {'c'}},
-            {td::Map::TileTypes::END, {'e'}},
-            {td::Map::TileTypes::DOOR, {'d'}},
-            {td::Map::TileTypes::KEY, {'k'}}
-    };
-    this->player_start_row = 0;
-    this->player_start_col = 0;
+void td::SpatialGrid::place(std::uint32_t id, const sf::FloatRect& bounds) {
+    if (id >= this->slots.size())
+        throw std::invalid_argument("Spatial grid id " + std::to_string(id) + " is out of range.");
+    this->max_size.x = std::max(this->max_size.x, bounds.width);
+    this->max_size.y = std::max(this->max_size.y, bounds.height);
+
+    int cell = this->cellAt(bounds.left, bounds.top);
+    Slot& slot = this->slots[id];
+    if (slot.cell == cell) return;
+    if (slot.cell >= 0) this->remove(id);
+    slot.cell = cell;
+    slot.index = (std::uint32_t)this->cells[cell].size();
+    this->cells[cell].push_back(id);
+}
+
+/**
+ * @brief Remove an object from the grid.
+ * @param id The object's id.
+ */
+void td::SpatialGrid::remove(std::uint32_t id) {
+    if (id >= this->slots.size() || this->slots[id].cell < 0) return;
+    Slot& slot = this->slots[id];
+    std::vector<std::uint32_t>& cell = this->cells[slot.cell];
+
+    // Move the cell's last object into the removed object's place
+    cell[slot.index] = cell.back();
+    this->slots[cell.back()].index = slot.index;
+    cell.pop_back();
+    slot = Slot();
+}
+
+/**
+ * @brief Find the objects that may overlap a bounding box.
+ * Every object that overlaps the box is found, along with some that are merely close to it.
+ * @param bounds The bounding box to look around.
+ * @param ids Object ids are appended to this vector, grouped by cell.
+ */
+void td::SpatialGrid::query(const sf::FloatRect& bounds, std::vector<std::uint32_t>& ids) const {
+    if (this->cells.empty()) return;
+
+    // An object is kept in the cell under its top-left corner, so look as far back as the largest object reaches
+    int first = this->cellAt(bounds.left - this->max_size.x, bounds.top - this->max_size.y);
+    int last = this->cellAt(bounds.left + bounds.width, bounds.top + bounds.height);
+    for (int row=first/this->cols; row<=last/this->cols; row++) {
+        for (int col=first%this->cols; col<=last%this->cols; col++) {
+            const std::vector<std::uint32_t>& cell = this->cells[row * this->cols + col];
+            ids.insert(ids.end(), cell.begin(), cell.end());
+        }
+    }
+}
+
+/**
+ * @brief Get the number of object ids the grid has room for.
+ * @return The count given to reset().
+ */
+std::size_t td::SpatialGrid::size() const {
+    return this->slots.size();
+}
+
+/**
+ * @brief Get the width and height of a cell.
+ * @return The cell size, in pixels.
+ */
+float td::SpatialGrid::getCellSize() const {
+    return this->cell_size;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* SweepAndPrune */
+
+/**
+ * @brief Sort the boxes by their left edge. An insertion sort, so boxes that kept their order cost one comparison
+ * each, and a box that moved past a few others costs a few moves. When the boxes are far out of order, such as
+ * after many were added at once, it gives up and sorts them from scratch instead.
+ */
+void td::SweepAndPrune::sort() {
+    const std::size_t count = this->boxes.size();
+    std::size_t budget = 4 * count + 64;  // Moves allowed before sorting from scratch is cheaper
+    for (std::size_t i=1; i<count; i++) {
+        if (this->boxes[i-1].left <= this->boxes[i].left) continue;
+        Box box = this->boxes[i];
+        std::size_t j = i;
+        for (; j>0 && this->boxes[j-1].left > box.left; j--) this->boxes[j] = this->boxes[j-1];
+        this->boxes[j] = box;
+        if (i - j > budget) {
+            std::stable_sort(this->boxes.begin(), this->boxes.end(),
+                             [](const Box& a, const Box& b) { return a.left < b.left; });
+            break;
+        }
+        budget -= i - j;
+    }
+    for (std::size_t i=0; i<count; i++) this->slots[this->boxes[i].id] = (std::int32_t)i;
+}
+
+/**
+ * @brief Remove every object, and make room for a number of object ids. Which groups collide is kept.
+ * @param count The number of object ids to make room for.
+ */
+void td::SweepAndPrune::reset(std::size_t count) {
+    this->boxes.clear();
+    this->slots.assign(count, -1);
+}
+
+/**
+ * @brief Remove every object, keeping the room for object ids and which groups collide.
+ */
+void td::SweepAndPrune::clear() {
+    this->boxes.clear();
+    std::fill(this->slots.begin(), this->slots.end(), -1);
+}
+
+/**
+ * @brief Set whether objects of two groups are reported as pairs. No groups collide until they are set to.
+ * @param group_a The first group, from 0 to MAX_GROUPS - 1.
+ * @param group_b The second group. May be the same as the first, for objects of a group to collide with each other.
+ * @param collide Boolean. True = report pairs between the groups, False = do not. Default value: true.
+ */
+void td::SweepAndPrune::setGroupsCollide(int group_a, int group_b, bool collide) {
+    if (group_a < 0 || group_a >= td::SweepAndPrune::MAX_GROUPS || group_b < 0 ||
+        group_b >= td::SweepAndPrune::MAX_GROUPS)
+        throw std::invalid_argument("Sweep and prune groups must be from 0 to " +
+                                    std::to_string(td::SweepAndPrune::MAX_GROUPS - 1) + ".");
+    if (collide) {
+        this->group_masks[group_a] |= (std::uint32_t)1 << group_b;
+        this->group_masks[group_b] |= (std::uint32_t)1 << group_a;
+    } else {
+        this->group_masks[group_a] &= ~((std::uint32_t)1 << group_b);
+        this->group_masks[group_b] &= ~((std::uint32_t)1 << group_a);
+    }
+}
+
+/**
+ * @brief Check whether objects of two groups are reported as pairs.
+ * @param group_a The first group.
+ * @param group_b The second group.
+ * @return Boolean. True = the groups collide, False = they do not, or a group is out of range.
+ */
+bool td::SweepAndPrune::groupsCollide(int group_a, int group_b) const {
+    if (group_a < 0 || group_a >= td::SweepAndPrune::MAX_GROUPS || group_b < 0 ||
+        group_b >= td::SweepAndPrune::MAX_GROUPS) return false;
+    return ((this->group_masks[group_a] >> group_b) & 1) != 0;
+}
+
+/**
+ * @brief Add an object, or move it if it has already been added. The boxes are sorted again when pairs are found.
+ * @param id The object's id, below the count given to reset().
+ * @param bounds The object's bounding box.
+ * @param group The object's group, from 0 to MAX_GROUPS - 1.
+ */
+void td::SweepAndPrune::place(std::uint32_t id, const sf::FloatRect& bounds, int group) {
+    if (id >= this->slots.size())
+        throw std::invalid_argument("Sweep and prune id " + std::to_string(id) + " is out of range.");
+    if (group < 0 || group >= td::SweepAndPrune::MAX_GROUPS)
+        throw std::invalid_argument("Sweep and prune groups must be from 0 to " +
+                                    std::to_string(td::SweepAndPrune::MAX_GROUPS - 1) + ".");
+    if (this->slots[id] < 0) {
+        this->slots[id] = (std::int32_t)this->boxes.size();
+        this->boxes.emplace_back();
+    }
+    Box& box = this->boxes[this->slots[id]];
+    box.left = bounds.left;
+    box.right = bounds.left + bounds.width;
+    box.top = bounds.top;
+    box.bottom = bounds.top + bounds.height;
+    box.id = id;
+    box.group = group;
+}
+
+/**
+ * @brief Remove an object.
+ * @param id The object's id.
+ */
+void td::SweepAndPrune::remove(std::uint32_t id) {
+    if (id >= this->slots.size() || this->slots[id] < 0) return;
+    auto index = (std::size_t)this->slots[id];
+    this->boxes.erase(this->boxes.begin() + (long)index);
+    for (std::size_t i=index; i<this->boxes.size(); i++) this->slots[this->boxes[i].id] = (std::int32_t)i;
+    this->slots[id] = -1;
+}
+
+/**
+ * @brief Find every pair of objects whose boxes overlap and whose groups collide.
+ * The boxes are sorted by their left edge, then each box is compared with the boxes that start before it ends.
+ * Costs about one comparison per box, plus one per box that overlaps another along x.
+ * Like sf::FloatRect::intersects, boxes that only share an edge do not overlap.
+ * @param pairs Set to the pairs of object ids, each pair once with the lower id first, in no particular order.
+ */
+void td::SweepAndPrune::findPairs(std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs) {
+    pairs.clear();
+    this->sort();
+    const std::size_t count = this->boxes.size();
+    for (std::size_t i=0; i<count; i++) {
+        const Box& a = this->boxes[i];
+        std::uint32_t mask = this->group_masks[a.group];
+        if (mask == 0) continue;
+        for (std::size_t j=i+1; j<count && this->boxes[j].left < a.right; j++) {
+            const Box& b = this->boxes[j];
+            if (((mask >> b.group) & 1) == 0) continue;
+            if (b.left < b.right && std::max(a.top, b.top) < std::min(a.bottom, b.bottom))
+                pairs.emplace_back(std::min(a.id, b.id), std::max(a.id, b.id));
+        }
+    }
+}
+
+/**
+ * @brief Get the number of object ids there is room for.
+ * @return The count given to reset().
+ */
+std::size_t td::SweepAndPrune::size() const {
+    return this->slots.size();
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* WorkerPool */
+
+/**
+ * @brief WorkerPool class constructor. Starts the worker threads, which sleep until a job is run.
+ * @param worker_count The number of threads to start. The thread running a job helps with it, so a pool with no
+ * workers runs each job on the calling thread.
+ */
+td::WorkerPool::WorkerPool(std::size_t worker_count) {
+    this->workers.reserve(worker_count);
+    for (std::size_t i=0; i<worker_count; i++) {
+        this->workers.emplace_back(&td::WorkerPool::workerLoop, this);
+    }
+}
+
+/**
+ * @brief WorkerPool class destructor. Wakes the workers and waits for them to exit.
+ */
+td::WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto& worker : this->workers) worker.join();
+}
+
+/**
+ * @brief Take the current job's next task, if it has one left, and run it with the lock released.
+ * @param lock A lock on the pool's mutex, held on entry and on return.
+ * @return Boolean. True = a task was run, False = the job has no tasks left to take.
+ */
+bool td::WorkerPool::runNext(std::unique_lock<std::mutex>& lock) {
+    if (this->task == nullptr || this->next_task >= this->task_count) return false;
+    std::size_t index = this->next_task++;
+    const std::function<void(std::size_t)>& job = *this->task;
+    lock.unlock();
+    job(index);
+    lock.lock();
+    if (--this->unfinished == 0) this->done.notify_all();
+    return true;
+}
+
+/**
+ * @brief The worker threads' loop: sleep until there is a task to take, then run tasks until the job runs out.
+ */
+void td::WorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->wake.wait(lock, [this] {
+            return this->stopping || (this->task != nullptr && this->next_task < this->task_count);
+        });
+        if (this->stopping) return;
+        while (this->runNext(lock)) {}
+    }
+}
+
+/**
+ * @brief Run a job: call a function once for each task number from 0 to count - 1, spread between the workers
+ * and the calling thread. Returns once every task has finished.
+ * @param count The number of tasks.
+ * @param job A function taking a task number.
+ */
+void td::WorkerPool::run(std::size_t count, const std::function<void(std::size_t)>& job) {
+    if (this->workers.empty() || count <= 1) {
+        for (std::size_t i=0; i<count; i++) job(i);
+        return;
+    }
+    std::lock_guard<std::mutex> serial(this->running);
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->task = &job;
+    this->task_count = count;
+    this->next_task = 0;
+    this->unfinished = count;
+    this->wake.notify_all();
+
+    // Help until the tasks run out, then wait for the ones the workers took
+    while (this->runNext(lock)) {}
+    this->done.wait(lock, [this] { return this->unfinished == 0; });
+    this->task = nullptr;
+}
+
+/**
+ * @brief Get the number of worker threads, not counting the thread that runs a job.
+ * @return The worker count given to the constructor.
+ */
+std::size_t td::WorkerPool::getWorkerCount() const {
+    return this->workers.size();
+}
+
+/**
+ * @brief Get the pool shared by the engine, with one worker per hardware thread other than the caller's.
+ * Started the first time it is asked for, so programs that never need it start no threads.
+ * @return A reference to the shared pool.
+ */
+td::WorkerPool& td::WorkerPool::shared() {
+    static td::WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* Map */
+
+/**
+ * @brief Map class constructor. Default, no parameters.
+ */
+td::Map::Map() {
+    this->initVariables();
+}
+/**
+ * @brief Map class constructor.
+ * @param path The string path to a map file txt.
+ */
+td::Map::Map(const std::string& path) {
+    this->initVariables();
+    this->readMap(path);
+}
+/**
+ * @brief Map class constructor. Creates a new level instance that shares an existing level template.
+ * Only the template's reference count is touched; no tiles are copied.
+ * @param level_template The level template to play on.
+ */
+td::Map::Map(std::shared_ptr<const td::LevelTemplate> level_template) {
+    this->initVariables();
+    this->level = std::move(level_template);
+    this->checkpointList = this->level->checkpoints;
+}
+/**
+ * @brief Map class copy constructor. Creates a new level instance with its own copies of the entities that the
+ * other map spawned (see td::Map::operator=).
+ * @param other The map to copy.
+ */
+td::Map::Map(const td::Map& other) : td::MapState(other) {
+    this->cloneSpawnedEntities(other);
+}
+/**
+ * @brief Map class destructor.
+ */
+td::Map::~Map() = default;
+
+/**
+ * @brief Make this map a copy of another. The level template is shared, so no tiles are copied.
+ * The entities spawned by the other map are cloned, and the clones are placed on this map, so the two maps play
+ * independently. Enemies and items added with td::Map::addEnemy and td::Map::addItem belong to the caller, and
+ * are shared between the two maps as they are.
+ * Tile listeners are not copied, since they usually refer to the map they were added to: this map's listeners are
+ * removed, and a copy starts with none.
+ * @param other The map to copy.
+ * @return This map.
+ */
+td::Map& td::Map::operator=(const td::Map& other) {
+    if (this == &other) return *this;
+    td::MapState::operator=(other);
+    this->tile_listeners.clear();
+    this->cloneSpawnedEntities(other);
+    return *this;
+}
+
+/**
+ * @brief Clone the entities spawned by another map, place the clones on this map, and point this map's entity
+ * lists at the clones instead of the originals.
+ * @param other The map whose entities to clone. This map's entity lists must be copies of the other map's.
+ */
+void td::Map::cloneSpawnedEntities(const td::Map& other) {
+    this->enemy_grid_dirty = true;
+    this->item_grid_dirty = true;
+    this->spawned_enemies.reset();
+    this->spawned_items.reset();
+    if (other.spawned_enemies) {
+        this->spawned_enemies.reset(new std::vector<td::Enemy>(*other.spawned_enemies));
+        const td::Enemy* first = other.spawned_enemies->data();
+        const td::Enemy* last = first + other.spawned_enemies->size();
+        for (auto& enemy : this->enemies) {
+            if (!std::less<const td::Enemy*>()(enemy, first) && std::less<const td::Enemy*>()(enemy, last))
+                enemy = this->spawned_enemies->data() + (enemy - first);
+        }
+        for (auto& enemy : *this->spawned_enemies) enemy.setMap(*this);
+    }
+    if (other.spawned_items) {
+        this->spawned_items.reset(new std::vector<td::Item>(*other.spawned_items));
+        const td::Item* first = other.spawned_items->data();
+        const td::Item* last = first + other.spawned_items->size();
+        for (auto& item : this->items) {
+            if (!std::less<const td::Item*>()(item, first) && std::less<const td::Item*>()(item, last))
+                item = this->spawned_items->data() + (item - first);
+        }
+        for (auto& item : *this->spawned_items) item.setMap(*this);
+    }
+}
+
+/**
+ * @brief Initialize map attributes to defaults.
+ * Defines a default mapping of certain chars to tile types.
+ */
+void td::Map::initVariables() {
+    this->level = std::make_shared<td::LevelTemplate>();
     this->enemies = std::vector<td::Enemy*>();
     this->items = std::vector<td::Item*>();
 }
 
 /**
- * @brief Read in a file path for the game map txt and translate it to a 2D vector of Tile objects.
+ * @brief Get a writable reference to the map's level template.
+ * If the template is shared with other maps, it is copied first so that the edit only affects this map.
+ * @return The map's own level template.
+ */
+td::LevelTemplate& td::Map::editLevel() {
+    if (this->level.use_count() > 1) {
+        this->level = std::make_shared<td::LevelTemplate>(*this->level);
+    }
+    return const_cast<td::LevelTemplate&>(*this->level);
+}
+
+/**
+ * @brief Get the bitmask for a tile type, for use with mask-based queries such as td::Map::collides.
+ * Masks may be combined with bitwise OR to query several tile types at once.
+ * @param type Integer tile type between 0 and td::Map::MAX_TILE_TYPE, likely from the td::Map::TileTypes enum.
+ * @return The tile type's bitmask.
+ */
+td::Map::TileMask td::Map::mask(int type) {
+    return (TileMask)1 << type;
+}
+
+/**
+ * @brief Look up a tile type by its name in the td::Map::TileTypes enum (WALL, START, CHECKPOINT, END, DOOR, KEY),
+ * or by number for custom tile types.
+ * @param name The tile type's name or number.
+ * @return The tile type, or -1 if the name is not recognized.
+ */
+int td::Map::tileTypeFromName(const std::string& name) {
+    static const std::map<std::string, int> names = {
+            {"WALL", td::Map::TileTypes::WALL},
+            {"START", td::Map::TileTypes::START},
+            {"CHECKPOINT", td::Map::TileTypes::CHECKPOINT},
+            {"END", td::Map::TileTypes::END},
+            {"DOOR", td::Map::TileTypes::DOOR},
+            {"KEY", td::Map::TileTypes::KEY}
+    };
+    auto it = names.find(name);
+    if (it != names.end()) return it->second;
+    if (name.empty() || name.size() > 2 || name.find_first_not_of("0123456789") != std::string::npos) return -1;
+    int type = std::stoi(name);
+    return type <= td::Map::MAX_TILE_TYPE ? type : -1;
+}
+
+/**
+ * @brief Read in a file path for the game map txt and translate it to a grid of tiles.
  * Effectively creates a tile grid out of the txt file.
  * Reads in the map two characters at a time, where the first char is interpreted as a sprite_id and the second
  * is interpreted as a type_id. The sprite_id governs appearance, and the type_id governs functionality.
- * @param path The string path to a map file txt.
+ * Each distinct (sprite_id, type_id) pair is stored once in the map's palette, and the grid itself is a single
+ * row-major array of palette indices.
+ * A compiled .tdmap path is loaded with td::MapFile::load instead, replacing the map's tile types and tile size
+ * with the ones compiled into the file. A .level manifest path reads the map file the manifest names, with its
+ * tile size and tile types applied on top, even over a compiled map's; see td::LevelManifest.
+ * @param path The string path to a map file txt, a compiled .tdmap file, or a .level manifest.
  */
 void td::Map::readMap(const std::string &path) {
-    // Read in a file
-    std::ifstream mapFile;
-    mapFile.open(path);
-
-    // Boolean to enforce that only one start tile is specified in the map
-    bool start_tile_set = false;
+    // The spatial grids are sized to the map
+    this->enemy_grid_dirty = true;
+    this->item_grid_dirty = true;
+    this->tile_revision++;
+
+    if (td::LevelManifest::isManifest(path)) {
+        this->readManifest(path);
+        return;
+    }
+    // Compiled maps are mapped into memory rather than parsed
+    if (td::MapFile::isCompiled(path)) {
+        this->level = td::MapFile::load(path);
+        this->checkpointList = this->level->checkpoints;
+        return;
+    }
 
-    // Create the raw map from the supplied map file
-    // Also create the game's tile map with encoded information
+    // Read in a file, or its embedded copy
+    std::unique_ptr<std::istream> mapFile = td::Embedded::open(path);
+    if (!*mapFile)
+        throw std::invalid_argument("Could not load map at path " + path);
+
+    // Start from an empty grid
+    td::LevelTemplate& level = this->editLevel();
+    level.tiles.clear();
+    level.external_tiles = nullptr;
+    level.backing.reset();
+    level.palette.clear();
+    level.checkpoints.clear();
+    level.rooms.clear();
+    level.rows = 0;
+    level.cols = 0;
+
+    // Palette index for each (sprite_id, type_id) pair seen so far
+    std::vector<int> palette_lookup(1 << 16, -1);
+
+    // Create the game's tile grid with encoded information
     std::string line;
     int r = 0;
-    while (std::getline(mapFile, line)) {
-        this->map_raw.emplace_back(std::vector<char>());
-        this->map.emplace_back(std::vector<td::Tile>());
+    while (std::getline(*mapFile, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();  // Tolerate Windows line endings
+        if (line.length() % 2 != 0)
+            throw std::invalid_argument("Map row " + std::to_string(r) + " has an odd number of characters.");
+        if (r == 0)
+            level.cols = (int)line.length()/2;
+        else if ((int)line.length()/2 != level.cols)
+            throw std::invalid_argument("Map row " + std::to_string(r) + " does not match the width of the first row.");
+
         for (int c=0; c<line.length(); c+=2) {
             char sprite_id = line[c];
             char type_id = line[c+1];
-            this->map_raw[r].emplace_back(sprite_id);
-            this->map_raw[r].emplace_back(type_id);
 
-            // Make a tile at this location
-            td::Tile tile = td::Tile(sprite_id, type_id, r, (int)c/2);
-            // Check if this is a starting tile. If so, mark it. Only one start tile allowed
-            if (td::Util::find(this->getTileType(td::Map::TileTypes::START), type_id) != -1) {
-                if (start_tile_set)
-                    throw std::invalid_argument("Multiple starting positions given. Only one allowed.");
-                this->player_start_row = r;
-                this->player_start_col = (int)c/2;
-                start_tile_set = true;
-            }
-            if (td::Util::find(this->getTileType(td::Map::TileTypes::CHECKPOINT), type_id) != -1) {
-                this->checkpointList.emplace_back(r,c/2);
+            // Find or add the palette entry for this tile
+            int key = ((unsigned char)sprite_id << 8) | (unsigned char)type_id;
+            if (palette_lookup[key] == -1) {
+                palette_lookup[key] = (int)level.palette.size();
+                level.palette.push_back({sprite_id, type_id});
             }
-
-            this->map[r].emplace_back(tile);
+            level.tiles.push_back((TileIndex)palette_lookup[key]);
         }
         r++;
     }
-    mapFile.close();
+    level.rows = r;
+    level.findSpecialTiles();
+    level.rebuildTypeIndex();
+    level.mergeTiles();
+    this->checkpointList = level.checkpoints;
+}
+
+/**
+ * @brief Read in a level manifest: the map file it names, plus its tile types, sprites, and entity definitions.
+ * The entities are not created until td::Map::spawnEntities is called.
+ * @param path The string path to a .level manifest.
+ */
+void td::Map::readManifest(const std::string& path) {
+    td::LevelManifest manifest = td::LevelManifest(path);
+    if (manifest.tiles.empty() || td::LevelManifest::isManifest(manifest.tiles))
+        throw std::invalid_argument("Level manifest at path " + path + " must name a map file with 'tiles'.");
+
+    // Tile types decide where the start tile and checkpoints are, so they are set before the tiles are read
+    auto applySettings = [this, &manifest]() {
+        if (manifest.tile_size > 0) this->setTileSize(manifest.tile_size);
+        for (const auto& type : manifest.tile_types) {
+            this->setTileType(type.first, type.second);
+        }
+    };
+    applySettings();
+    std::string tiles_path = td::Util::joinPath(manifest.base_dir, manifest.tiles);
+    this->readMap(tiles_path);
+
+    // A compiled map replaces the level, along with its tile size and types, so the manifest's go on top of it
+    bool recompute_special = false;
+    if (td::MapFile::isCompiled(tiles_path)) {
+        applySettings();
+        recompute_special = !manifest.tile_types.empty();
+    }
+
+    td::LevelTemplate& level = this->editLevel();
+    if (recompute_special) level.findSpecialTiles();
+    if (!manifest.checkpoint_order.empty()) {
+        if (manifest.checkpoint_order.size() != level.checkpoints.size())
+            throw std::invalid_argument("Level manifest at path " + path + " orders " +
+                                        std::to_string(manifest.checkpoint_order.size()) + " checkpoints, but the map has " +
+                                        std::to_string(level.checkpoints.size()) + ".");
+        std::vector<sf::Vector2f> ordered;
+        for (int index : manifest.checkpoint_order) {
+            if (index < 0 || index >= (int)level.checkpoints.size())
+                throw std::invalid_argument("Level manifest at path " + path + " orders checkpoint " +
+                                            std::to_string(index) + ", which does not exist.");
+            ordered.push_back(level.checkpoints[index]);
+        }
+        level.checkpoints = ordered;
+    }
+    level.entities = std::move(manifest.entities);
+    level.waypoints = std::move(manifest.waypoints);
+    level.strings = std::move(manifest.strings);
+    level.base_dir = manifest.base_dir;
+    if (!manifest.sprites.empty()) {
+        level.sprites = std::move(manifest.sprites);
+        level.buildSpriteSheet();
+    }
+    this->checkpointList = level.checkpoints;
 }
 
 /**
@@ -760,10 +2095,30 @@ void td::Map::readMap(const std::string &path) {
  * @param target An SFML RenderTarget on which to draw the map.
  */
 void td::Map::draw(sf::RenderTarget* target) {
-    for (const auto& row : this->map) {
-        for (const auto& tile : row) {
-            // Create the corresponding graphical tile and display it
-            target->draw(tile.getSprite(this->sprite_sheet, this->tile_size));
+    const td::LevelTemplate& level = *this->level;
+    auto tile_size = (float)level.tile_size;
+    sf::RectangleShape quad;
+    for (const auto& rects : level.tile_rects) {
+        for (const auto& rect : rects) {
+            // Tiles whose sprite ID is not mapped to a sprite are transparent, so they are skipped
+            auto it = level.sprite_sheet.mapping.find(level.palette[rect.tile].sprite_id);
+            if (it == level.sprite_sheet.mapping.end()) continue;
+
+            // A solid color is drawn as one quad over the whole rectangle
+            if (it->second.getTexture() == nullptr) {
+                if (it->second.getFillColor().a == 0) continue;
+                quad.setPosition((float)rect.col * tile_size, (float)rect.row * tile_size);
+                quad.setSize({(float)rect.cols * tile_size, (float)rect.rows * tile_size});
+                quad.setFillColor(it->second.getFillColor());
+                target->draw(quad);
+                continue;
+            }
+            // Textures repeat on every tile
+            for (int r=rect.row; r<rect.row+rect.rows; r++) {
+                for (int c=rect.col; c<rect.col+rect.cols; c++) {
+                    target->draw(this->getTileAt(r, c).getSprite(level.sprite_sheet, level.tile_size));
+                }
+            }
         }
     }
 }
@@ -793,7 +2148,7 @@ void td::Map::drawItems(sf::RenderTarget *target) {
  * @return Int tile size.
  */
 int td::Map::getTileSize() const {
-    return this->tile_size;
+    return this->level->tile_size;
 }
 
 /**
@@ -802,188 +2157,2892 @@ int td::Map::getTileSize() const {
  * @param y The tile's y position.
  * @return The tile at the x any y location.
  */
-td::Tile td::Map::getTile(float x, float y) {
-    int r = (int)(y/(float)this->tile_size);
-    int c = (int)(x/(float)this->tile_size);
-    return this->map[r][c];
+td::Tile td::Map::getTile(float x, float y) const {
+    int r = (int)(y/(float)this->level->tile_size);
+    int c = (int)(x/(float)this->level->tile_size);
+    return this->getTileAt(r, c);
+}
+
+/**
+ * @brief Retrieve the tile at a given row and column. O(1) index into the map's grid.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @return The tile at the row and column.
+ */
+td::Tile td::Map::getTileAt(int row, int col) const {
+    const PaletteEntry& entry = this->level->palette[this->level->tileData()[row * this->level->cols + col]];
+    return {entry.sprite_id, entry.type_id, row, col};
+}
+
+/**
+ * @brief Retrieve the palette index stored at a given row and column.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @return An index into the map's palette. See td::Map::getPaletteEntry.
+ */
+td::Map::TileIndex td::Map::getTileIndex(int row, int col) const {
+    return this->level->tileData()[row * this->level->cols + col];
+}
+
+/**
+ * @brief Look up the (sprite_id, type_id) pair for a palette index.
+ * @param index A palette index, such as one returned by td::Map::getTileIndex.
+ * @return The palette entry at that index.
+ */
+const td::Map::PaletteEntry& td::Map::getPaletteEntry(td::Map::TileIndex index) const {
+    return this->level->palette[index];
+}
+
+/**
+ * @brief Check whether a row and column lie within the map.
+ * @param row The row to check.
+ * @param col The column to check.
+ * @return Boolean. True = the tile exists, False = the row or column is off the map.
+ */
+bool td::Map::inBounds(int row, int col) const {
+    return row >= 0 && row < this->level->rows && col >= 0 && col < this->level->cols;
+}
+
+/**
+ * @brief Get the number of rectangles the map's tiles were merged into. See td::LevelTemplate::mergeTiles.
+ * @return The number of merged rectangles.
+ */
+std::size_t td::Map::getMergedRectCount() const {
+    return this->level->rect_count;
+}
+
+/**
+ * @brief Get how well the map's tiles merged into rectangles: the number of tiles per rectangle.
+ * Collision checks and drawing look at rectangles rather than tiles, so higher is faster.
+ * @return The number of tiles divided by the number of merged rectangles, or 0 for an empty map.
+ */
+float td::Map::getMergeRatio() const {
+    if (this->level->rect_count == 0) return 0;
+    return (float)this->level->rows * (float)this->level->cols / (float)this->level->rect_count;
 }
 
 /**
- * @brief Return a copy of the map.
- * @return A copy of the working Map object.
+ * @brief Build a 2D copy of the map's tiles. The map itself is stored as a flat grid, so this allocates
+ * every row. Prefer td::Map::getTileAt for individual tiles.
+ * @return A 2D vector of the map's tiles, indexed by row and then column.
  */
 std::vector<std::vector<td::Tile>> td::Map::getMap() {
-    return this->map;
+    std::vector<std::vector<td::Tile>> map_copy = std::vector<std::vector<td::Tile>>(this->level->rows);
+    for (int r=0; r<this->level->rows; r++) {
+        map_copy[r].reserve(this->level->cols);
+        for (int c=0; c<this->level->cols; c++) {
+            map_copy[r].emplace_back(this->getTileAt(r, c));
+        }
+    }
+    return map_copy;
+}
+
+/**
+ * @brief View the whole tile grid without copying it.
+ * The grid is row-major: the tile at (row, col) is at index row * columns + col.
+ * @return A view of every tile's palette index. See td::Map::getPaletteEntry.
+ */
+td::View<td::Map::TileIndex> td::Map::getGrid() const {
+    return {this->level->tileData(), (std::size_t)this->level->rows * this->level->cols};
+}
+
+/**
+ * @brief View a single row of the tile grid without copying it.
+ * @param row The row to view.
+ * @return A view of the row's palette indices, one per column.
+ */
+td::View<td::Map::TileIndex> td::Map::getRow(int row) const {
+    return {this->level->tileData() + (std::size_t)row * this->level->cols, (std::size_t)this->level->cols};
+}
+
+/**
+ * @brief View the map's palette of distinct (sprite_id, type_id) pairs.
+ * @return A view of the palette, indexed by the values stored in the grid.
+ */
+td::View<td::Map::PaletteEntry> td::Map::getPalette() const {
+    return this->level->palette;
 }
 
 /**
  * @brief Get the char tile type_ids from an integer tile type.
  * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
- * @return A vector of the corresponding tile type chars.
+ * @return A reference to the corresponding tile type chars. Empty if the type has no chars mapped to it.
  */
-std::vector<char> td::Map::getTileType(int type) {
-    return this->tile_types[type];
+const std::vector<char>& td::Map::getTileType(int type) const {
+    static const std::vector<char> no_type_ids;
+    auto it = this->level->tile_types.find(type);
+    if (it == this->level->tile_types.end()) return no_type_ids;
+    return it->second;
 }
 
 /**
- * @brief Get player starting row and column.
- * @return The player's starting tile, as specified in the loaded in map file.
+ * @brief Get the bitmask of tile types that a type_id char belongs to. O(1) table lookup.
+ * @param type_id The tile's type_id char.
+ * @return A bitmask with a bit set for each tile type the char is mapped to. See td::Map::mask.
  */
-td::Tile td::Map::getPlayerStartTile() {
-    return this->map[this->player_start_row][this->player_start_col];
+td::Map::TileMask td::Map::getTypeMask(char type_id) const {
+    return this->level->type_masks[(unsigned char)type_id];
 }
 
 /**
- * @brief Get map size. In pixels by default.
- * @param rows_cols Boolean to overwrite the default and instead return the map's number of rows and columns.
- * Default value: false.
- * @return The map's size in pixels, or in number of rows can columns depending on the value of rows_cols.
+ * @brief Check if a type_id char belongs to a given tile type. O(1) table lookup.
+ * @param type_id The tile's type_id char.
+ * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
+ * @return Boolean. True = the char is mapped to the tile type, False = it is not.
  */
-sf::Vector2i td::Map::getMapSize(bool rows_cols) {
-    int num_rows = this->map.size();
-    int num_cols = this->map[0].size();
-    if (rows_cols)
-        return {num_cols, num_rows};
-    else
-        return {num_cols * this->tile_size, num_rows * this->tile_size};
+bool td::Map::isType(char type_id, int type) const {
+    return (this->level->type_masks[(unsigned char)type_id] & td::Map::mask(type)) != 0;
 }
 
 /**
- * @brief Get the map's enemies.
- * @return A vector of pointers to the maps' Enemy objects.
+ * @brief Get player starting row and column.
+ * @return The player's starting tile, as specified in the loaded in map file.
  */
-std::vector<td::Enemy*>* td::Map::getEnemies() {
-    return &this->enemies;
+td::Tile td::Map::getPlayerStartTile() const {
+    return this->getTileAt(this->level->player_start_row, this->level->player_start_col);
 }
 
 /**
- * @brief Get the map's items.
- * @return A vector of pointers to the maps' Item objects.
+ * @brief Check that a tile type is kept in a level's tile type position index.
+ * @param level The level to check.
+ * @param type Integer tile type.
+ */
+static void checkIndexedType(const td::LevelTemplate& level, int type) {
+    if (type < 0 || type > td::Map::MAX_TILE_TYPE || (level.indexed_types & td::Map::mask(type)) == 0)
+        throw std::invalid_argument("Tile type " + std::to_string(type) + " is not indexed. See td::Map::setIndexedTypes.");
+}
+
+/**
+ * @brief Get every tile of a certain type, in row-major order, from the map's tile type position index.
+ * Takes time proportional to the number of tiles found, not the size of the map.
+ * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
+ * The type must be indexed; see td::Map::setIndexedTypes.
+ * @return A vector of the tiles of that type.
+ */
+std::vector<td::Tile> td::Map::getTilesOfType(int type) const {
+    const td::LevelTemplate& level = *this->level;
+    checkIndexedType(level, type);
+    std::vector<td::Tile> tiles = std::vector<td::Tile>();
+    tiles.reserve(level.type_cells[type].size());
+    for (std::uint32_t cell : level.type_cells[type]) {
+        const PaletteEntry& entry = level.palette[level.tileData()[cell]];
+        tiles.emplace_back(entry.sprite_id, entry.type_id, (int)cell / level.cols, (int)cell % level.cols);
+    }
+    return tiles;
+}
+
+/**
+ * @brief Count the tiles of a certain type. O(1) lookup in the map's tile type position index.
+ * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
+ * The type must be indexed; see td::Map::setIndexedTypes.
+ * @return The number of tiles of that type.
+ */
+std::size_t td::Map::countTilesOfType(int type) const {
+    checkIndexedType(*this->level, type);
+    return this->level->type_cells[type].size();
+}
+
+/**
+ * @brief Find the tile of a certain type whose center is nearest to a location, such as the nearest checkpoint.
+ * Only the tiles of that type are looked at, using the map's tile type position index.
+ * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
+ * The type must be indexed; see td::Map::setIndexedTypes.
+ * @param x The x coordinate, in pixels.
+ * @param y The y coordinate, in pixels.
+ * @param nearest Set to the nearest tile, if there is one.
+ * @return Boolean. True = a tile was found, False = the map has no tiles of that type.
+ */
+bool td::Map::getNearestTileOfType(int type, float x, float y, td::Tile& nearest) const {
+    const td::LevelTemplate& level = *this->level;
+    checkIndexedType(level, type);
+    float half_tile = (float)level.tile_size / 2;
+    float best_distance = std::numeric_limits<float>::max();
+    std::uint32_t best_cell = 0;
+    bool found = false;
+    for (std::uint32_t cell : level.type_cells[type]) {
+        float dx = (float)((int)cell % level.cols * level.tile_size) + half_tile - x;
+        float dy = (float)((int)cell / level.cols * level.tile_size) + half_tile - y;
+        float distance = dx*dx + dy*dy;
+        if (distance < best_distance) {
+            best_distance = distance;
+            best_cell = cell;
+            found = true;
+        }
+    }
+    if (found) nearest = this->getTileAt((int)best_cell / level.cols, (int)best_cell % level.cols);
+    return found;
+}
+
+/**
+ * @brief Get map size. In pixels by default.
+ * @param rows_cols Boolean to overwrite the default and instead return the map's number of rows and columns.
+ * Default value: false.
+ * @return The map's size in pixels, or in number of rows can columns depending on the value of rows_cols.
+ */
+sf::Vector2i td::Map::getMapSize(bool rows_cols) const {
+    if (rows_cols)
+        return {this->level->cols, this->level->rows};
+    else
+        return {this->level->cols * this->level->tile_size, this->level->rows * this->level->tile_size};
+}
+
+/**
+ * @brief Get the map's level template, which holds its tiles, tile types, and sprite sheet.
+ * Pass it to the td::Map constructor to create more instances of the same level without copying tiles.
+ * @return A shared pointer to the map's read-only level template.
+ */
+std::shared_ptr<const td::LevelTemplate> td::Map::getLevel() const {
+    return this->level;
+}
+
+/**
+ * @brief Get the map's enemies, to change the list or move the enemies directly.
+ * The map's spatial grid of enemies is rebuilt on its next query.
+ * @return A vector of pointers to the maps' Enemy objects.
+ */
+std::vector<td::Enemy*>* td::Map::getEnemies() {
+    this->enemy_grid_dirty = true;
+    return &this->enemies;
+}
+
+/**
+ * @brief Get the map's items, to change the list or move the items directly.
+ * The map's spatial grid of items is rebuilt on its next query.
+ * @return A vector of pointers to the maps' Item objects.
+ */
+std::vector<td::Item*>* td::Map::getItems() {
+    this->item_grid_dirty = true;
+    return &this->items;
+}
+
+/**
+ * @brief View the map's enemies without copying the list.
+ * @return A read-only view of the pointers to the map's Enemy objects.
+ */
+td::View<td::Enemy*> td::Map::getEnemyView() const {
+    return this->enemies;
+}
+
+/**
+ * @brief View the map's items without copying the list.
+ * @return A read-only view of the pointers to the map's Item objects.
+ */
+td::View<td::Item*> td::Map::getItemView() const {
+    return this->items;
+}
+
+/**
+ * @brief Get the map's rooms and doorways, if they have been built with td::Map::buildRooms.
+ * @return A reference to the map's room segmentation.
+ */
+const td::Rooms& td::Map::getRooms() const {
+    return this->level->rooms;
+}
+
+/**
+ * @brief Get the room or doorway at a location. O(1) lookup.
+ * @param x The x coordinate, in pixels.
+ * @param y The y coordinate, in pixels.
+ * @return The room's id, or td::Rooms::NONE for walls, locations off the map, or maps whose rooms are not built.
+ */
+int td::Map::getRoom(float x, float y) const {
+    if (x < 0 || y < 0) return td::Rooms::NONE;
+    return this->level->rooms.getRoomAt((int)(y/(float)this->level->tile_size), (int)(x/(float)this->level->tile_size));
+}
+
+/**
+ * @brief Get the area a room covers, from its bounding box.
+ * @param room The room's id.
+ * @param area Set to the room's bounding box, in pixels.
+ * @return Boolean. True = the room exists, False = the id is td::Rooms::NONE, unknown, or the rooms are not built.
+ */
+bool td::Map::getRoomArea(int room, sf::FloatRect& area) const {
+    const td::Rooms& rooms = this->level->rooms;
+    if (!rooms.isBuilt() || room < 0 || room >= (int)rooms.getRoomCount()) return false;
+    const sf::IntRect& bounds = rooms.getRoom(room).bounds;
+    auto tile_size = (float)this->level->tile_size;
+    area = sf::FloatRect((float)bounds.left * tile_size, (float)bounds.top * tile_size,
+                         (float)bounds.width * tile_size, (float)bounds.height * tile_size);
+    return true;
+}
+
+/**
+ * @brief Get the enemies whose centers are in a room, so that work can be limited to the player's area.
+ * Only the enemies near the room's bounding box are checked, found through the map's spatial grid, so like
+ * td::Map::forEachEnemyNear, an enemy moved other than by td::Map::moveEnemies is found once the grid is rebuilt.
+ * @param room The room's id. See td::Map::getRoom.
+ * @return A vector of pointers to the enemies in the room, in the order they are stored in the map.
+ */
+std::vector<td::Enemy*> td::Map::getEnemiesInRoom(int room) const {
+    std::vector<td::Enemy*> found = std::vector<td::Enemy*>();
+    auto check = [this, room, &found](td::Enemy* enemy) {
+        sf::Vector2f center = enemy->getPosition(true);
+        if (this->getRoom(center.x, center.y) == room) found.emplace_back(enemy);
+    };
+    // Walls and locations off the map have no area to look in
+    sf::FloatRect area;
+    if (this->getRoomArea(room, area)) this->forEachEnemyNear(area, check);
+    else std::for_each(this->enemies.begin(), this->enemies.end(), check);
+    return found;
+}
+
+/**
+ * @brief Get the items whose centers are in a room, so that work can be limited to the player's area.
+ * Only the items near the room's bounding box are checked, found through the map's spatial grid.
+ * @param room The room's id. See td::Map::getRoom.
+ * @return A vector of pointers to the items in the room, in the order they are stored in the map.
+ */
+std::vector<td::Item*> td::Map::getItemsInRoom(int room) const {
+    std::vector<td::Item*> found = std::vector<td::Item*>();
+    auto check = [this, room, &found](td::Item* item) {
+        sf::Vector2f center = item->getPosition(true);
+        if (this->getRoom(center.x, center.y) == room) found.emplace_back(item);
+    };
+    sf::FloatRect area;
+    if (this->getRoomArea(room, area)) this->forEachItemNear(area, check);
+    else std::for_each(this->items.begin(), this->items.end(), check);
+    return found;
+}
+
+/**
+ * @brief Set the map's sprite sheet, which is used to determine what to draw at each tile.
+ * @param sheet The sprite sheet to use.
+ */
+void td::Map::setSpriteSheet(const td::SpriteSheet& sheet) {
+    this->editLevel().sprite_sheet = sheet;
+}
+
+/**
+ * @brief Set the size of the map tiles, in pixels.
+ * @param size The desired tile size.
+ */
+void td::Map::setTileSize(int size) {
+    if (size < 0 || size > this->level->max_allowed_tile_size) {
+        throw std::invalid_argument("Invalid tile size.");
+    }
+    this->editLevel().tile_size = size;
+    this->tile_revision++;
+    this->enemy_grid_dirty = true;
+    this->item_grid_dirty = true;
+}
+
+/**
+ * @brief Set a special tile type, whether by overwriting a default one or creating a new one.
+ * Rebuilds the map's type_id classification table and tile type position index.
+ * @param type Integer tile type between 0 and td::Map::MAX_TILE_TYPE, likely specified from an enumeration
+ * (the td::Map::TileTypes enum). Values above the built-in types are free for user-defined types.
+ * @param type_ids A vector of chars that correspond to the integer type.
+ */
+void td::Map::setTileType(int type, std::vector<char> type_ids) {
+    if (type < 0 || type > td::Map::MAX_TILE_TYPE) {
+        throw std::invalid_argument("Invalid tile type. Tile types must be between 0 and 31.");
+    }
+    td::LevelTemplate& level = this->editLevel();
+    level.tile_types[type] = std::move(type_ids);
+    level.rebuildTypeMasks();
+    level.rebuildTypeIndex();
+    if (level.rooms.isBuilt()) level.rooms.build(level);
+    this->tile_revision++;
+}
+
+/**
+ * @brief Choose which tile types the map keeps a position index for. See td::Map::getTilesOfType.
+ * By default every type except WALL is indexed, since walls usually make up most of a map.
+ * @param types A bitmask of tile types to index, built with td::Map::mask.
+ */
+void td::Map::setIndexedTypes(td::Map::TileMask types) {
+    td::LevelTemplate& level = this->editLevel();
+    level.indexed_types = types;
+    level.rebuildTypeIndex();
+}
+
+/**
+ * @brief Change a single tile, such as a door opening, a key being picked up, or a wall being destroyed.
+ * Only what depends on the tile is updated: the tile type position index is updated in place, the tile's chunk
+ * of merged tiles (used for both drawing and collision) is merged again, and if the map's rooms have been built,
+ * the rooms around the tile are labeled again. Then the map's tile listeners are called.
+ * Setting a tile to what it already is does nothing.
+ * If the map's level template is shared with other maps, or its tiles are borrowed from a compiled map file,
+ * the map first makes its own copy, so the change only affects this map.
+ * The level's start tile and checkpoint list keep their positions as read from the map file.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @param sprite_id The tile's new sprite_id char.
+ * @param type_id The tile's new type_id char.
+ */
+void td::Map::setTile(int row, int col, char sprite_id, char type_id) {
+    if (!this->inBounds(row, col))
+        throw std::invalid_argument("Tile (" + std::to_string(row) + ", " + std::to_string(col) + ") is out of bounds.");
+    td::Tile old_tile = this->getTileAt(row, col);
+    if (old_tile.sprite_id == sprite_id && old_tile.type_id == type_id) return;
+    td::LevelTemplate& level = this->editLevel();
+    if (level.external_tiles) {
+        level.tiles.assign(level.external_tiles, level.external_tiles + (std::size_t)level.rows * level.cols);
+        level.external_tiles = nullptr;
+        level.backing.reset();
+    }
+
+    // Find or add the palette entry for the new tile
+    std::size_t index = 0;
+    while (index < level.palette.size() &&
+           (level.palette[index].sprite_id != sprite_id || level.palette[index].type_id != type_id)) index++;
+    if (index == level.palette.size()) {
+        if (index > std::numeric_limits<TileIndex>::max())
+            throw std::invalid_argument("Map has too many distinct tiles.");
+        level.palette.push_back({sprite_id, type_id});
+    }
+
+    auto cell = (std::uint32_t)(row * level.cols + col);
+    TileMask old_types = level.type_masks[(unsigned char)level.palette[level.tiles[cell]].type_id];
+    level.tiles[cell] = (TileIndex)index;
+    level.updateTypeIndex(cell, old_types, level.type_masks[(unsigned char)type_id]);
+    level.mergeChunk(row / td::LevelTemplate::MERGE_CHUNK_SIZE, col / td::LevelTemplate::MERGE_CHUNK_SIZE);
+    level.rooms.update(level, row, col);
+
+    this->tile_revision++;
+    td::Tile new_tile = {sprite_id, type_id, row, col};
+    for (const auto& listener : this->tile_listeners) listener.second(old_tile, new_tile);
+}
+
+/**
+ * @brief Register a function to call whenever setTile changes one of the map's tiles, after the map has been
+ * updated. The function receives the tile as it was and as it is now.
+ * @param listener The function to call.
+ * @return An id to pass to removeTileListener.
+ */
+int td::Map::addTileListener(td::Map::TileListener listener) {
+    int id = this->next_listener_id++;
+    this->tile_listeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+/**
+ * @brief Stop calling a function registered with addTileListener.
+ * @param id The id returned by addTileListener.
+ */
+void td::Map::removeTileListener(int id) {
+    for (auto it = this->tile_listeners.begin(); it != this->tile_listeners.end(); ++it) {
+        if (it->first == id) {
+            this->tile_listeners.erase(it);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Get a number that changes whenever the map's tiles, tile types, or tile size change, so that anything
+ * worked out from the tiles, such as by td::TileTriggers, can tell when to work it out again.
+ * @return The map's tile revision.
+ */
+std::uint32_t td::Map::getTileRevision() const {
+    return this->tile_revision;
+}
+
+/**
+ * @brief Split the map's open tiles into rooms and doorways. See td::Rooms.
+ * Call this before sharing the level template with other maps, so that they share the rooms as well.
+ * The rooms are kept up to date by td::Map::setTile and td::Map::setTileType.
+ */
+void td::Map::buildRooms() {
+    td::LevelTemplate& level = this->editLevel();
+    level.rooms.build(level);
+}
+
+/**
+ * @brief Add an enemy to the map. The enemy is pointed at this map instance.
+ * @param enemy A pointer to the Enemy object to add.
+ */
+void td::Map::addEnemy(td::Enemy* enemy) {
+    enemy->setMap(*this);
+    this->enemies.emplace_back(enemy);
+    this->enemy_grid_dirty = true;
+}
+
+/**
+ * @brief Move all enemies according to their waypoints.
+ * @param elapsed The time elapsed between this frame and the last.
+ */
+void td::Map::moveEnemies(float elapsed) {
+    bool track = !this->enemy_grid_dirty && this->enemy_grid.size() == this->enemies.size();
+    for (std::size_t i=0; i<this->enemies.size(); i++) {
+        td::Enemy* enemy = this->enemies[i];
+        enemy->move(elapsed);
+        if (track) this->enemy_grid.place((std::uint32_t)i, enemy->getSweptBounds());
+    }
+}
+
+/**
+ * @brief Reset all enemies to their starting locations.
+ */
+void td::Map::resetEnemies() {
+    for (auto enemy : this->enemies) {
+        enemy->reset();
+    }
+    this->enemy_grid_dirty = true;
+}
+
+/**
+ * @brief Add an item to the map. The item is pointed at this map instance.
+ * @param item A pointer to the Item object to add.
+ */
+void td::Map::addItem(td::Item* item) {
+    item->setMap(*this);
+    this->items.emplace_back(item);
+    this->item_grid_dirty = true;
+}
+
+/**
+ * @brief Rebuild the enemy spatial grid if the enemy list has changed since it was built.
+ */
+void td::Map::syncEnemyGrid() const {
+    if (!this->enemy_grid_dirty && this->enemy_grid.size() == this->enemies.size()) return;
+    auto cell_size = (float)(std::max(1, this->level->tile_size) * td::Map::GRID_CELL_TILES);
+    this->enemy_grid.reset(this->getMapSize(), cell_size, this->enemies.size());
+    for (std::size_t i=0; i<this->enemies.size(); i++) {
+        this->enemy_grid.place((std::uint32_t)i, this->enemies[i]->getSweptBounds());
+    }
+    this->enemy_grid_dirty = false;
+}
+
+/**
+ * @brief Rebuild the item spatial grid if the item list has changed since it was built.
+ */
+void td::Map::syncItemGrid() const {
+    if (!this->item_grid_dirty && this->item_grid.size() == this->items.size()) return;
+    auto cell_size = (float)(std::max(1, this->level->tile_size) * td::Map::GRID_CELL_TILES);
+    this->item_grid.reset(this->getMapSize(), cell_size, this->items.size());
+    for (std::size_t i=0; i<this->items.size(); i++) {
+        const td::Item* item = this->items[i];
+        this->item_grid.place((std::uint32_t)i, sf::FloatRect(item->getPosition(), sf::Vector2f(
+                (float)item->getSize().width, (float)item->getSize().height)));
+    }
+    this->item_grid_dirty = false;
+}
+
+/**
+ * @brief Find the enemies whose shapes touch a bounding box. The enemies near the box are found through the spatial
+ * grid, then their shapes are tested against the box as one batch.
+ * @param bounds The bounding box to test, such as a player's bounds.
+ * @param circles Whether to treat each enemy as a circle, as wide as the enemy and centered in it, rather than as
+ * its bounding box.
+ * @param touching Set to the enemies touching the box, in the order they are stored in the map.
+ */
+void td::Map::findEnemiesTouching(const td::AABB& bounds, bool circles, std::vector<td::Enemy*>& touching) const {
+    touching.clear();
+    this->enemy_circles.clear();
+    this->enemy_rects.clear();
+    this->forEachEnemyNear(bounds.toRect(), [&](td::Enemy* enemy) {
+        touching.push_back(enemy);
+        sf::Vector2f size((float)enemy->getSize().width, (float)enemy->getSize().height);
+        if (circles) this->enemy_circles.add(td::Circle(enemy->getPosition() + size/2.f, size.x/2));
+        else this->enemy_rects.add(enemy->getBounds());
+    });
+    if (circles) td::Util::intersects(this->enemy_circles, bounds, this->enemy_hits);
+    else td::Util::intersects(this->enemy_rects, bounds, this->enemy_hits);
+
+    // Keep only the candidates that were hit
+    std::size_t kept = 0;
+    for (std::size_t i=0; i<touching.size(); i++) {
+        if ((this->enemy_hits[i/64] >> (i % 64)) & 1) touching[kept++] = touching[i];
+    }
+    touching.resize(kept);
+}
+
+/**
+ * @brief Create the enemies and items defined by the map's level, such as those listed in a level manifest.
+ * All of the enemies are built into a single array and all of the items into another, and each texture is loaded
+ * once and shared, so a level costs a handful of allocations rather than several per entity.
+ * Sizes and waypoints are given in tiles, so set the tile size first.
+ * The map owns the entities it spawns. Entities from an earlier call are removed and freed; entities added with
+ * td::Map::addEnemy and td::Map::addItem are left alone.
+ */
+void td::Map::spawnEntities() {
+    // Remove the entities from an earlier spawn
+    if (this->spawned_enemies && !this->spawned_enemies->empty()) {
+        const td::Enemy* first = this->spawned_enemies->data();
+        const td::Enemy* last = first + this->spawned_enemies->size();
+        this->enemies.erase(std::remove_if(this->enemies.begin(), this->enemies.end(), [first, last](td::Enemy* e) {
+            return !std::less<const td::Enemy*>()(e, first) && std::less<const td::Enemy*>()(e, last);
+        }), this->enemies.end());
+    }
+    if (this->spawned_items && !this->spawned_items->empty()) {
+        const td::Item* first = this->spawned_items->data();
+        const td::Item* last = first + this->spawned_items->size();
+        this->items.erase(std::remove_if(this->items.begin(), this->items.end(), [first, last](td::Item* i) {
+            return !std::less<const td::Item*>()(i, first) && std::less<const td::Item*>()(i, last);
+        }), this->items.end());
+    }
+    this->spawned_enemies.reset();
+    this->spawned_items.reset();
+    this->entity_textures.clear();
+
+    const td::LevelTemplate& level = *this->level;
+    std::size_t enemy_count = 0;
+    std::size_t item_count = 0;
+    std::vector<const sf::Texture*> textures(level.strings.size(), nullptr);
+    for (const auto& entity : level.entities) {
+        if (entity.kind == td::LevelTemplate::EntityKind::ENEMY) enemy_count++;
+        if (entity.kind == td::LevelTemplate::EntityKind::ITEM) item_count++;
+        // Load each texture once
+        if (entity.texture != td::LevelTemplate::NO_STRING && textures[entity.texture] == nullptr) {
+            this->entity_textures.push_back(td::TextureCache::load(level.resolvePath(entity.texture)));
+            textures[entity.texture] = this->entity_textures.back().get();
+        }
+    }
+
+    // Reserve everything up front, so that the arrays never move and the map's pointers into them stay valid
+    std::unique_ptr<std::vector<td::Enemy>> enemy_array(new std::vector<td::Enemy>());
+    std::unique_ptr<std::vector<td::Item>> item_array(new std::vector<td::Item>());
+    enemy_array->reserve(enemy_count);
+    item_array->reserve(item_count);
+    this->enemies.reserve(this->enemies.size() + enemy_count);
+    this->items.reserve(this->items.size() + item_count);
+
+    for (const auto& entity : level.entities) {
+        int width = (int)(entity.width * (float)level.tile_size);
+        int height = (int)(entity.height * (float)level.tile_size);
+        auto first = level.waypoints.begin() + entity.first_waypoint;
+        const sf::Texture* texture = entity.texture != td::LevelTemplate::NO_STRING ? textures[entity.texture] : nullptr;
+        if (entity.kind == td::LevelTemplate::EntityKind::ENEMY) {
+            enemy_array->emplace_back(*this, width, height, sf::Color(entity.color), entity.harm);
+            td::Enemy& enemy = enemy_array->back();
+            enemy.setWaypoints(std::vector<sf::Vector2f>(first, first + entity.waypoint_count));
+            enemy.setMoveSpeed(entity.speed);
+            if (entity.move_option != 0) enemy.setMoveOption(entity.move_option);
+            if (texture) {
+                enemy.setTexture(*texture);
+                enemy.setCollisionMask(level.resolvePath(entity.texture));
+            }
+            this->enemies.push_back(&enemy);
+        } else if (entity.kind == td::LevelTemplate::EntityKind::ITEM) {
+            item_array->emplace_back(*this, width, height, sf::Color(entity.color));
+            td::Item& item = item_array->back();
+            if (entity.waypoint_count > 0) item.setStartTile((int)first->x, (int)first->y);
+            if (texture) item.setTexture(*texture);
+            this->items.push_back(&item);
+        }
+    }
+    this->spawned_enemies = std::move(enemy_array);
+    this->spawned_items = std::move(item_array);
+    this->enemy_grid_dirty = true;
+    this->item_grid_dirty = true;
+}
+
+/**
+ * @brief Reset all items to be un-obtained.
+ */
+void td::Map::resetItems() {
+    for (auto item : this->items) {
+        item->reset();
+    }
+}
+
+/**
+ * @brief Checks if the player is colliding with any tiles of a certain type. Stops at the first collision.
+ * @param map The map on which to test for collision.
+ * @param type_ids The type IDs of tiles to watch out for when checking for player collision.
+ * @param rect The player's bounding rectangle.
+ * @return Boolean of whether or not a collision was detected. True = collision, False = no collision.
+ */
+bool td::Map::collides(td::Map& map, const std::vector<char>& type_ids, const sf::RectangleShape& rect) {
+    int r_start, c_start, r_end, c_end;
+    if (!map.getTileRange(td::AABB::of(rect), r_start, c_start, r_end, c_end)) return false;
+    for (int r=r_start; r<=r_end; r++) {
+        for (int c=c_start; c<=c_end; c++) {
+            if (td::Util::find(type_ids, map.getTileAt(r, c).type_id) != -1) return true;  // Collision!
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get all tiles of certain types that the player is colliding with.
+ * Looks at the tiles that the player's bounding box overlaps and keeps those of a specific type.
+ * @param map The map on which to test for collision.
+ * @param type_ids The type IDs of tiles to watch out for when checking for player collision.
+ * @param rect The player's bounding rectangle.
+ * @return A vector of tiles (of the correct type) that were found to be colliding with the player.
+ */
+std::vector<td::Tile>
+td::Map::getCollisions(td::Map &map, const std::vector<char> &type_ids, const sf::RectangleShape &rect) {
+    std::vector<td::Tile> tiles = std::vector<td::Tile>();
+    int r_start, c_start, r_end, c_end;
+    if (!map.getTileRange(td::AABB::of(rect), r_start, c_start, r_end, c_end)) return tiles;
+    for (int r=r_start; r<=r_end; r++) {
+        for (int c=c_start; c<=c_end; c++) {
+            td::Tile tile = map.getTileAt(r, c);
+            if (td::Util::find(type_ids, tile.type_id) != -1) tiles.emplace_back(tile);  // Collision!
+        }
+    }
+    return tiles;
+}
+
+/**
+ * @brief Checks if a bounding box is colliding with any tiles of the given types.
+ * Tests the map's merged tile rectangles in the chunks under the box rather than individual tiles, and stops at
+ * the first collision.
+ * @param types A bitmask of tile types to check against, built with td::Map::mask.
+ * @param bounds The bounding box to test, such as a player's bounds.
+ * @return Boolean of whether or not a collision was detected. True = collision, False = no collision.
+ */
+bool td::Map::collides(td::Map::TileMask types, const td::AABB& bounds) const {
+    const td::LevelTemplate& level = *this->level;
+    int r_start, c_start, r_end, c_end;
+    if (level.tile_rects.empty() || !this->getTileRange(bounds, r_start, c_start, r_end, c_end)) return false;
+
+    // Any merged rectangle that shares a tile with the range overlaps the box
+    const int chunk_size = td::LevelTemplate::MERGE_CHUNK_SIZE;
+    for (int chunk_row=r_start/chunk_size; chunk_row<=r_end/chunk_size; chunk_row++) {
+        for (int chunk_col=c_start/chunk_size; chunk_col<=c_end/chunk_size; chunk_col++) {
+            for (const auto& rect : level.tile_rects[chunk_row * level.rect_chunk_cols + chunk_col]) {
+                if ((level.type_masks[(unsigned char)level.palette[rect.tile].type_id] & types) == 0) continue;
+                if (rect.row <= r_end && rect.row + rect.rows > r_start &&
+                    rect.col <= c_end && rect.col + rect.cols > c_start) return true;  // Collision!
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Append the merged tile rectangles of certain types that share a tile with a bounding box, as pixel bounds.
+ * @param types A bitmask of tile types to gather, built with td::Map::mask.
+ * @param bounds The area to gather from.
+ * @param rects The vector to append the rectangles to.
+ * @param offset Added to every rectangle, to place them in another frame, such as a neighboring chunk's.
+ */
+void td::Map::getMergedRects(td::Map::TileMask types, const td::AABB& bounds, std::vector<sf::FloatRect>& rects,
+                             const sf::Vector2f& offset) const {
+    const td::LevelTemplate& level = *this->level;
+    int r_start, c_start, r_end, c_end;
+    if (level.tile_rects.empty() || !this->getTileRange(bounds, r_start, c_start, r_end, c_end)) return;
+    auto tile_size = (float)level.tile_size;
+    const int chunk_size = td::LevelTemplate::MERGE_CHUNK_SIZE;
+    for (int chunk_row=r_start/chunk_size; chunk_row<=r_end/chunk_size; chunk_row++) {
+        for (int chunk_col=c_start/chunk_size; chunk_col<=c_end/chunk_size; chunk_col++) {
+            for (const auto& rect : level.tile_rects[chunk_row * level.rect_chunk_cols + chunk_col]) {
+                if ((level.type_masks[(unsigned char)level.palette[rect.tile].type_id] & types) == 0) continue;
+                if (rect.row <= r_end && rect.row + rect.rows > r_start &&
+                    rect.col <= c_end && rect.col + rect.cols > c_start) {
+                    rects.emplace_back(offset.x + (float)rect.col * tile_size, offset.y + (float)rect.row * tile_size,
+                                       (float)rect.cols * tile_size, (float)rect.rows * tile_size);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Move a bounding box by a delta, sliding along any tiles of the given types in the way.
+ * The box is swept along its whole path rather than tested at its end point, so it can not pass through a wall
+ * however far it moves in one call, and the result does not depend on how the motion is split between frames.
+ * The walls that could be hit are gathered once, from the merged tile rectangles under the whole path, and the box
+ * is then swept against them (see the static td::Map::sweep).
+ * @param types A bitmask of tile types that block movement, built with td::Map::mask.
+ * @param bounds The box's bounds before moving.
+ * @param delta How far to move, in pixels.
+ * @return The box's new top-left position.
+ */
+sf::Vector2f td::Map::sweep(td::Map::TileMask types, const sf::FloatRect& bounds, const sf::Vector2f& delta) const {
+    if (delta.x == 0 && delta.y == 0) return {bounds.left, bounds.top};
+    sf::FloatRect path(std::min(bounds.left, bounds.left + delta.x), std::min(bounds.top, bounds.top + delta.y),
+                       bounds.width + std::abs(delta.x), bounds.height + std::abs(delta.y));
+    this->sweep_candidates.clear();
+    this->getMergedRects(types, path, this->sweep_candidates);
+    return td::Map::sweep(this->sweep_candidates, bounds, delta);
+}
+
+/**
+ * @brief Move a bounding box by a delta, sliding along any of a list of walls in the way.
+ * The box advances from event to event: to the earliest wall it would hit, where it stops flush against the wall
+ * and keeps moving along it, or to the end of a wall it is sliding along, where it can move toward it again.
+ * A box that already overlaps a wall can move out of it.
+ * @param walls The walls that could be hit, such as the merged tile rectangles under the box's path.
+ * @param bounds The box's bounds before moving.
+ * @param delta How far to move, in pixels.
+ * @return The box's new top-left position.
+ */
+sf::Vector2f td::Map::sweep(const std::vector<sf::FloatRect>& walls, const sf::FloatRect& bounds,
+                            const sf::Vector2f& delta) {
+    // Distance, in pixels, within which the box counts as touching a wall rather than being inside it
+    const float TOUCHING = 0.001f;
+    const float INFINITE = std::numeric_limits<float>::infinity();
+    if (delta.x == 0 && delta.y == 0) return {bounds.left, bounds.top};
+
+    // Axis 0 is x and axis 1 is y
+    float position[2] = {bounds.left, bounds.top};
+    const float size[2] = {bounds.width, bounds.height};
+    const float motion[2] = {delta.x, delta.y};
+    auto low = [](const sf::FloatRect& wall, int axis) { return axis == 0 ? wall.left : wall.top; };
+    auto high = [](const sf::FloatRect& wall, int axis) {
+        return axis == 0 ? wall.left + wall.width : wall.top + wall.height;
+    };
+    // Free space between the box and a wall along an axis, on the side the box is moving toward
+    auto gap = [&](const sf::FloatRect& wall, int axis, float direction) {
+        return direction > 0 ? low(wall, axis) - (position[axis] + size[axis]) : position[axis] - high(wall, axis);
+    };
+    // Whether the box and a wall share more than an edge along an axis
+    auto overlaps = [&](const sf::FloatRect& wall, int axis) {
+        return low(wall, axis) - (position[axis] + size[axis]) < -TOUCHING &&
+               position[axis] - high(wall, axis) < -TOUCHING;
+    };
+    // Whether the box is pressed against a wall along an axis, in the direction it moves along that axis
+    auto pressed = [&](const sf::FloatRect& wall, int axis) {
+        return motion[axis] != 0 && std::abs(gap(wall, axis, motion[axis])) <= TOUCHING && overlaps(wall, 1 - axis);
+    };
+
+    // Times below are fractions of the whole motion
+    float time_left = 1;
+    bool stuck[2] = {false, false};  // Axes blocked at a corner, where the box touches a wall only at an edge
+    std::size_t steps = 4 + 2 * walls.size();
+    for (std::size_t step=0; step<steps && time_left > 0; step++) {
+        // Stop moving along the axes where the box is pressed against a wall
+        float velocity[2];
+        for (int axis=0; axis<2; axis++) {
+            bool blocked = stuck[axis];
+            for (std::size_t i=0; !blocked && i<walls.size(); i++)
+                blocked = pressed(walls[i], axis);
+            velocity[axis] = blocked ? 0 : motion[axis];
+        }
+        if (velocity[0] == 0 && velocity[1] == 0) break;
+
+        // Find the earliest wall the box would hit
+        float next = time_left;
+        int hit_axis = -1;
+        const sf::FloatRect* hit_wall = nullptr;
+        for (const auto& wall : walls) {
+            float entry[2];
+            float exit[2];
+            for (int axis=0; axis<2; axis++) {
+                if (velocity[axis] == 0) {
+                    entry[axis] = -INFINITE;
+                    exit[axis] = overlaps(wall, axis) ? INFINITE : -INFINITE;
+                    continue;
+                }
+                float space = gap(wall, axis, velocity[axis]);
+                float far = velocity[axis] > 0 ? high(wall, axis) - position[axis]
+                                               : position[axis] + size[axis] - low(wall, axis);
+                entry[axis] = (space > -TOUCHING ? std::max(0.f, space) : space) / std::abs(velocity[axis]);
+                exit[axis] = (far - TOUCHING) / std::abs(velocity[axis]);  // Only sharing an edge is not a hit
+            }
+            float enter = std::max(entry[0], entry[1]);
+            float leave = std::min(exit[0], exit[1]);
+            // Skip walls that are missed, reached after the motion ends, or that the box is already inside
+            if (enter >= leave || enter < 0 || enter > next || (enter == next && hit_wall != nullptr)) continue;
+            next = enter;
+            hit_axis = entry[0] >= entry[1] ? 0 : 1;
+            hit_wall = &wall;
+        }
+
+        // Or the earliest time the box slides past the end of a wall it is pressed against
+        int past_axis = -1;
+        float past_position = 0;
+        for (int axis=0; axis<2; axis++) {
+            int along = 1 - axis;
+            if (motion[axis] == 0 || velocity[axis] != 0 || stuck[axis] || velocity[along] == 0) continue;
+            for (const auto& wall : walls) {
+                if (!pressed(wall, axis)) continue;
+                float past = (velocity[along] > 0 ? high(wall, along) - position[along]
+                                                  : position[along] + size[along] - low(wall, along)) /
+                             std::abs(velocity[along]);
+                if (past < next) {
+                    next = past;
+                    hit_wall = nullptr;
+                    past_axis = along;
+                    past_position = velocity[along] > 0 ? high(wall, along) : low(wall, along) - size[along];
+                }
+            }
+        }
+
+        // Advance, placing the box exactly flush with the wall it hit, or exactly past the end of the one it left
+        position[0] += velocity[0] * next;
+        position[1] += velocity[1] * next;
+        if (hit_wall != nullptr) {
+            position[hit_axis] = velocity[hit_axis] > 0 ? low(*hit_wall, hit_axis) - size[hit_axis]
+                                                        : high(*hit_wall, hit_axis);
+        } else if (past_axis >= 0) {
+            position[past_axis] = past_position;
+        }
+        if (next > 0) stuck[0] = stuck[1] = false;
+        if (hit_wall != nullptr && next == 0) stuck[hit_axis] = true;
+        time_left -= next;
+    }
+    return {position[0], position[1]};
+}
+
+/**
+ * @brief Get all tiles of certain types that a bounding box is colliding with.
+ * Like the static td::Map::getCollisions, but classifies each tile with the map's type table instead of
+ * searching a list of type_id chars. Allocates a new vector on every call; for queries made every frame,
+ * prefer the overload that fills a caller's vector, or td::Map::forEachCollision.
+ * @param types A bitmask of tile types to check against, built with td::Map::mask.
+ * @param bounds The bounding box to test, such as a player's bounds.
+ * @return A vector of tiles (of the correct type) that were found to be colliding with the bounding box.
+ */
+std::vector<td::Tile> td::Map::getCollisions(td::Map::TileMask types, const td::AABB& bounds) const {
+    std::vector<td::Tile> tiles = std::vector<td::Tile>();
+    this->getCollisions(types, bounds, tiles);
+    return tiles;
+}
+
+/**
+ * @brief Get all tiles of certain types that a bounding box is colliding with, into a caller's vector.
+ * The vector is cleared first, and keeps its capacity between calls, so reusing one vector avoids allocating.
+ * @param types A bitmask of tile types to check against, built with td::Map::mask.
+ * @param bounds The bounding box to test, such as a player's bounds.
+ * @param tiles Set to the tiles (of the correct type) that were found to be colliding with the bounding box.
+ */
+void td::Map::getCollisions(td::Map::TileMask types, const td::AABB& bounds, std::vector<td::Tile>& tiles) const {
+    tiles.clear();
+    this->forEachCollision(types, bounds, [&tiles](const td::Tile& tile) { tiles.push_back(tile); });
+}
+
+/**
+ * @brief Find the range of tiles that a bounding box overlaps, clamped to the map.
+ * A tile overlaps the box if they share some area; tiles that only touch the box's edge do not count, matching
+ * sf::FloatRect::intersects. Every tile in the range overlaps the box.
+ * @param bounds The bounding box.
+ * @param r_start Set to the first row.
+ * @param c_start Set to the first column.
+ * @param r_end Set to the last row.
+ * @param c_end Set to the last column.
+ * @return False if the box has no area or lies entirely off the map, in which case the range is empty.
+ */
+bool td::Map::getTileRange(const td::AABB& bounds, int& r_start, int& c_start, int& r_end, int& c_end) const {
+    const td::LevelTemplate& level = *this->level;
+    r_start = 0; c_start = 0; r_end = -1; c_end = -1;
+    if (bounds.isEmpty() || level.tile_size <= 0) return false;
+
+    // Clamp while still in floats, so boxes far off the map can not overflow the conversion to int
+    auto tile_size = (float)level.tile_size;
+    auto rows = (float)level.rows;
+    auto cols = (float)level.cols;
+    r_start = (int)std::min(rows, std::max(0.f, std::floor(bounds.top / tile_size)));
+    c_start = (int)std::min(cols, std::max(0.f, std::floor(bounds.left / tile_size)));
+    r_end = (int)std::min(rows, std::max(0.f, std::ceil(bounds.bottom / tile_size))) - 1;
+    c_end = (int)std::min(cols, std::max(0.f, std::ceil(bounds.right / tile_size))) - 1;
+    return r_start <= r_end && c_start <= c_end;
+}
+
+/**
+ * @brief Cast a ray from one point toward another, and find the first tile of certain types in its way.
+ * The ray walks the tile grid one tile at a time (a DDA), visiting exactly the tiles the line passes through, in
+ * order, so its cost grows with the length of the line in tiles rather than with the size of the map. Tiles off the
+ * map never block. A ray that passes exactly through the corner shared by two tiles visits one of them.
+ * Safe to call from several threads at once, as long as no thread changes the map.
+ * @param types A bitmask of tile types that block the ray, built with td::Map::mask.
+ * @param from Where the ray starts.
+ * @param to Where the ray ends. Tiles past this point are not checked.
+ * @param hit Set to the blocking tile, where the ray entered it, and the side it entered through, if there is one.
+ * If the ray starts inside a blocking tile, the point is where it starts and the normal is zero.
+ * @return Boolean. True = a tile blocks the ray, False = the way is clear.
+ */
+bool td::Map::raycast(td::Map::TileMask types, const sf::Vector2f& from, const sf::Vector2f& to, RayHit& hit) const {
+    const td::LevelTemplate& level = *this->level;
+    if (level.tile_size <= 0 || level.rows <= 0 || level.cols <= 0) return false;
+    auto tile_size = (float)level.tile_size;
+    const sf::Vector2f delta = to - from;
+
+    // Clip the line to the map, as times from 0 (at from) to 1 (at to)
+    float t_start = 0;
+    float t_end = 1;
+    int clipped = -1;  // The axis along which the line enters the map, if it starts off the map
+    const float start[2] = {from.x, from.y};
+    const float motion[2] = {delta.x, delta.y};
+    const float extent[2] = {(float)level.cols * tile_size, (float)level.rows * tile_size};
+    for (int axis=0; axis<2; axis++) {
+        if (motion[axis] == 0) {
+            if (start[axis] < 0 || start[axis] > extent[axis]) return false;
+            continue;
+        }
+        float t_low = (0 - start[axis]) / motion[axis];
+        float t_high = (extent[axis] - start[axis]) / motion[axis];
+        if (t_low > t_high) std::swap(t_low, t_high);
+        if (t_low > t_start) {
+            t_start = t_low;
+            clipped = axis;
+        }
+        t_end = std::min(t_end, t_high);
+    }
+    if (t_start > t_end) return false;
+
+    // The tile the clipped line starts in. On a tile edge, take the tile on the side the ray moves toward
+    int cell[2];
+    const int cells[2] = {level.cols, level.rows};
+    float t_next[2];
+    float t_step[2];
+    int step[2];
+    for (int axis=0; axis<2; axis++) {
+        float position = (start[axis] + motion[axis] * t_start) / tile_size;
+        cell[axis] = motion[axis] < 0 ? (int)std::ceil(position) - 1 : (int)std::floor(position);
+        cell[axis] = std::min(cells[axis] - 1, std::max(0, cell[axis]));
+        if (motion[axis] == 0) {
+            step[axis] = 0;
+            t_next[axis] = std::numeric_limits<float>::infinity();
+            t_step[axis] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        step[axis] = motion[axis] > 0 ? 1 : -1;
+        float boundary = (float)(motion[axis] > 0 ? cell[axis] + 1 : cell[axis]) * tile_size;
+        t_next[axis] = (boundary - start[axis]) / motion[axis];
+        t_step[axis] = tile_size / std::abs(motion[axis]);
+    }
+
+    // Walk from tile to tile, always crossing whichever tile edge comes first
+    const TileIndex* grid = level.tileData();
+    float t = t_start;
+    int entered = clipped;  // The axis crossed to enter the current tile, or -1 if the line starts in it
+    while (true) {
+        const PaletteEntry& entry = level.palette[grid[cell[1] * level.cols + cell[0]]];
+        if (level.type_masks[(unsigned char)entry.type_id] & types) {
+            hit.tile = td::Tile(entry.sprite_id, entry.type_id, cell[1], cell[0]);
+            hit.point = from + delta * t;
+            hit.normal = sf::Vector2f(entered == 0 ? (float)-step[0] : 0.f, entered == 1 ? (float)-step[1] : 0.f);
+            hit.distance = t * std::sqrt(delta.x * delta.x + delta.y * delta.y);
+            return true;
+        }
+        int axis = t_next[0] <= t_next[1] ? 0 : 1;
+        if (t_next[axis] > t_end) return false;
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= cells[axis]) return false;
+        t = t_next[axis];
+        t_next[axis] += t_step[axis];
+        entered = axis;
+    }
+}
+
+/**
+ * @brief Check if nothing of certain tile types lies between two points, such as an enemy and the player.
+ * See td::Map::raycast.
+ * @param types A bitmask of tile types that block sight, built with td::Map::mask.
+ * @param from One point.
+ * @param to The other point.
+ * @return Boolean. True = the points can see each other, False = a tile is in the way.
+ */
+bool td::Map::lineOfSight(td::Map::TileMask types, const sf::Vector2f& from, const sf::Vector2f& to) const {
+    RayHit hit;
+    return !this->raycast(types, from, to, hit);
+}
+
+/**
+ * @brief Run a line of sight test for each of a number of rays, into a bitmask with one bit per ray.
+ * Past td::Map::PARALLEL_RAYS rays, the rays are split between the threads of td::WorkerPool::shared in runs of
+ * whole 64-bit words, so that no two threads write to the same word.
+ * @param count The number of rays.
+ * @param visible Set to one bit per ray, 1 if the ray is clear. Bit i is (visible[i / 64] >> (i % 64)) & 1.
+ * @param clear A function taking a ray's index, and returning whether the ray is clear.
+ */
+template <typename Clear>
+static void testRays(std::size_t count, std::vector<std::uint64_t>& visible, const Clear& clear) {
+    std::size_t words = (count + 63) / 64;
+    visible.assign(words, 0);
+    auto testWords = [&](std::size_t first, std::size_t last) {
+        for (std::size_t word=first; word<last; word++) {
+            std::uint64_t bits = 0;
+            std::size_t end = std::min(count, (word + 1) * 64);
+            for (std::size_t i=word*64; i<end; i++) {
+                if (clear(i)) bits |= (std::uint64_t)1 << (i % 64);
+            }
+            visible[word] = bits;
+        }
+    };
+
+    std::size_t runs = count / td::Map::PARALLEL_RAYS;
+    if (runs <= 1) {
+        testWords(0, words);
+        return;
+    }
+    td::WorkerPool& pool = td::WorkerPool::shared();
+    runs = std::min(runs, pool.getWorkerCount() + 1);
+    std::size_t per_run = (words + runs - 1) / runs;
+    pool.run(runs, [&](std::size_t run) {
+        testWords(std::min(words, run * per_run), std::min(words, (run + 1) * per_run));
+    });
+}
+
+/**
+ * @brief Check line of sight from many points to one, such as from every enemy to the player, as a batch.
+ * Large batches are split between threads; see td::Map::PARALLEL_RAYS. See td::Map::raycast.
+ * @param types A bitmask of tile types that block sight, built with td::Map::mask.
+ * @param from The points to look from.
+ * @param to The point to look at.
+ * @param visible Set to one bit per point, 1 if it can see the target. Bit i is (visible[i / 64] >> (i % 64)) & 1.
+ */
+void td::Map::lineOfSight(td::Map::TileMask types, const std::vector<sf::Vector2f>& from, const sf::Vector2f& to,
+                          std::vector<std::uint64_t>& visible) const {
+    testRays(from.size(), visible, [&](std::size_t i) { return this->lineOfSight(types, from[i], to); });
+}
+
+/**
+ * @brief Check line of sight between many pairs of points as a batch.
+ * Large batches are split between threads; see td::Map::PARALLEL_RAYS. See td::Map::raycast.
+ * @param types A bitmask of tile types that block sight, built with td::Map::mask.
+ * @param from The first point of each pair.
+ * @param to The second point of each pair. Must be the same length as from.
+ * @param visible Set to one bit per pair, 1 if the points can see each other. Bit i is
+ * (visible[i / 64] >> (i % 64)) & 1.
+ */
+void td::Map::lineOfSight(td::Map::TileMask types, const std::vector<sf::Vector2f>& from,
+                          const std::vector<sf::Vector2f>& to, std::vector<std::uint64_t>& visible) const {
+    if (from.size() != to.size()) {
+        throw std::invalid_argument("Line of sight needs as many end points as start points.");
+    }
+    testRays(from.size(), visible, [&](std::size_t i) { return this->lineOfSight(types, from[i], to[i]); });
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* Rooms */
+
+const int td::Rooms::NONE;
+
+/**
+ * @brief Check if a tile is open, meaning not a wall. Tiles off the map are closed.
+ * @param level The level to look in.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @return Boolean. True = open, False = a wall or off the map.
+ */
+bool td::Rooms::isOpen(const td::LevelTemplate& level, int row, int col) {
+    if (row < 0 || col < 0 || row >= level.rows || col >= level.cols) return false;
+    char type_id = level.palette[level.tileData()[row * level.cols + col]].type_id;
+    return (level.type_masks[(unsigned char)type_id] & td::Map::mask(td::Map::TileTypes::WALL)) == 0;
+}
+
+/**
+ * @brief Check if an open tile is a doorway: a DOOR tile, or a tile with at least two open neighbors that is not
+ * part of any open 2 x 2 block.
+ * @param level The level to look in.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @return Boolean. True = doorway, False = part of a room.
+ */
+bool td::Rooms::isDoorway(const td::LevelTemplate& level, int row, int col) {
+    char type_id = level.palette[level.tileData()[row * level.cols + col]].type_id;
+    if (level.type_masks[(unsigned char)type_id] & td::Map::mask(td::Map::TileTypes::DOOR)) return true;
+    int open_neighbors = (int)isOpen(level, row-1, col) + (int)isOpen(level, row+1, col) +
+                         (int)isOpen(level, row, col-1) + (int)isOpen(level, row, col+1);
+    if (open_neighbors < 2) return false;
+    for (int r=row-1; r<=row; r++) {
+        for (int c=col-1; c<=col; c++) {
+            if (isOpen(level, r, c) && isOpen(level, r+1, c) && isOpen(level, r, c+1) && isOpen(level, r+1, c+1))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Get an unused room id, reusing the ids of rooms removed by td::Rooms::update.
+ * @return The new room's id.
+ */
+int td::Rooms::newRoom() {
+    if (!this->free_ids.empty()) {
+        int id = this->free_ids.back();
+        this->free_ids.pop_back();
+        return id;
+    }
+    this->rooms.emplace_back();
+    return (int)this->rooms.size() - 1;
+}
+
+/**
+ * @brief Flood fill a room or doorway from one of its tiles, through unlabeled open tiles of the same kind.
+ * @param level The level to look in.
+ * @param start The first tile's cell, row * cols + col.
+ * @param id The id to label the tiles with.
+ */
+void td::Rooms::fill(const td::LevelTemplate& level, std::uint32_t start, int id) {
+    Room& room = this->rooms[id];
+    room.doorway = isDoorway(level, (int)start / this->cols, (int)start % this->cols);
+    int r_min = this->rows, c_min = this->cols, r_max = -1, c_max = -1;
+
+    std::vector<std::uint32_t> stack = {start};
+    this->labels[start] = id;
+    while (!stack.empty()) {
+        std::uint32_t cell = stack.back();
+        stack.pop_back();
+        room.cells.push_back(cell);
+        int r = (int)cell / this->cols;
+        int c = (int)cell % this->cols;
+        r_min = std::min(r_min, r); r_max = std::max(r_max, r);
+        c_min = std::min(c_min, c); c_max = std::max(c_max, c);
+
+        const int neighbors[4][2] = {{r-1, c}, {r+1, c}, {r, c-1}, {r, c+1}};
+        for (const auto& neighbor : neighbors) {
+            if (!isOpen(level, neighbor[0], neighbor[1])) continue;
+            auto next = (std::uint32_t)(neighbor[0] * this->cols + neighbor[1]);
+            if (this->labels[next] != NONE || isDoorway(level, neighbor[0], neighbor[1]) != room.doorway) continue;
+            this->labels[next] = id;
+            stack.push_back(next);
+        }
+    }
+    std::sort(room.cells.begin(), room.cells.end());
+    room.bounds = sf::IntRect(c_min, r_min, c_max - c_min + 1, r_max - r_min + 1);
+}
+
+/**
+ * @brief Find a room's neighbors in the room graph: the other rooms and doorways its tiles touch.
+ * @param id The room's id.
+ */
+void td::Rooms::link(int id) {
+    Room& room = this->rooms[id];
+    room.neighbors.clear();
+    for (std::uint32_t cell : room.cells) {
+        int r = (int)cell / this->cols;
+        int c = (int)cell % this->cols;
+        const int neighbors[4][2] = {{r-1, c}, {r+1, c}, {r, c-1}, {r, c+1}};
+        for (const auto& neighbor : neighbors) {
+            int other = this->getRoomAt(neighbor[0], neighbor[1]);
+            if (other != NONE && other != id) room.neighbors.push_back(other);
+        }
+    }
+    std::sort(room.neighbors.begin(), room.neighbors.end());
+    room.neighbors.erase(std::unique(room.neighbors.begin(), room.neighbors.end()), room.neighbors.end());
+}
+
+/**
+ * @brief Label every open tile of a level with its room or doorway, and build the room graph. One pass over the map.
+ * @param level The level to segment.
+ */
+void td::Rooms::build(const td::LevelTemplate& level) {
+    this->clear();
+    this->rows = level.rows;
+    this->cols = level.cols;
+    this->labels.assign((std::size_t)this->rows * this->cols, NONE);
+    for (int r=0; r<this->rows; r++) {
+        for (int c=0; c<this->cols; c++) {
+            auto cell = (std::uint32_t)(r * this->cols + c);
+            if (this->labels[cell] == NONE && isOpen(level, r, c)) this->fill(level, cell, this->newRoom());
+        }
+    }
+    for (int id=0; id<(int)this->rooms.size(); id++) {
+        this->link(id);
+    }
+    this->built = true;
+}
+
+/**
+ * @brief Label the tiles around a changed tile again. Does nothing if the rooms have not been built.
+ * A tile's kind depends on its 8 surrounding tiles, so a change can only join or split the rooms and doorways
+ * within two tiles of it. Those are removed and filled again, and the rest of the map is left alone.
+ * @param level The level, after the change.
+ * @param row The changed tile's row.
+ * @param col The changed tile's column.
+ */
+void td::Rooms::update(const td::LevelTemplate& level, int row, int col) {
+    if (!this->built) return;
+    if (level.rows != this->rows || level.cols != this->cols) {
+        this->build(level);
+        return;
+    }
+
+    // Remove the rooms near the tile, remembering their tiles and the rooms around them
+    std::vector<int> removed;
+    for (int r=row-2; r<=row+2; r++) {
+        for (int c=col-2; c<=col+2; c++) {
+            int id = this->getRoomAt(r, c);
+            if (id != NONE && std::find(removed.begin(), removed.end(), id) == removed.end()) removed.push_back(id);
+        }
+    }
+    std::vector<std::uint32_t> cells = {(std::uint32_t)(row * this->cols + col)};
+    std::vector<int> outside;
+    for (int id : removed) {
+        Room& room = this->rooms[id];
+        cells.insert(cells.end(), room.cells.begin(), room.cells.end());
+        for (int neighbor : room.neighbors) {
+            if (std::find(removed.begin(), removed.end(), neighbor) == removed.end()) outside.push_back(neighbor);
+        }
+        room.cells.clear();
+        room.neighbors.clear();
+        this->free_ids.push_back(id);
+    }
+    for (std::uint32_t cell : cells) {
+        this->labels[cell] = NONE;
+    }
+    for (int id : outside) {
+        std::vector<int>& neighbors = this->rooms[id].neighbors;
+        neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(), [&removed](int neighbor) {
+            return std::find(removed.begin(), removed.end(), neighbor) != removed.end();
+        }), neighbors.end());
+    }
+
+    // Fill the freed tiles again, and link the new rooms into the graph
+    std::vector<int> created;
+    for (std::uint32_t cell : cells) {
+        if (this->labels[cell] != NONE || !isOpen(level, (int)cell / this->cols, (int)cell % this->cols)) continue;
+        int id = this->newRoom();
+        this->fill(level, cell, id);
+        created.push_back(id);
+    }
+    for (int id : created) {
+        this->link(id);
+        for (int neighbor : this->rooms[id].neighbors) {
+            std::vector<int>& neighbors = this->rooms[neighbor].neighbors;
+            auto it = std::lower_bound(neighbors.begin(), neighbors.end(), id);
+            if (it == neighbors.end() || *it != id) neighbors.insert(it, id);
+        }
+    }
+}
+
+/**
+ * @brief Remove all rooms.
+ */
+void td::Rooms::clear() {
+    this->rows = 0;
+    this->cols = 0;
+    this->built = false;
+    this->labels.clear();
+    this->rooms.clear();
+    this->free_ids.clear();
+}
+
+/**
+ * @brief Check if the rooms have been built.
+ * @return Boolean. True = built, False = not built.
+ */
+bool td::Rooms::isBuilt() const {
+    return this->built;
+}
+
+/**
+ * @brief Get the room or doorway a tile belongs to. O(1) lookup.
+ * @param row The tile's row.
+ * @param col The tile's column.
+ * @return The room's id, or td::Rooms::NONE for walls, tiles off the map, or when the rooms are not built.
+ */
+int td::Rooms::getRoomAt(int row, int col) const {
+    if (row < 0 || col < 0 || row >= this->rows || col >= this->cols) return NONE;
+    return this->labels[row * this->cols + col];
+}
+
+/**
+ * @brief Get a room or doorway by id.
+ * @param id The room's id.
+ * @return A reference to the room. An id freed by td::Rooms::update and not yet reused has no tiles.
+ */
+const td::Rooms::Room& td::Rooms::getRoom(int id) const {
+    if (id < 0 || id >= (int)this->rooms.size())
+        throw std::invalid_argument("Invalid room id " + std::to_string(id) + ".");
+    return this->rooms[id];
+}
+
+/**
+ * @brief Get the number of room ids in use, counting both rooms and doorways.
+ * Ids run from 0 up to this number; some may be unused after td::Rooms::update.
+ * @return The number of room ids.
+ */
+std::size_t td::Rooms::getRoomCount() const {
+    return this->rooms.size();
+}
+
+/**
+ * @brief Get the rooms that can be reached from a room by passing through one doorway.
+ * For a doorway, these are the rooms it joins.
+ * @param id The room's id.
+ * @return The ids of the connected rooms, in ascending order.
+ */
+std::vector<int> td::Rooms::getConnectedRooms(int id) const {
+    const Room& room = this->getRoom(id);
+    if (room.doorway) return room.neighbors;
+    std::vector<int> connected;
+    for (int doorway : room.neighbors) {
+        for (int other : this->rooms[doorway].neighbors) {
+            if (other != id) connected.push_back(other);
+        }
+    }
+    std::sort(connected.begin(), connected.end());
+    connected.erase(std::unique(connected.begin(), connected.end()), connected.end());
+    return connected;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* LevelTemplate */
+
+/**
+ * @brief LevelTemplate class constructor.
+ * Defines a default mapping of certain chars to tile types.
+ */
+td::LevelTemplate::LevelTemplate() {
+    this->tile_size = td::Tile::DEFAULT_TILE_SIZE;
+    this->max_allowed_tile_size = 1000;
+    this->tile_types = {
+            {td::Map::TileTypes::WALL, {'w'}},
+            {td::Map::TileTypes::START, {'s'}},
+            {td::Map::TileTypes::CHECKPOINT, {'c'}},
+            {td::Map::TileTypes::END, {'e'}},
+            {td::Map::TileTypes::DOOR, {'d'}},
+            {td::Map::TileTypes::KEY, {'k'}}
+    };
+    this->rebuildTypeMasks();
+    this->indexed_types = ~td::Map::mask(td::Map::TileTypes::WALL);
+    this->player_start_row = 0;
+    this->player_start_col = 0;
+}
+/**
+ * @brief LevelTemplate class destructor.
+ */
+td::LevelTemplate::~LevelTemplate() = default;
+
+/**
+ * @brief Find the player's start tile and the checkpoints in the tile grid, by their tile types.
+ * Checkpoints are listed in row-major order. A map without a start tile starts the player at the top-left tile.
+ */
+void td::LevelTemplate::findSpecialTiles() {
+    bool start_tile_set = false;
+    this->player_start_row = 0;
+    this->player_start_col = 0;
+    this->checkpoints.clear();
+    const td::Map::TileIndex* grid = this->tileData();
+    for (int r=0; r<this->rows; r++) {
+        for (int c=0; c<this->cols; c++) {
+            td::Map::TileMask types = this->type_masks[(unsigned char)this->palette[grid[(std::size_t)r * this->cols + c]].type_id];
+
+            // Only one start tile allowed
+            if (types & td::Map::mask(td::Map::TileTypes::START)) {
+                if (start_tile_set)
+                    throw std::invalid_argument("Multiple starting positions given. Only one allowed.");
+                this->player_start_row = r;
+                this->player_start_col = c;
+                start_tile_set = true;
+            }
+            if (types & td::Map::mask(td::Map::TileTypes::CHECKPOINT)) {
+                this->checkpoints.emplace_back(r, c);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rebuild the type_id classification table from the tile type mapper.
+ * Each of the 256 possible type_id chars gets a bitmask with one bit set per tile type it belongs to,
+ * so that checking a tile's type is a single table lookup and mask test.
+ */
+void td::LevelTemplate::rebuildTypeMasks() {
+    std::fill(std::begin(this->type_masks), std::end(this->type_masks), 0);
+    for (const auto& type_ids : this->tile_types) {
+        for (char type_id : type_ids.second) {
+            this->type_masks[(unsigned char)type_id] |= td::Map::mask(type_ids.first);
+        }
+    }
+}
+
+/**
+ * @brief Rebuild the tile type position index from the tile grid. One pass over the map.
+ * Each palette entry is classified once, and each tile is then added to the list of every indexed type it belongs to.
+ * Since the pass visits every tile, it also checks that each tile refers to an entry of the palette.
+ */
+void td::LevelTemplate::rebuildTypeIndex() {
+    for (auto& cells : this->type_cells) cells.clear();
+    std::vector<td::Map::TileMask> palette_types(this->palette.size());
+    for (std::size_t i=0; i<this->palette.size(); i++) {
+        palette_types[i] = this->type_masks[(unsigned char)this->palette[i].type_id] & this->indexed_types;
+    }
+
+    const td::Map::TileIndex* grid = this->tileData();
+    auto count = (std::uint32_t)(this->rows * this->cols);
+    for (std::uint32_t cell=0; cell<count; cell++) {
+        if (grid[cell] >= palette_types.size())
+            throw std::invalid_argument("Tile " + std::to_string(cell) + " refers to palette entry " +
+                                        std::to_string(grid[cell]) + ", but the palette has " +
+                                        std::to_string(palette_types.size()) + " entries.");
+        td::Map::TileMask types = palette_types[grid[cell]];
+        for (int type=0; types != 0; type++, types >>= 1) {
+            if (types & 1) this->type_cells[type].push_back(cell);
+        }
+    }
+}
+
+/**
+ * @brief Move one tile between the lists of the tile type position index, after the tile has changed.
+ * Keeps each list in ascending order.
+ * @param cell The tile's cell, row * cols + col.
+ * @param old_types A bitmask of the tile types the tile used to belong to.
+ * @param new_types A bitmask of the tile types the tile now belongs to.
+ */
+void td::LevelTemplate::updateTypeIndex(std::uint32_t cell, td::Map::TileMask old_types, td::Map::TileMask new_types) {
+    old_types &= this->indexed_types;
+    new_types &= this->indexed_types;
+    for (int type=0; type<=td::Map::MAX_TILE_TYPE; type++) {
+        bool was = (old_types & td::Map::mask(type)) != 0;
+        bool is = (new_types & td::Map::mask(type)) != 0;
+        if (was == is) continue;
+        std::vector<std::uint32_t>& cells = this->type_cells[type];
+        auto it = std::lower_bound(cells.begin(), cells.end(), cell);
+        if (is) cells.insert(it, cell);
+        else if (it != cells.end() && *it == cell) cells.erase(it);
+    }
+}
+
+/**
+ * @brief Merge the tile grid into rectangles of identical tiles, one chunk at a time. See td::LevelTemplate::mergeChunk.
+ */
+void td::LevelTemplate::mergeTiles() {
+    int chunk_rows = (this->rows + MERGE_CHUNK_SIZE - 1) / MERGE_CHUNK_SIZE;
+    this->rect_chunk_cols = (this->cols + MERGE_CHUNK_SIZE - 1) / MERGE_CHUNK_SIZE;
+    this->tile_rects.assign((std::size_t)chunk_rows * this->rect_chunk_cols, std::vector<TileRect>());
+    this->rect_count = 0;
+    for (int chunk_row=0; chunk_row<chunk_rows; chunk_row++) {
+        for (int chunk_col=0; chunk_col<this->rect_chunk_cols; chunk_col++) {
+            this->mergeChunk(chunk_row, chunk_col);
+        }
+    }
+}
+
+/**
+ * @brief Greedily merge one chunk's tiles into rectangles of identical tiles.
+ * Going row by row, each tile not yet merged starts a rectangle, which grows right as far as the tiles match,
+ * and then down for as long as every tile in the next row's span matches.
+ * @param chunk_row The chunk's row, in chunks.
+ * @param chunk_col The chunk's column, in chunks.
+ */
+void td::LevelTemplate::mergeChunk(int chunk_row, int chunk_col) {
+    std::vector<TileRect>& rects = this->tile_rects[chunk_row * this->rect_chunk_cols + chunk_col];
+    this->rect_count -= rects.size();
+    rects.clear();
+
+    int r0 = chunk_row * MERGE_CHUNK_SIZE;
+    int c0 = chunk_col * MERGE_CHUNK_SIZE;
+    int r1 = std::min(r0 + MERGE_CHUNK_SIZE, this->rows);
+    int c1 = std::min(c0 + MERGE_CHUNK_SIZE, this->cols);
+    bool merged[MERGE_CHUNK_SIZE][MERGE_CHUNK_SIZE]{};
+    const td::Map::TileIndex* grid = this->tileData();
+    auto matches = [&](int r, int c, td::Map::TileIndex tile) {
+        return !merged[r - r0][c - c0] && grid[r * this->cols + c] == tile;
+    };
+
+    for (int r=r0; r<r1; r++) {
+        for (int c=c0; c<c1; c++) {
+            if (merged[r - r0][c - c0]) continue;
+            td::Map::TileIndex tile = grid[r * this->cols + c];
+            int width = 1;
+            while (c + width < c1 && matches(r, c + width, tile)) width++;
+            int height = 1;
+            for (bool grow = true; grow && r + height < r1; ) {
+                for (int i=0; i<width && grow; i++) grow = matches(r + height, c + i, tile);
+                if (grow) height++;
+            }
+            for (int i=0; i<height; i++) {
+                for (int j=0; j<width; j++) merged[r - r0 + i][c - c0 + j] = true;
+            }
+            TileRect rect;
+            rect.row = r;
+            rect.col = c;
+            rect.rows = (std::uint16_t)height;
+            rect.cols = (std::uint16_t)width;
+            rect.tile = tile;
+            rects.push_back(rect);
+        }
+    }
+    this->rect_count += rects.size();
+}
+
+/**
+ * @brief Rebuild the sprite sheet from the sprite definitions, such as those read from a level manifest.
+ */
+void td::LevelTemplate::buildSpriteSheet() {
+    this->sprite_sheet = td::SpriteSheet();
+    for (const auto& sprite : this->sprites) {
+        if (sprite.texture != NO_STRING)
+            this->sprite_sheet.addTexture(sprite.sprite_id, this->resolvePath(sprite.texture));
+        else
+            this->sprite_sheet.addSprite(sprite.sprite_id, sf::Color(sprite.color));
+    }
+}
+
+/**
+ * @brief Get a path from the strings table, resolved against the level file's directory.
+ * @param string_index The path's index in the strings table.
+ * @return The path, ready to open.
+ */
+std::string td::LevelTemplate::resolvePath(std::uint32_t string_index) const {
+    return td::Util::joinPath(this->base_dir, this->strings[string_index]);
+}
+
+/**
+ * @brief Get the tile grid, whether it is owned by the template or borrowed from a compiled map file.
+ * @return A pointer to the first of rows * cols palette indices, in row-major order.
+ */
+const td::Map::TileIndex* td::LevelTemplate::tileData() const {
+    return this->external_tiles ? this->external_tiles : this->tiles.data();
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* MappedFile */
+
+/**
+ * @brief MappedFile class constructor. Maps the whole file into memory, read-only.
+ * The file and mapping handles are closed right away; the view stays valid until the object is destroyed.
+ * @param path The string path to the file.
+ */
+td::MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::invalid_argument("Could not open file at path " + path);
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::invalid_argument("Could not map empty file at path " + path);
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        throw std::invalid_argument("Could not map file at path " + path);
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr)
+        throw std::invalid_argument("Could not map file at path " + path);
+    this->address = view;
+    this->length = (std::size_t)file_size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::invalid_argument("Could not open file at path " + path);
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw std::invalid_argument("Could not map empty file at path " + path);
+    }
+    void* view = mmap(nullptr, (std::size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        throw std::invalid_argument("Could not map file at path " + path);
+    this->address = view;
+    this->length = (std::size_t)file_stat.st_size;
+#endif
+}
+/**
+ * @brief MappedFile class destructor. Unmaps the file.
+ */
+td::MappedFile::~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(this->address);
+#else
+    munmap(const_cast<void*>(this->address), this->length);
+#endif
+}
+
+/**
+ * @brief Get the start of the mapped file.
+ * @return A pointer to the file's first byte.
+ */
+const void* td::MappedFile::data() const {
+    return this->address;
+}
+
+/**
+ * @brief Get the size of the mapped file.
+ * @return The file size in bytes.
+ */
+std::size_t td::MappedFile::size() const {
+    return this->length;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* MapFile */
+
+// The compiled format stores these structs as-is, so their layout is part of the file format
+static_assert(sizeof(td::MapFile::Header) == 92, "td::MapFile::Header layout changed");
+static_assert(sizeof(td::LevelTemplate::EntityDef) == 36, "td::LevelTemplate::EntityDef layout changed");
+static_assert(sizeof(td::LevelTemplate::SpriteDef) == 12, "td::LevelTemplate::SpriteDef layout changed");
+static_assert(sizeof(td::Map::PaletteEntry) == 2, "td::Map::PaletteEntry layout changed");
+
+/**
+ * @brief Write a level template to a compiled .tdmap file.
+ * Sections are written in a fixed order, each starting on a 4-byte boundary.
+ * @param level The level template to compile, usually from a td::Map that has read in a map txt.
+ * @param path The string path of the .tdmap file to write.
+ */
+void td::MapFile::write(const td::LevelTemplate& level, const std::string& path) {
+    std::size_t tile_count = (std::size_t)level.rows * level.cols;
+    if (tile_count > 0xFFFFFFFFu / 4)
+        throw std::invalid_argument("Map is too large to compile: " + std::to_string(level.rows) + " x " +
+                                    std::to_string(level.cols) + " tiles.");
+
+    // Append a section to the file, padded to start on a 4-byte boundary. Returns the section's offset
+    std::string buffer(sizeof(Header), '\0');
+    auto append = [&buffer](const void* data, std::size_t size) {
+        while (buffer.size() % 4 != 0) buffer.push_back('\0');
+        auto offset = (std::uint32_t)buffer.size();
+        buffer.append((const char*)data, size);
+        return offset;
+    };
+
+    Header header{};
+    std::memcpy(header.magic, "TDMP", 4);
+    header.version = VERSION;
+    header.header_size = sizeof(Header);
+    header.rows = level.rows;
+    header.cols = level.cols;
+    header.tile_size = level.tile_size;
+    header.player_start_row = level.player_start_row;
+    header.player_start_col = level.player_start_col;
+
+    header.palette_count = (std::uint32_t)level.palette.size();
+    header.palette_offset = append(level.palette.data(), level.palette.size() * sizeof(td::Map::PaletteEntry));
+    header.type_masks_offset = append(level.type_masks, sizeof(level.type_masks));
+    header.tiles_offset = append(level.tileData(), tile_count * sizeof(td::Map::TileIndex));
+    header.checkpoint_count = (std::uint32_t)level.checkpoints.size();
+    header.checkpoints_offset = append(level.checkpoints.data(), level.checkpoints.size() * sizeof(sf::Vector2f));
+    header.entity_count = (std::uint32_t)level.entities.size();
+    header.entities_offset = append(level.entities.data(),
+                                    level.entities.size() * sizeof(td::LevelTemplate::EntityDef));
+    header.waypoint_count = (std::uint32_t)level.waypoints.size();
+    header.waypoints_offset = append(level.waypoints.data(), level.waypoints.size() * sizeof(sf::Vector2f));
+
+    // Strings are stored back to back, each terminated by a null char
+    std::string strings;
+    for (const std::string& str : level.strings) {
+        strings += str;
+        strings.push_back('\0');
+    }
+    header.strings_size = (std::uint32_t)strings.size();
+    header.strings_offset = append(strings.data(), strings.size());
+    header.sprite_count = (std::uint32_t)level.sprites.size();
+    header.sprites_offset = append(level.sprites.data(), level.sprites.size() * sizeof(td::LevelTemplate::SpriteDef));
+
+    while (buffer.size() % 4 != 0) buffer.push_back('\0');
+    header.file_size = (std::uint32_t)buffer.size();
+    std::memcpy(&buffer[0], &header, sizeof(Header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        throw std::invalid_argument("Could not write map at path " + path);
+    out.write(buffer.data(), (std::streamsize)buffer.size());
+    if (!out)
+        throw std::invalid_argument("Could not write map at path " + path);
+}
+
+/**
+ * @brief Load a compiled .tdmap file as a level template.
+ * The file is memory-mapped and the template's tile grid points straight into the mapping, which stays alive
+ * for as long as the template does. An embedded copy of the file (see td::Embedded) is used in place instead.
+ * Only the small tables (palette, type masks, checkpoints, entities, sprites) are copied. If the file has sprite
+ * definitions, the sprite sheet is built from them.
+ * The header (including the tile size and start tile), the section bounds, and every tile's palette index are
+ * checked, so a stale or corrupt file is rejected rather than read out of bounds.
+ * @param path The string path to a .tdmap file.
+ * @return A shared, immutable level template, ready to be given to td::Map instances.
+ */
+std::shared_ptr<const td::LevelTemplate> td::MapFile::load(const std::string& path) {
+    // Embedded maps are read in place. Otherwise the file is mapped, and the mapping is kept alive by the template
+    const td::EmbeddedFile* embedded = td::Embedded::find(path);
+    std::shared_ptr<td::MappedFile> file;
+    if (!embedded) file = std::make_shared<td::MappedFile>(path);
+    const auto* bytes = embedded ? embedded->data : (const unsigned char*)file->data();
+    std::size_t size = embedded ? embedded->size : file->size();
+
+    // Check the header
+    Header header{};
+    if (size < sizeof(Header))
+        throw std::invalid_argument("Map at path " + path + " is too small to be a compiled map.");
+    std::memcpy(&header, bytes, sizeof(Header));
+    if (std::memcmp(header.magic, "TDMP", 4) != 0)
+        throw std::invalid_argument("Map at path " + path + " is not a compiled map.");
+    if (header.version != VERSION)
+        throw std::invalid_argument("Map at path " + path + " has format version " + std::to_string(header.version) +
+                                    ", expected " + std::to_string(VERSION) + ". Recompile it with tdmapc.");
+
+    // Check that every section lies inside the file
+    std::uint64_t tile_count = (std::uint64_t)(header.rows < 0 ? 0 : header.rows) * (header.cols < 0 ? 0 : header.cols);
+    auto inFile = [size](std::uint64_t offset, std::uint64_t count, std::uint64_t element_size) {
+        return offset % 4 == 0 && offset + count * element_size <= size;
+    };
+    if (header.header_size != sizeof(Header) || header.file_size != size || header.rows < 0 || header.cols < 0 ||
+        header.tile_size <= 0 ||
+        (tile_count > 0 && (header.player_start_row < 0 || header.player_start_row >= header.rows ||
+                            header.player_start_col < 0 || header.player_start_col >= header.cols)) ||
+        (tile_count > 0 && header.palette_count == 0) ||
+        !inFile(header.palette_offset, header.palette_count, sizeof(td::Map::PaletteEntry)) ||
+        !inFile(header.type_masks_offset, 256, sizeof(td::Map::TileMask)) ||
+        !inFile(header.tiles_offset, tile_count, sizeof(td::Map::TileIndex)) ||
+        !inFile(header.checkpoints_offset, header.checkpoint_count, sizeof(sf::Vector2f)) ||
+        !inFile(header.entities_offset, header.entity_count, sizeof(td::LevelTemplate::EntityDef)) ||
+        !inFile(header.waypoints_offset, header.waypoint_count, sizeof(sf::Vector2f)) ||
+        !inFile(header.strings_offset, header.strings_size, 1) ||
+        !inFile(header.sprites_offset, header.sprite_count, sizeof(td::LevelTemplate::SpriteDef)) ||
+        (header.strings_size > 0 && bytes[header.strings_offset + header.strings_size - 1] != '\0'))
+        throw std::invalid_argument("Map at path " + path + " is truncated or corrupt.");
+
+    auto level = std::make_shared<td::LevelTemplate>();
+    level->rows = header.rows;
+    level->cols = header.cols;
+    level->tile_size = header.tile_size;
+    level->player_start_row = header.player_start_row;
+    level->player_start_col = header.player_start_col;
+
+    // Borrow the tile grid from the mapping
+    level->external_tiles = (const td::Map::TileIndex*)(bytes + header.tiles_offset);
+    level->backing = file;
+
+    // Copy the small tables
+    level->palette.resize(header.palette_count);
+    std::memcpy(level->palette.data(), bytes + header.palette_offset,
+                header.palette_count * sizeof(td::Map::PaletteEntry));
+    std::memcpy(level->type_masks, bytes + header.type_masks_offset, sizeof(level->type_masks));
+    level->checkpoints.resize(header.checkpoint_count);
+    std::memcpy(level->checkpoints.data(), bytes + header.checkpoints_offset,
+                header.checkpoint_count * sizeof(sf::Vector2f));
+    level->entities.resize(header.entity_count);
+    std::memcpy(level->entities.data(), bytes + header.entities_offset,
+                header.entity_count * sizeof(td::LevelTemplate::EntityDef));
+    level->waypoints.resize(header.waypoint_count);
+    std::memcpy(level->waypoints.data(), bytes + header.waypoints_offset,
+                header.waypoint_count * sizeof(sf::Vector2f));
+    const char* str = (const char*)bytes + header.strings_offset;
+    const char* strings_end = str + header.strings_size;
+    while (str < strings_end) {
+        level->strings.emplace_back(str);
+        str += level->strings.back().size() + 1;
+    }
+    level->sprites.resize(header.sprite_count);
+    std::memcpy(level->sprites.data(), bytes + header.sprites_offset,
+                header.sprite_count * sizeof(td::LevelTemplate::SpriteDef));
+    for (const auto& entity : level->entities) {
+        if ((std::uint64_t)entity.first_waypoint + entity.waypoint_count > level->waypoints.size() ||
+            (entity.texture != td::LevelTemplate::NO_STRING && entity.texture >= level->strings.size()))
+            throw std::invalid_argument("Map at path " + path + " is truncated or corrupt.");
+    }
+    for (const auto& sprite : level->sprites) {
+        if (sprite.texture != td::LevelTemplate::NO_STRING && sprite.texture >= level->strings.size())
+            throw std::invalid_argument("Map at path " + path + " is truncated or corrupt.");
+    }
+
+    // Paths in the strings table are relative to the compiled map
+    level->base_dir = td::Util::directoryOf(path);
+    if (!level->sprites.empty()) level->buildSpriteSheet();
+
+    // Rebuild the tile type mapper from the classification table
+    level->tile_types.clear();
+    for (int type_id=0; type_id<256; type_id++) {
+        for (int type=0; type<=td::Map::MAX_TILE_TYPE; type++) {
+            if (level->type_masks[type_id] & td::Map::mask(type))
+                level->tile_types[type].push_back((char)type_id);
+        }
+    }
+    try {
+        level->rebuildTypeIndex();
+    } catch (const std::invalid_argument& error) {
+        throw std::invalid_argument("Map at path " + path + " is truncated or corrupt. " + error.what());
+    }
+    level->mergeTiles();
+    return level;
+}
+
+/**
+ * @brief Check a map txt for problems that would stop it from loading or compiling.
+ * Unlike td::Map::readMap, which stops at the first problem, every problem in the file is reported.
+ * Looks for rows with an odd number of characters, rows whose width differs from the first row,
+ * and more than one starting tile.
+ * @param txt_path The string path to a map file txt.
+ * @param types A level template whose tile type mapper decides which type_id chars are starting tiles.
+ * @return A description of each problem found. Empty if the map is valid.
+ */
+std::vector<std::string> td::MapFile::validate(const std::string& txt_path, const td::LevelTemplate& types) {
+    std::vector<std::string> problems;
+    std::unique_ptr<std::istream> mapFile = td::Embedded::open(txt_path);
+    if (!*mapFile) {
+        problems.push_back("Could not load map at path " + txt_path);
+        return problems;
+    }
+
+    std::string line;
+    int r = 0;
+    std::size_t cols = 0;
+    int start_row = -1, start_col = -1;
+    while (std::getline(*mapFile, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::string where = txt_path + ":" + std::to_string(r + 1) + ": ";
+        if (line.length() % 2 != 0)
+            problems.push_back(where + "row has an odd number of characters (" + std::to_string(line.length()) + ").");
+        if (r == 0)
+            cols = line.length()/2;
+        else if (line.length()/2 != cols)
+            problems.push_back(where + "row is " + std::to_string(line.length()/2) + " tiles wide, but the first row is " +
+                               std::to_string(cols) + " tiles wide.");
+
+        for (std::size_t c=0; c+1<line.length(); c+=2) {
+            if ((types.type_masks[(unsigned char)line[c+1]] & td::Map::mask(td::Map::TileTypes::START)) == 0) continue;
+            if (start_row == -1) {
+                start_row = r;
+                start_col = (int)c/2;
+            } else {
+                problems.push_back(where + "extra starting tile at column " + std::to_string(c/2) +
+                                   ". The first is at row " + std::to_string(start_row) + ", column " +
+                                   std::to_string(start_col) + ". Only one allowed.");
+            }
+        }
+        r++;
+    }
+    return problems;
+}
+
+/**
+ * @brief Check whether a path names a compiled map, by its .tdmap extension.
+ * @param path The string path to a map file.
+ * @return True if the path ends in .tdmap.
+ */
+bool td::MapFile::isCompiled(const std::string& path) {
+    static const std::string extension = ".tdmap";
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* LevelManifest */
+
+/**
+ * @brief Read a number from a manifest line.
+ * @param words The line's words.
+ * @param i The index of the word to read. Advanced past it.
+ * @param where The file and line, for error messages.
+ * @return The number.
+ */
+static float readManifestNumber(const std::vector<std::string>& words, std::size_t& i, const std::string& where) {
+    if (i >= words.size())
+        throw std::invalid_argument(where + "expected a number after '" + words[i-1] + "'.");
+    try {
+        std::size_t used = 0;
+        float value = std::stof(words[i], &used);
+        if (used != words[i].size()) throw std::invalid_argument(words[i]);
+        i++;
+        return value;
+    } catch (const std::exception&) {
+        throw std::invalid_argument(where + "'" + words[i] + "' is not a number.");
+    }
+}
+
+/**
+ * @brief Check whether the next word on a manifest line is a number, for optional values.
+ * @param words The line's words.
+ * @param i The index of the word to check.
+ * @return True if there is a next word and it is a number.
+ */
+static bool isManifestNumber(const std::vector<std::string>& words, std::size_t i) {
+    return i < words.size() && !words[i].empty() && words[i].find_first_not_of("0123456789.-") == std::string::npos;
+}
+
+/**
+ * @brief Read a color from a manifest line: red, green, and blue, with an optional alpha.
+ * @param words The line's words.
+ * @param i The index of the first component. Advanced past the color.
+ * @param where The file and line, for error messages.
+ * @return The color, packed as by sf::Color::toInteger.
+ */
+static std::uint32_t readManifestColor(const std::vector<std::string>& words, std::size_t& i, const std::string& where) {
+    auto r = (sf::Uint8)readManifestNumber(words, i, where);
+    auto g = (sf::Uint8)readManifestNumber(words, i, where);
+    auto b = (sf::Uint8)readManifestNumber(words, i, where);
+    auto a = isManifestNumber(words, i) ? (sf::Uint8)readManifestNumber(words, i, where) : (sf::Uint8)255;
+    return sf::Color(r, g, b, a).toInteger();
+}
+
+/**
+ * @brief Read a tile position ("row,col") from a manifest line.
+ * @param word The word to read.
+ * @param where The file and line, for error messages.
+ * @param tile Set to the position, with the row in x and the column in y, as td::Enemy::setWaypoints expects.
+ * @return False if the word is not a tile position.
+ */
+static bool readManifestTile(const std::string& word, const std::string& where, sf::Vector2f& tile) {
+    std::size_t comma = word.find(',');
+    if (comma == std::string::npos) return false;
+    std::vector<std::string> parts = {word.substr(0, comma), word.substr(comma + 1)};
+    std::size_t i = 0;
+    tile.x = readManifestNumber(parts, i, where);
+    tile.y = readManifestNumber(parts, i, where);
+    return true;
+}
+
+/**
+ * @brief LevelManifest class constructor. Parses a manifest, and any manifests it includes, into tables.
+ *
+ * A manifest is a text file with one directive per line. Blank lines and lines starting with # are ignored.
+ * Paths are relative to the file they appear in.
+ * - include <path>: read another manifest here, such as a sprite sheet shared by several levels
+ * - tiles <path>: the map file (txt or .tdmap)
+ * - tile_size <n>
+ * - type <WALL|START|CHECKPOINT|END|DOOR|KEY|number> <type_id chars>
+ * - sprite <sprite_id> color <r> <g> <b> [<a>], or sprite <sprite_id> texture <path>
+ * - checkpoint_order <index>...: the order in which the map's checkpoints (as read, row by row) are used
+ * - enemy <properties> path <row>,<col>...: an enemy that follows waypoints, given in tiles
+ * - item <properties> at <row>,<col>
+ * - defaults <enemy|item> <properties>: properties for the enemies or items that follow
+ * Properties are speed <n>, size <width> [<height>] (in tiles), harm <n>, color <r> <g> <b> [<a>],
+ * texture <path>, and move <loop|back_and_forth>.
+ * @param path The string path to a .level manifest.
+ */
+td::LevelManifest::LevelManifest(const std::string& path) {
+    this->base_dir = td::Util::directoryOf(path);
+
+    this->enemy_defaults.kind = td::LevelTemplate::EntityKind::ENEMY;
+    this->enemy_defaults.move_option = td::Enemy::MoveOptions::LOOP;
+    this->enemy_defaults.speed = 50;
+    this->enemy_defaults.width = 1;
+    this->enemy_defaults.height = 1;
+    this->enemy_defaults.harm = 1;
+    this->enemy_defaults.color = sf::Color::Blue.toInteger();
+
+    this->item_defaults.kind = td::LevelTemplate::EntityKind::ITEM;
+    this->item_defaults.width = 1;
+    this->item_defaults.height = 1;
+    this->item_defaults.color = sf::Color::Yellow.toInteger();
+
+    this->parse(path, "", 0);
+}
+/**
+ * @brief LevelManifest class destructor.
+ */
+td::LevelManifest::~LevelManifest() = default;
+
+/**
+ * @brief Parse one manifest file.
+ * @param path The string path to the file.
+ * @param prefix The file's directory relative to the top-level manifest, prepended to the paths it names.
+ * @param depth How deeply the file is included, to stop include cycles.
+ */
+void td::LevelManifest::parse(const std::string& path, const std::string& prefix, int depth) {
+    if (depth > 8)
+        throw std::invalid_argument("Level manifest includes are nested too deeply at " + path);
+    std::unique_ptr<std::istream> manifestFile = td::Embedded::open(path);
+    if (!*manifestFile)
+        throw std::invalid_argument("Could not load level manifest at path " + path);
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(*manifestFile, line)) {
+        line_number++;
+        std::istringstream stream(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (stream >> word) words.push_back(word);
+        if (words.empty() || words[0][0] == '#') continue;
+
+        std::string where = path + ":" + std::to_string(line_number) + ": ";
+        const std::string& directive = words[0];
+        std::size_t i = 1;
+        if (directive != "checkpoint_order" && directive != "enemy" && directive != "item" && words.size() < 2)
+            throw std::invalid_argument(where + "'" + directive + "' needs a value.");
+
+        if (directive == "include") {
+            std::string included = td::Util::joinPath(prefix, words[1]);
+            this->parse(td::Util::joinPath(td::Util::directoryOf(path), words[1]), td::Util::directoryOf(included),
+                        depth + 1);
+        } else if (directive == "tiles") {
+            this->tiles = td::Util::joinPath(prefix, words[1]);
+        } else if (directive == "tile_size") {
+            this->tile_size = (int)readManifestNumber(words, i, where);
+        } else if (directive == "type") {
+            int type = td::Map::tileTypeFromName(words[1]);
+            if (type < 0 || words.size() != 3)
+                throw std::invalid_argument(where + "expected 'type <tile type> <type_id chars>'.");
+            this->tile_types.emplace_back(type, std::vector<char>(words[2].begin(), words[2].end()));
+        } else if (directive == "sprite") {
+            if (words[1].size() != 1 || words.size() < 4)
+                throw std::invalid_argument(where + "expected 'sprite <sprite_id> color <r> <g> <b>' or "
+                                                    "'sprite <sprite_id> texture <path>'.");
+            td::LevelTemplate::SpriteDef sprite;
+            sprite.sprite_id = words[1][0];
+            i = 3;
+            if (words[2] == "color")
+                sprite.color = readManifestColor(words, i, where);
+            else if (words[2] == "texture")
+                sprite.texture = this->addString(td::Util::joinPath(prefix, words[i++]));
+            else
+                throw std::invalid_argument(where + "unknown sprite kind '" + words[2] + "'.");
+            this->sprites.push_back(sprite);
+        } else if (directive == "checkpoint_order") {
+            while (i < words.size()) this->checkpoint_order.push_back((int)readManifestNumber(words, i, where));
+        } else if (directive == "defaults") {
+            if (words[1] == "enemy")
+                this->parseEntity(words, 2, prefix, where, this->enemy_defaults, true);
+            else if (words[1] == "item")
+                this->parseEntity(words, 2, prefix, where, this->item_defaults, true);
+            else
+                throw std::invalid_argument(where + "expected 'defaults enemy' or 'defaults item'.");
+        } else if (directive == "enemy" || directive == "item") {
+            td::LevelTemplate::EntityDef entity = directive == "enemy" ? this->enemy_defaults : this->item_defaults;
+            entity.first_waypoint = (std::uint32_t)this->waypoints.size();
+            entity.waypoint_count = 0;
+            this->parseEntity(words, 1, prefix, where, entity, false);
+            if (entity.waypoint_count == 0)
+                throw std::invalid_argument(where + (directive == "enemy" ? "enemy needs a path." : "item needs a position."));
+            this->entities.push_back(entity);
+        } else {
+            throw std::invalid_argument(where + "unknown directive '" + directive + "'.");
+        }
+        if (i < words.size() && directive != "include" && directive != "tiles" && directive != "type" &&
+            directive != "defaults" && directive != "enemy" && directive != "item")
+            throw std::invalid_argument(where + "unexpected '" + words[i] + "'.");
+    }
+}
+
+/**
+ * @brief Parse the properties of an enemy or item.
+ * @param words The line's words.
+ * @param i The index of the first property.
+ * @param prefix The manifest's directory relative to the top-level manifest.
+ * @param where The file and line, for error messages.
+ * @param entity The definition to fill in. Waypoints are appended to the waypoints table.
+ * @param defaults True when parsing defaults, which may not have a position.
+ */
+void td::LevelManifest::parseEntity(const std::vector<std::string>& words, std::size_t i, const std::string& prefix,
+                                    const std::string& where, td::LevelTemplate::EntityDef& entity, bool defaults) {
+    while (i < words.size()) {
+        const std::string& property = words[i++];
+        if (property == "speed") {
+            entity.speed = readManifestNumber(words, i, where);
+        } else if (property == "size") {
+            entity.width = readManifestNumber(words, i, where);
+            entity.height = isManifestNumber(words, i) ? readManifestNumber(words, i, where) : entity.width;
+        } else if (property == "harm") {
+            entity.harm = (std::int32_t)readManifestNumber(words, i, where);
+        } else if (property == "color") {
+            entity.color = readManifestColor(words, i, where);
+        } else if (property == "texture" && i < words.size()) {
+            entity.texture = this->addString(td::Util::joinPath(prefix, words[i++]));
+        } else if (property == "move" && i < words.size()) {
+            std::string option = words[i++];
+            if (option == "loop") entity.move_option = td::Enemy::MoveOptions::LOOP;
+            else if (option == "back_and_forth") entity.move_option = td::Enemy::MoveOptions::BACK_AND_FORTH;
+            else throw std::invalid_argument(where + "unknown move option '" + option + "'.");
+        } else if ((property == "path" || property == "at") && !defaults) {
+            sf::Vector2f tile;
+            while (i < words.size() && readManifestTile(words[i], where, tile)) {
+                this->waypoints.push_back(tile);
+                entity.waypoint_count++;
+                i++;
+                if (property == "at") break;
+            }
+        } else {
+            throw std::invalid_argument(where + "unexpected '" + property + "'.");
+        }
+    }
+}
+
+/**
+ * @brief Add a string to the strings table, reusing an existing entry if there is one.
+ * @param str The string to add.
+ * @return The string's index in the table.
+ */
+std::uint32_t td::LevelManifest::addString(const std::string& str) {
+    int index = td::Util::find(this->strings, str);
+    if (index != -1) return (std::uint32_t)index;
+    this->strings.push_back(str);
+    return (std::uint32_t)(this->strings.size() - 1);
+}
+
+/**
+ * @brief Check whether a path names a level manifest, by its .level extension.
+ * @param path The string path to a file.
+ * @return True if the path ends in .level.
+ */
+bool td::LevelManifest::isManifest(const std::string& path) {
+    static const std::string extension = ".level";
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* World */
+
+static_assert(sizeof(td::World::Header) == 36, "td::World::Header layout changed");
+
+/**
+ * @brief World class constructor. Reads the world's index file and starts the chunk loader thread.
+ * No chunks are loaded until update() is called.
+ * @param path The string path to a .tdworld index file, as written by tdmapc --chunk-size.
+ */
+td::World::World(const std::string& path) {
+    this->path = path;
+    std::unique_ptr<std::istream> index = td::Embedded::open(path);
+    if (!*index)
+        throw std::invalid_argument("Could not load world at path " + path);
+    index->read((char*)&this->header, sizeof(Header));
+    if (!*index || std::memcmp(this->header.magic, "TDWD", 4) != 0 || this->header.header_size != sizeof(Header))
+        throw std::invalid_argument("World at path " + path + " is not a compiled world.");
+    if (this->header.version != VERSION)
+        throw std::invalid_argument("World at path " + path + " has format version " +
+                                    std::to_string(this->header.version) + ", expected " + std::to_string(VERSION) +
+                                    ". Recompile it with tdmapc.");
+    if (this->header.chunk_size <= 0 || this->header.rows < 0 || this->header.cols < 0)
+        throw std::invalid_argument("World at path " + path + " is truncated or corrupt.");
+
+    this->chunk_rows = (this->header.rows + this->header.chunk_size - 1) / this->header.chunk_size;
+    this->chunk_cols = (this->header.cols + this->header.chunk_size - 1) / this->header.chunk_size;
+    this->radius = 1;
+    this->loader = std::thread(&td::World::loaderLoop, this);
+}
+/**
+ * @brief World class destructor. Stops the loader thread and evicts every resident chunk, deleting its entities.
+ */
+td::World::~World() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->queue.clear();
+    }
+    this->wake.notify_all();
+    this->loader.join();
+    for (auto it = this->chunks.begin(); it != this->chunks.end();) {
+        it = this->evict(it);
+    }
+}
+
+/**
+ * @brief Split a level into chunks and write it as a compiled world: a .tdworld index, plus one .tdmap file per
+ * chunk next to it. Edge chunks are smaller when the level size is not a multiple of the chunk size.
+ * Each chunk keeps the level's palette and tile types, and gets the checkpoints and entities that start inside it.
+ * Positions within a chunk, including entity waypoints, are relative to the chunk's top-left tile.
+ * @param level The level template to split, usually from a td::Map that has read in a map txt.
+ * @param chunk_size The width and height of each chunk, in tiles.
+ * @param path The string path of the .tdworld index file to write.
+ */
+void td::World::write(const td::LevelTemplate& level, int chunk_size, const std::string& path) {
+    if (chunk_size <= 0)
+        throw std::invalid_argument("Chunk size must be positive.");
+
+    Header world_header{};
+    std::memcpy(world_header.magic, "TDWD", 4);
+    world_header.version = VERSION;
+    world_header.header_size = sizeof(Header);
+    world_header.rows = level.rows;
+    world_header.cols = level.cols;
+    world_header.chunk_size = chunk_size;
+    world_header.tile_size = level.tile_size;
+    world_header.player_start_row = level.player_start_row;
+    world_header.player_start_col = level.player_start_col;
+
+    std::ofstream index(path, std::ios::binary | std::ios::trunc);
+    if (!index.is_open())
+        throw std::invalid_argument("Could not write world at path " + path);
+    index.write((const char*)&world_header, sizeof(Header));
+    if (!index)
+        throw std::invalid_argument("Could not write world at path " + path);
+    index.close();
+
+    const td::Map::TileIndex* tiles = level.tileData();
+    int chunk_rows = (level.rows + chunk_size - 1) / chunk_size;
+    int chunk_cols = (level.cols + chunk_size - 1) / chunk_size;
+    for (int chunk_row=0; chunk_row<chunk_rows; chunk_row++) {
+        for (int chunk_col=0; chunk_col<chunk_cols; chunk_col++) {
+            int r0 = chunk_row * chunk_size;
+            int c0 = chunk_col * chunk_size;
+            td::LevelTemplate chunk = td::LevelTemplate();
+            chunk.rows = std::min(chunk_size, level.rows - r0);
+            chunk.cols = std::min(chunk_size, level.cols - c0);
+            chunk.palette = level.palette;
+            chunk.tile_types = level.tile_types;
+            std::copy(std::begin(level.type_masks), std::end(level.type_masks), std::begin(chunk.type_masks));
+            chunk.tile_size = level.tile_size;
+            chunk.strings = level.strings;
+            chunk.sprites = level.sprites;
+
+            // Copy the chunk's part of the grid, one row at a time
+            chunk.tiles.reserve((std::size_t)chunk.rows * chunk.cols);
+            for (int r=0; r<chunk.rows; r++) {
+                const td::Map::TileIndex* row = tiles + (std::size_t)(r0 + r) * level.cols + c0;
+                chunk.tiles.insert(chunk.tiles.end(), row, row + chunk.cols);
+            }
+
+            // Move the start tile, checkpoints, and entities that fall inside the chunk into its local coordinates
+            auto inChunk = [&](float row, float col) {
+                return row >= r0 && row < r0 + chunk.rows && col >= c0 && col < c0 + chunk.cols;
+            };
+            if (inChunk((float)level.player_start_row, (float)level.player_start_col)) {
+                chunk.player_start_row = level.player_start_row - r0;
+                chunk.player_start_col = level.player_start_col - c0;
+            }
+            for (const auto& checkpoint : level.checkpoints) {
+                if (inChunk(checkpoint.x, checkpoint.y))
+                    chunk.checkpoints.emplace_back(checkpoint.x - (float)r0, checkpoint.y - (float)c0);
+            }
+            for (td::LevelTemplate::EntityDef entity : level.entities) {
+                if (entity.waypoint_count == 0) continue;
+                const sf::Vector2f& first = level.waypoints[entity.first_waypoint];
+                if (!inChunk(first.x, first.y)) continue;
+                std::uint32_t first_waypoint = (std::uint32_t)chunk.waypoints.size();
+                for (std::uint32_t i=0; i<entity.waypoint_count; i++) {
+                    const sf::Vector2f& waypoint = level.waypoints[entity.first_waypoint + i];
+                    chunk.waypoints.emplace_back(waypoint.x - (float)r0, waypoint.y - (float)c0);
+                }
+                entity.first_waypoint = first_waypoint;
+                chunk.entities.push_back(entity);
+            }
+
+            td::MapFile::write(chunk, td::World::getChunkPath(path, chunk_row, chunk_col));
+        }
+    }
+}
+
+/**
+ * @brief Get the path of a chunk's .tdmap file: the index path without its extension, plus the chunk's position.
+ * For example, chunk (2, 3) of "world.tdworld" is "world.2_3.tdmap".
+ * @param world_path The string path to the world's .tdworld index file.
+ * @param chunk_row The chunk's row, in chunks.
+ * @param chunk_col The chunk's column, in chunks.
+ * @return The string path to the chunk file.
+ */
+std::string td::World::getChunkPath(const std::string& world_path, int chunk_row, int chunk_col) {
+    std::size_t dot = world_path.find_last_of('.');
+    std::size_t slash = world_path.find_last_of("/\\");
+    bool has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    std::string prefix = has_extension ? world_path.substr(0, dot) : world_path;
+    return prefix + "." + std::to_string(chunk_row) + "_" + std::to_string(chunk_col) + ".tdmap";
+}
+
+/**
+ * @brief The loader thread's main loop. Takes chunk requests off the queue, maps their files into memory,
+ * and hands them back to the main thread through the finished list.
+ */
+void td::World::loaderLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->wake.wait(lock, [this] { return this->stopping || !this->queue.empty(); });
+        if (this->stopping) return;
+        int key = this->queue.front();
+        this->queue.pop_front();
+        this->loading = true;
+        lock.unlock();
+
+        LoadedChunk loaded;
+        loaded.key = key;
+        try {
+            loaded.level = td::MapFile::load(td::World::getChunkPath(this->path, key / this->chunk_cols,
+                                                                     key % this->chunk_cols));
+            // Touch every page of the grid so that it is read from disk here rather than on the main thread
+            const td::Map::TileIndex* tiles = loaded.level->tileData();
+            std::size_t count = (std::size_t)loaded.level->rows * loaded.level->cols;
+            volatile td::Map::TileIndex sink = 0;
+            for (std::size_t i=0; i<count; i+=2048) sink = sink ^ tiles[i];
+        } catch (const std::exception& e) {
+            loaded.error = e.what();
+        }
+
+        lock.lock();
+        this->finished.push_back(std::move(loaded));
+        this->loading = false;
+        this->done.notify_all();
+    }
+}
+
+/**
+ * @brief Make every chunk that the loader has finished resident.
+ */
+void td::World::integrateFinished() {
+    std::vector<LoadedChunk> arrived;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        arrived.swap(this->finished);
+    }
+    for (auto& loaded : arrived) {
+        this->makeResident(loaded);
+    }
+}
+
+/**
+ * @brief Turn a loaded chunk into a resident td::Map and create its entities.
+ * Chunks whose request was cancelled while they were loading are dropped.
+ * @param loaded The chunk handed back by the loader thread.
+ */
+void td::World::makeResident(LoadedChunk& loaded) {
+    auto request = this->requested.find(loaded.key);
+    if (request == this->requested.end()) return;
+    float latency = std::chrono::duration<float, std::milli>(Clock::now() - request->second).count();
+    this->requested.erase(request);
+    if (!loaded.error.empty())
+        throw std::invalid_argument(loaded.error);
+
+    // The map becomes the template's only owner, so setting the sprite sheet does not copy it.
+    // Chunks keep the sprites compiled into them unless the world was given a sprite sheet
+    std::unique_ptr<td::Map> map = std::unique_ptr<td::Map>(new td::Map(std::move(loaded.level)));
+    if (!this->sprite_sheet.mapping.empty()) map->setSpriteSheet(this->sprite_sheet);
+    map->spawnEntities();
+    this->chunks[loaded.key] = std::move(map);
+
+    this->stats.chunks_loaded++;
+    this->stats.last_load_ms = latency;
+    this->stats.max_load_ms = std::max(this->stats.max_load_ms, latency);
+    this->total_load_ms += latency;
+    this->stats.average_load_ms = (float)(this->total_load_ms / (double)this->stats.chunks_loaded);
+}
+
+/**
+ * @brief Evict a resident chunk. Its map frees the enemies and items it spawned.
+ * @param it The chunk's position in the resident chunks.
+ * @return The position of the next resident chunk.
+ */
+std::map<int, std::unique_ptr<td::Map>>::iterator td::World::evict(std::map<int, std::unique_ptr<td::Map>>::iterator it) {
+    this->stats.chunks_evicted++;
+    return this->chunks.erase(it);
+}
+
+/**
+ * @brief Move a position's whole chunks out of its offset and into its chunk, so that the offset lies within
+ * [0, chunk size in pixels). Positions returned by the world are already normalized.
+ * @param position A position whose offset may lie outside of its chunk.
+ * @return The same location, normalized.
+ */
+td::World::Position td::World::normalize(td::World::Position position) const {
+    float chunk_pixels = (float)(this->header.chunk_size * this->header.tile_size);
+    int rows = (int)std::floor(position.offset.y / chunk_pixels);
+    int cols = (int)std::floor(position.offset.x / chunk_pixels);
+    position.chunk_row += rows;
+    position.chunk_col += cols;
+    position.offset.y -= (float)rows * chunk_pixels;
+    position.offset.x -= (float)cols * chunk_pixels;
+
+    // Rounding can leave an offset of exactly one chunk, e.g. a tiny negative offset plus a chunk
+    if (position.offset.y >= chunk_pixels) {
+        position.chunk_row++;
+        position.offset.y = 0;
+    }
+    if (position.offset.x >= chunk_pixels) {
+        position.chunk_col++;
+        position.offset.x = 0;
+    }
+    return position;
+}
+
+/**
+ * @brief Convert a pixel position, relative to the floating origin, to a chunk-relative position.
+ * @param point A position in pixels, relative to the origin chunk's top-left corner.
+ * @return The normalized position.
+ */
+td::World::Position td::World::toPosition(const sf::Vector2f& point) const {
+    return this->normalize({this->origin_row, this->origin_col, point});
+}
+
+/**
+ * @brief Convert a chunk-relative position to pixels relative to the floating origin, e.g. to draw at it or to
+ * center a view on it. Only the difference in chunks is turned into pixels, so nearby positions stay precise.
+ * @param position A chunk-relative position.
+ * @return The position in pixels, relative to the origin chunk's top-left corner.
+ */
+sf::Vector2f td::World::toPixels(const td::World::Position& position) const {
+    float chunk_pixels = (float)(this->header.chunk_size * this->header.tile_size);
+    return {(float)(position.chunk_col - this->origin_col) * chunk_pixels + position.offset.x,
+            (float)(position.chunk_row - this->origin_row) * chunk_pixels + position.offset.y};
+}
+
+/**
+ * @brief Get the position of a tile's top-left corner.
+ * @param row The tile's world row.
+ * @param col The tile's world column.
+ * @return The tile's normalized position.
+ */
+td::World::Position td::World::getTilePosition(int row, int col) const {
+    int size = this->header.chunk_size;
+    return {row / size, col / size, sf::Vector2f((float)(col % size * this->header.tile_size),
+                                                 (float)(row % size * this->header.tile_size))};
+}
+
+/**
+ * @brief Move the floating origin to the chunk that holds the camera. Call once per frame before drawing, then
+ * center the view on toPixels(camera). Pixel positions from before the call are relative to the old origin,
+ * so convert anything kept in pixels with toPosition() first.
+ * @param camera The camera's position.
+ */
+void td::World::rebase(const td::World::Position& camera) {
+    td::World::Position normalized = this->normalize(camera);
+    this->setOrigin(normalized.chunk_row, normalized.chunk_col);
+}
+
+/**
+ * @brief Set the floating origin, the chunk whose top-left corner is at pixel (0, 0).
+ * @param chunk_row The origin chunk's row, in chunks.
+ * @param chunk_col The origin chunk's column, in chunks.
+ */
+void td::World::setOrigin(int chunk_row, int chunk_col) {
+    this->origin_row = chunk_row;
+    this->origin_col = chunk_col;
+}
+
+/**
+ * @brief Get the floating origin chunk.
+ * @return The origin chunk's column (x) and row (y).
+ */
+sf::Vector2i td::World::getOrigin() const {
+    return {this->origin_col, this->origin_row};
+}
+
+/**
+ * @brief Update which chunks are resident around a set of focus points, such as the camera center or players.
+ * Chunks that finished loading become resident, chunks within the radius of a focus point that are not resident
+ * are requested from the loader, and resident chunks more than one chunk beyond the radius are evicted.
+ * The extra chunk of slack keeps chunks from being loaded and evicted repeatedly as a focus point moves
+ * back and forth over a chunk border. Call once per frame.
+ * @param focus_points Chunk-relative positions.
+ */
+void td::World::update(const std::vector<td::World::Position>& focus_points) {
+    this->integrateFinished();
+
+    // Find the chunks to load (within the radius) and the chunks to keep (within the radius plus one)
+    std::set<int> wanted;
+    std::set<int> kept;
+    for (const auto& point : focus_points) {
+        td::World::Position focus = this->normalize(point);
+        int focus_row = focus.chunk_row;
+        int focus_col = focus.chunk_col;
+        for (int chunk_row=focus_row-this->radius-1; chunk_row<=focus_row+this->radius+1; chunk_row++) {
+            for (int chunk_col=focus_col-this->radius-1; chunk_col<=focus_col+this->radius+1; chunk_col++) {
+                if (chunk_row < 0 || chunk_col < 0 || chunk_row >= this->chunk_rows || chunk_col >= this->chunk_cols)
+                    continue;
+                int key = chunk_row * this->chunk_cols + chunk_col;
+                kept.insert(key);
+                if (std::abs(chunk_row - focus_row) <= this->radius && std::abs(chunk_col - focus_col) <= this->radius)
+                    wanted.insert(key);
+            }
+        }
+    }
+
+    // Evict chunks that have left the area
+    for (auto it = this->chunks.begin(); it != this->chunks.end();) {
+        if (kept.count(it->first)) ++it;
+        else it = this->evict(it);
+    }
+
+    // Drop queued requests that are no longer needed, and request the chunks that are missing
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (auto it = this->queue.begin(); it != this->queue.end();) {
+            if (kept.count(*it)) {
+                ++it;
+            } else {
+                this->requested.erase(*it);
+                it = this->queue.erase(it);
+            }
+        }
+        for (int key : wanted) {
+            if (this->chunks.count(key) || this->requested.count(key)) continue;
+            this->requested[key] = Clock::now();
+            this->queue.push_back(key);
+        }
+    }
+    this->wake.notify_one();
+}
+
+/**
+ * @brief Update which chunks are resident around a single focus point. See td::World::update.
+ * @param focus_point A chunk-relative position.
+ */
+void td::World::update(const td::World::Position& focus_point) {
+    this->update(std::vector<td::World::Position>{focus_point});
+}
+
+/**
+ * @brief Update which chunks are resident around a set of focus points. See td::World::update.
+ * @param focus_points Positions in pixels, relative to the floating origin.
+ */
+void td::World::update(const std::vector<sf::Vector2f>& focus_points) {
+    std::vector<td::World::Position> positions;
+    positions.reserve(focus_points.size());
+    for (const auto& point : focus_points) positions.push_back(this->toPosition(point));
+    this->update(positions);
+}
+
+/**
+ * @brief Update which chunks are resident around a single focus point. See td::World::update.
+ * @param focus_point A position in pixels, relative to the floating origin.
+ */
+void td::World::update(const sf::Vector2f& focus_point) {
+    this->update(this->toPosition(focus_point));
+}
+
+/**
+ * @brief Block until every requested chunk has loaded, then make them resident.
+ * Useful right after the first update(), so that the first frame has the area around the player.
+ */
+void td::World::finishLoading() {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [this] { return this->queue.empty() && !this->loading; });
+    }
+    this->integrateFinished();
+}
+
+/**
+ * @brief Set how many chunks around each focus point are kept resident.
+ * At most (2 * radius + 3)^2 chunks are resident per focus point.
+ * @param chunks The radius, in chunks. 0 keeps only the chunk under each focus point (plus the slack ring).
+ */
+void td::World::setRadius(int chunks) {
+    if (chunks < 0)
+        throw std::invalid_argument("Streaming radius must not be negative.");
+    this->radius = chunks;
+}
+
+/**
+ * @brief Set the sprite sheet used to draw every chunk, including those already resident.
+ * @param sheet A td::SpriteSheet instance.
+ */
+void td::World::setSpriteSheet(const td::SpriteSheet& sheet) {
+    this->sprite_sheet = sheet;
+    for (auto& chunk : this->chunks) {
+        chunk.second->setSpriteSheet(sheet);
+    }
+}
+
+/**
+ * @brief Draw one layer of every resident chunk, shifting the target's view so that each chunk's local coordinates
+ * land at its place in the world.
+ * @param target An SFML RenderTarget.
+ * @param drawLayer The td::Map draw method to call for each chunk.
+ * @param cull Whether to skip chunks that lie outside the view.
+ */
+void td::World::drawChunks(sf::RenderTarget* target, void (td::Map::*drawLayer)(sf::RenderTarget*), bool cull) {
+    sf::View view = target->getView();
+    sf::FloatRect visible = sf::FloatRect(view.getCenter() - view.getSize() / 2.f, view.getSize());
+    for (auto& chunk : this->chunks) {
+        sf::Vector2f origin = this->getChunkOrigin(chunk.first / this->chunk_cols, chunk.first % this->chunk_cols);
+        sf::Vector2i size = chunk.second->getMapSize();
+        if (cull && !visible.intersects(sf::FloatRect(origin.x, origin.y, (float)size.x, (float)size.y)))
+            continue;
+        sf::View local = view;
+        local.move(-origin);
+        target->setView(local);
+        ((*chunk.second).*drawLayer)(target);
+    }
+    target->setView(view);
+}
+
+/**
+ * @brief Display the resident chunks that are in view.
+ * @param target An SFML RenderTarget on which to draw the world.
+ */
+void td::World::draw(sf::RenderTarget* target) {
+    this->drawChunks(target, &td::Map::draw, true);
+}
+
+/**
+ * @brief Display the enemies of every resident chunk.
+ * @param target An SFML RenderTarget.
+ */
+void td::World::drawEnemies(sf::RenderTarget* target) {
+    this->drawChunks(target, &td::Map::drawEnemies, false);
+}
+
+/**
+ * @brief Display the items of every resident chunk.
+ * @param target An SFML RenderTarget.
+ */
+void td::World::drawItems(sf::RenderTarget* target) {
+    this->drawChunks(target, &td::Map::drawItems, false);
+}
+
+/**
+ * @brief Move the enemies of every resident chunk.
+ * @param elapsed The amount of time that has elapsed since the last frame.
+ */
+void td::World::moveEnemies(float elapsed) {
+    for (auto& chunk : this->chunks) {
+        chunk.second->moveEnemies(elapsed);
+    }
+}
+
+/**
+ * @brief Get the world's streaming statistics: residency counts and chunk load latency.
+ * @return A snapshot of the statistics.
+ */
+td::World::Stats td::World::getStats() const {
+    Stats snapshot = this->stats;
+    snapshot.resident_chunks = this->chunks.size();
+    snapshot.pending_chunks = this->requested.size();
+    snapshot.resident_entities = 0;
+    for (const auto& chunk : this->chunks) {
+        snapshot.resident_entities += chunk.second->getEnemyView().size() + chunk.second->getItemView().size();
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Get the tile size used by the world.
+ * @return Int tile size.
  */
-std::vector<td::Item*>* td::Map::getItems() {
-    return &this->items;
+int td::World::getTileSize() const {
+    return this->header.tile_size;
 }
 
 /**
- * @brief Set the map's sprite sheet, which is used to determine what to draw at each tile.
- * @param sheet The sprite sheet to use.
+ * @brief Get the width and height of each chunk, in tiles.
+ * @return Int chunk size.
  */
-void td::Map::setSpriteSheet(const td::SpriteSheet& sheet) {
-    this->sprite_sheet = sheet;
+int td::World::getChunkSize() const {
+    return this->header.chunk_size;
 }
 
 /**
- * @brief Set the size of the map tiles, in pixels.
- * @param size The desired tile size.
+ * @brief Get world size. In pixels by default.
+ * @param rows_cols Boolean to overwrite the default and instead return the world's number of rows and columns.
+ * @return A Vector2i of the world's size, either in pixels or in rows and columns.
  */
-void td::Map::setTileSize(int size) {
-    if (size < 0 || size > this->max_allowed_tile_size) {
-        throw std::invalid_argument("Invalid tile size.");
-    }
-    this->tile_size = size;
+sf::Vector2i td::World::getMapSize(bool rows_cols) const {
+    if (rows_cols)
+        return {this->header.cols, this->header.rows};
+    else
+        return {this->header.cols * this->header.tile_size, this->header.rows * this->header.tile_size};
 }
 
 /**
- * @brief Set a special tile type, whether by overwriting a default one or creating a new one.
- * @param type Integer tile type, likely specified from an enumeration (the td::Map::TileTypes enum).
- * @param type_ids A vector of chars that correspond to the integer type.
+ * @brief Get the world's player start tile. Its sprite_id and type_id are only filled in while its chunk is resident.
+ * @return The start tile, with its world row and column.
  */
-void td::Map::setTileType(int type, std::vector<char> type_ids) {
-    this->tile_types[type] = std::move(type_ids);
+td::Tile td::World::getPlayerStartTile() const {
+    if (this->isLoaded(this->header.player_start_row, this->header.player_start_col))
+        return this->getTileAt(this->header.player_start_row, this->header.player_start_col);
+    return {'\0', '\0', this->header.player_start_row, this->header.player_start_col};
 }
 
 /**
- * @brief Add an enemy to the map.
- * @param enemy A pointer to the Enemy object to add.
+ * @brief Get the position of a chunk's top-left corner. A chunk's local coordinates are relative to it.
+ * @param chunk_row The chunk's row, in chunks.
+ * @param chunk_col The chunk's column, in chunks.
+ * @return The chunk's origin, in pixels relative to the floating origin.
  */
-void td::Map::addEnemy(td::Enemy* enemy) {
-    this->enemies.emplace_back(enemy);
+sf::Vector2f td::World::getChunkOrigin(int chunk_row, int chunk_col) const {
+    return this->toPixels({chunk_row, chunk_col, sf::Vector2f()});
 }
 
 /**
- * @brief Move all enemies according to their waypoints.
- * @param elapsed The time elapsed between this frame and the last.
+ * @brief Get a resident chunk's map, to query or add to it in the chunk's local coordinates.
+ * @param chunk_row The chunk's row, in chunks.
+ * @param chunk_col The chunk's column, in chunks.
+ * @return The chunk's map, or nullptr if the chunk is not resident.
  */
-void td::Map::moveEnemies(float elapsed) {
-    for (auto enemy : this->enemies) {
-        enemy->move(elapsed);
-    }
+td::Map* td::World::getChunk(int chunk_row, int chunk_col) const {
+    if (chunk_row < 0 || chunk_col < 0 || chunk_row >= this->chunk_rows || chunk_col >= this->chunk_cols)
+        return nullptr;
+    auto it = this->chunks.find(chunk_row * this->chunk_cols + chunk_col);
+    return it == this->chunks.end() ? nullptr : it->second.get();
 }
 
 /**
- * @brief Reset all enemies to their starting locations.
+ * @brief Check whether the chunk holding a tile is resident.
+ * @param row The tile's world row.
+ * @param col The tile's world column.
+ * @return True if the tile can be read.
  */
-void td::Map::resetEnemies() {
-    for (auto enemy : this->enemies) {
-        enemy->reset();
-    }
+bool td::World::isLoaded(int row, int col) const {
+    if (row < 0 || col < 0) return false;
+    return this->getChunk(row / this->header.chunk_size, col / this->header.chunk_size) != nullptr;
 }
 
 /**
- * @brief Add an item to the map.
- * @param item A pointer to the Item object to add.
+ * @brief Retrieve the tile at a given world row and column.
+ * @param row The tile's world row.
+ * @param col The tile's world column.
+ * @return The tile, with its world row and column.
  */
-void td::Map::addItem(td::Item* item) {
-    this->items.emplace_back(item);
+td::Tile td::World::getTileAt(int row, int col) const {
+    if (!this->isLoaded(row, col))
+        throw std::invalid_argument("Tile at row " + std::to_string(row) + ", column " + std::to_string(col) +
+                                    " is not loaded.");
+    int size = this->header.chunk_size;
+    td::Tile tile = this->getChunk(row / size, col / size)->getTileAt(row % size, col % size);
+    return {tile.sprite_id, tile.type_id, row, col};
 }
 
 /**
- * @brief Reset all items to be un-obtained.
+ * @brief Determine whether a bounding box is colliding with any tile of certain types, across chunk borders.
+ * Chunks that are not resident count as colliding, so nothing can move into an area that has not loaded yet.
+ * @param types A bitmask of tile types to check against, built with td::Map::mask.
+ * @param bounds The bounding box to test, in pixels relative to the floating origin.
+ * @return Boolean of whether or not a collision was detected. True = collision, False = no collision.
  */
-void td::Map::resetItems() {
-    for (auto item : this->items) {
-        item->reset();
-    }
+bool td::World::collides(td::Map::TileMask types, const sf::FloatRect& bounds) const {
+    return this->collides(types, this->toPosition({bounds.left, bounds.top}), {bounds.width, bounds.height});
 }
 
 /**
- * @brief Checks if the player is colliding with any tiles of a certain type. Uses td::Map::getCollisions.
- * @param map The map on which to test for collision.
- * @param type_ids The type IDs of tiles to watch out for when checking for player collision.
- * @param rect The player's bounding rectangle.
+ * @brief Determine whether a bounding box is colliding with any tile of certain types, across chunk borders.
+ * The box is tested in the local coordinates of each chunk it overlaps, so the result does not depend on how far
+ * the box is from the world's corner or from the floating origin.
+ * @param types A bitmask of tile types to check against, built with td::Map::mask.
+ * @param position The position of the box's top-left corner.
+ * @param size The box's width and height, in pixels.
  * @return Boolean of whether or not a collision was detected. True = collision, False = no collision.
  */
-bool td::Map::collides(td::Map& map, const std::vector<char>& type_ids, const sf::RectangleShape& rect) {
-    return !td::Map::getCollisions(map, type_ids, rect).empty();
+bool td::World::collides(td::Map::TileMask types, const td::World::Position& position, const sf::Vector2f& size) const {
+    td::World::Position corner = this->normalize(position);
+    float chunk_pixels = (float)(this->header.chunk_size * this->header.tile_size);
+    int last_row = (int)std::floor((corner.offset.y + size.y) / chunk_pixels);
+    int last_col = (int)std::floor((corner.offset.x + size.x) / chunk_pixels);
+    for (int row=0; row<=last_row; row++) {
+        for (int col=0; col<=last_col; col++) {
+            int chunk_row = corner.chunk_row + row;
+            int chunk_col = corner.chunk_col + col;
+            if (chunk_row < 0 || chunk_col < 0 || chunk_row >= this->chunk_rows || chunk_col >= this->chunk_cols)
+                continue;
+            const td::Map* chunk = this->getChunk(chunk_row, chunk_col);
+            if (chunk == nullptr) return true;
+            sf::FloatRect local = sf::FloatRect(corner.offset.x - (float)col * chunk_pixels,
+                                                corner.offset.y - (float)row * chunk_pixels, size.x, size.y);
+            if (chunk->collides(types, local)) return true;
+        }
+    }
+    return false;
 }
 
 /**
- * @brief Get all tiles of certain types that the player is colliding with.
- * Look at all tiles around a given location (x,y) and check if the current location
- * intersects with any surrounding tiles of a specific type.
- * Looks in an n x n tile grid around the location given, where n depends on the size of the player.
- * @param map The map on which to test for collision.
- * @param type_ids The type IDs of tiles to watch out for when checking for player collision.
- * @param rect The player's bounding rectangle.
- * @return A vector of tiles (of the correct type) that were found to be colliding with the player.
- */
-std::vector<td::Tile>
-td::Map::getCollisions(td::Map &map, const std::vector<char> &type_ids, const sf::RectangleShape &rect) {
-    std::vector<td::Tile> tiles = std::vector<td::Tile>();
-    // Get the tile at the location's top-left corner
-    td::Tile current_tile = map.getTile(rect.getPosition().x, rect.getPosition().y);
-    // Setup to look at the tiles around (and at) this current tile, in a 3x3 grid if possible
-    // If the location is at the edge of the map, then reduce the size of the search to avoid Index errors
-    int row = current_tile.row;
-    int col = current_tile.col;
-    int search_size_row = std::ceil(rect.getSize().y / (float)map.getTileSize());
-    int search_size_col = std::ceil(rect.getSize().x / (float)map.getTileSize());
-    int r_start = row-search_size_row; if (r_start < 0) r_start = row;
-    int c_start = col-search_size_col; if (c_start < 0) c_start = col;
-    int r_end = row+search_size_row; if (r_end > map.getMapSize(true).y) r_end = row;
-    int c_end = col+search_size_col; if (c_end > map.getMapSize(true).x) c_end = col;
-
-    // Now iterate over the tiles, checking if the given location's bounding box intersects one of them
-    for (int r=r_start; r<=r_end; r++) {
-        for (int c=c_start; c<=c_end; c++) {
-            td::Tile tile = map.getMap()[r][c];
-            if ((td::Util::find(type_ids, tile.type_id) != -1) &&
-                rect.getGlobalBounds().intersects(tile.getRect(map.getTileSize()).getGlobalBounds())) {
-                tiles.emplace_back(tile);  // Collision!
+ * @brief Move a bounding box by a delta, sliding along any wall in the way, across chunk borders.
+ * Like td::Map::sweep, the box is swept along its whole path, so it can not pass through a wall however far it moves
+ * in one call. The merged wall rectangles of each chunk under the path are gathered into the local frame of the
+ * chunk the box starts in, and chunks that are not resident count as solid, so nothing can move into an area that
+ * has not loaded yet. All of the arithmetic is done on chunk-local offsets, which keeps sub-pixel movement exact
+ * anywhere in the world.
+ * @param position The position of the box's top-left corner.
+ * @param size The box's width and height, in pixels.
+ * @param delta How far to move, in pixels.
+ * @param walls A bitmask of tile types that block movement, built with td::Map::mask.
+ * @return The box's new, normalized position.
+ */
+td::World::Position td::World::move(const td::World::Position& position, const sf::Vector2f& size,
+                                    const sf::Vector2f& delta, td::Map::TileMask walls) const {
+    td::World::Position current = this->normalize(position);
+    if (delta.x == 0 && delta.y == 0) return current;
+
+    // The whole path, in the local frame of the start chunk
+    float chunk_pixels = (float)(this->header.chunk_size * this->header.tile_size);
+    sf::FloatRect bounds(current.offset.x, current.offset.y, size.x, size.y);
+    td::AABB path(std::min(bounds.left, bounds.left + delta.x), std::min(bounds.top, bounds.top + delta.y),
+                  std::max(bounds.left, bounds.left + delta.x) + size.x,
+                  std::max(bounds.top, bounds.top + delta.y) + size.y);
+
+    // Gather the walls of every chunk under the path
+    this->sweep_candidates.clear();
+    int first_row = (int)std::floor(path.top / chunk_pixels);
+    int first_col = (int)std::floor(path.left / chunk_pixels);
+    int last_row = (int)std::floor(path.bottom / chunk_pixels);
+    int last_col = (int)std::floor(path.right / chunk_pixels);
+    for (int row=first_row; row<=last_row; row++) {
+        for (int col=first_col; col<=last_col; col++) {
+            int chunk_row = current.chunk_row + row;
+            int chunk_col = current.chunk_col + col;
+            if (chunk_row < 0 || chunk_col < 0 || chunk_row >= this->chunk_rows || chunk_col >= this->chunk_cols)
+                continue;
+            sf::Vector2f chunk_offset((float)col * chunk_pixels, (float)row * chunk_pixels);
+            const td::Map* chunk = this->getChunk(chunk_row, chunk_col);
+            if (chunk == nullptr) {
+                // A box that is already partly in an area that has not loaded waits for it
+                sf::FloatRect unloaded(chunk_offset, sf::Vector2f(chunk_pixels, chunk_pixels));
+                if (td::AABB(bounds).intersects(unloaded)) return current;
+                this->sweep_candidates.push_back(unloaded);
+                continue;
             }
+            chunk->getMergedRects(walls, path.moved(td::Vec2(-chunk_offset.x, -chunk_offset.y)),
+                                  this->sweep_candidates, chunk_offset);
         }
     }
-    return tiles;
+
+    current.offset = td::Map::sweep(this->sweep_candidates, bounds, delta);
+    return this->normalize(current);
 }
 //------------------------------------------------------------------------------------------------------------------
 
@@ -1007,23 +5066,34 @@ td::RenderObject::RenderObject() {
     this->texture = nullptr;
     this->CPTexture = nullptr;
 
+    // Map
+    this->map = nullptr;
+
     // Render
     this->drawable = td::Shapes::rect(this->x, this->y,this->width, this->height);
     this->CPdrawable = td::Shapes::rect(this->x, this->y,this->width, this->height);
 }
 /**
- * @brief RenderObject class destructor.
+ * @brief RenderObject class destructor. A texture loaded by td::RenderObject::setTexture is freed along with the last
+ * copy of the object that uses it.
  */
-td::RenderObject::~RenderObject() {
-    delete this->texture;
-}
+td::RenderObject::~RenderObject() = default;
 
 /**
- * @brief Set the map that the player will roam around.
+ * @brief Set the map that the object is placed on. The object refers to the map rather than copying it,
+ * so the map must outlive the object's use of it.
  * @param m A Map instance.
  */
 void td::RenderObject::setMap(td::Map &m) {
-    this->map = m;
+    this->map = &m;
+}
+
+/**
+ * @brief Get the map that the object is placed on.
+ * @return A pointer to the map, or nullptr if the object has not been placed on one.
+ */
+const td::Map* td::RenderObject::getMap() const {
+    return this->map;
 }
 
 /**
@@ -1055,8 +5125,8 @@ void td::RenderObject::setStartPosition(float start_x, float start_y) {
  * @param col Starting column.
  */
 void td::RenderObject::setStartTile(int row, int col) {
-    this->x = (float)(col * this->map.getTileSize()) + ((float)(this->map.getTileSize()-this->width)/2);
-    this->y = (float)(row * this->map.getTileSize()) + ((float)(this->map.getTileSize()-this->height)/2);
+    this->x = (float)(col * this->map->getTileSize()) + ((float)(this->map->getTileSize()-this->width)/2);
+    this->y = (float)(row * this->map->getTileSize()) + ((float)(this->map->getTileSize()-this->height)/2);
 }
 
 /**
@@ -1076,8 +5146,8 @@ void td::RenderObject::draw(sf::RenderTarget* target) {
  * @param cp_y Checkpoint y position.
  */
 void td::RenderObject::drawCP(sf::RenderTarget* target, int cp_x, int cp_y) {
-    this->CPdrawable.setPosition(sf::Vector2f((float)cp_x * (float)this->map.getTileSize(), (float)cp_y * (float)this->map.getTileSize()));
-    this->CPdrawable.setSize(sf::Vector2f(this->map.getTileSize(), this->map.getTileSize()));
+    this->CPdrawable.setPosition(sf::Vector2f((float)cp_x * (float)this->map->getTileSize(), (float)cp_y * (float)this->map->getTileSize()));
+    this->CPdrawable.setSize(sf::Vector2f(this->map->getTileSize(), this->map->getTileSize()));
     target->draw(this->CPdrawable);
 }
 
@@ -1090,10 +5160,10 @@ void td::RenderObject::drawCP(sf::RenderTarget* target, int cp_x, int cp_y) {
  */
 void td::RenderObject::drawFileImage(sf::RenderTarget* target, int img_x, int img_y, const std::string& file) {
     sf::RectangleShape fileImage;
-    fileImage.setSize(sf::Vector2f(this->map.getTileSize(), this->map.getTileSize()));
-    fileImage.setPosition(sf::Vector2f(img_y * this->map.getTileSize(), img_x * this->map.getTileSize()));
+    fileImage.setSize(sf::Vector2f(this->map->getTileSize(), this->map->getTileSize()));
+    fileImage.setPosition(sf::Vector2f(img_y * this->map->getTileSize(), img_x * this->map->getTileSize()));
     auto* image = new sf::Texture();
-    if (!image->loadFromFile(file)) {
+    if (!td::Embedded::loadTexture(*image, file)) {
         throw std::invalid_argument("Could not load texture at path " + file);
     }
     fileImage.setTexture(image);
@@ -1111,25 +5181,36 @@ void td::RenderObject::setColor(sf::Color c) {
 
 /**
  * @brief Set the objects's texture. Will take precedence over any object color specified previously.
+ * Also gives the object a collision mask built from the texture (see td::RenderObject::setCollisionMask).
  * @param file The string path to a texture file.
  */
 void td::RenderObject::setTexture(const std::string& file) {
-    auto* player_texture = new sf::Texture();
-    if (!player_texture->loadFromFile(file)) {
+    std::shared_ptr<sf::Texture> player_texture = std::make_shared<sf::Texture>();
+    if (!td::Embedded::loadTexture(*player_texture, file)) {
         throw std::invalid_argument("Could not load texture at path " + file);
     }
     this->texture = player_texture;
-    this->drawable.setTexture(player_texture);
+    this->drawable.setTexture(player_texture.get());
+    this->setCollisionMask(file);
 }
 
 
+/**
+ * @brief Set the object's texture to one that is shared with other objects, such as a texture cached by td::World.
+ * The object does not take ownership; the texture must outlive the object's use of it.
+ * @param shared_texture The texture to draw the object with.
+ */
+void td::RenderObject::setTexture(const sf::Texture& shared_texture) {
+    this->drawable.setTexture(&shared_texture);
+}
+
 /**
  * @brief Set the checkpoints texture. Will take precedence over any object color specified previously.
  * @param file The string path to a texture file.
  */
 void td::RenderObject::setCPTexture(const std::string& file) {
     auto* CP_texture = new sf::Texture();
-    if (!CP_texture->loadFromFile(file)) {
+    if (!td::Embedded::loadTexture(*CP_texture, file)) {
         throw std::invalid_argument("Could not load texture at path " + file);
     }
     this->CPTexture = CP_texture;
@@ -1144,6 +5225,14 @@ td::Util::size td::RenderObject::getSize() const {
     return {this->width, this->height};
 }
 
+/**
+ * @brief Get the object's bounding box, for collision tests.
+ * @return The box from the object's position to its far corner.
+ */
+td::AABB td::RenderObject::getBounds() const {
+    return {this->x, this->y, this->x + (float)this->width, this->y + (float)this->height};
+}
+
 /**
  * @brief Set the object's width and height.
  * @param w The object's desired width.
@@ -1156,11 +5245,58 @@ void td::RenderObject::setSize(int w, int h, bool center_in_tile) {
     this->width = w;
     this->height = h;
     if (center_in_tile) {
-        td::Tile tile = this->map.getTile(this->x, this->y);
-        sf::Vector2i pos = tile.getPosition(this->map.getTileSize());
-        this->x = pos.x + ((float)(this->map.getTileSize()-this->width)/2);
-        this->y = pos.y + ((float)(this->map.getTileSize()-this->height)/2);
+        td::Tile tile = this->map->getTile(this->x, this->y);
+        sf::Vector2i pos = tile.getPosition(this->map->getTileSize());
+        this->x = pos.x + ((float)(this->map->getTileSize()-this->width)/2);
+        this->y = pos.y + ((float)(this->map->getTileSize()-this->height)/2);
     }
+    if (!this->mask_file.empty()) this->setCollisionMask(this->mask_file);
+}
+
+/**
+ * @brief Give the object a collision mask built from the alpha of a texture, scaled to the object's size.
+ * The mask is rebuilt whenever the object is resized, and is shared with other objects of the same texture and size.
+ * @param file The string path to a texture file.
+ */
+void td::RenderObject::setCollisionMask(const std::string& file) {
+    this->collision_mask = td::CollisionMask::load(file, this->width, this->height);
+    this->mask_file = file;
+}
+
+/**
+ * @brief Give the object a collision mask that is already built. The mask is kept as it is if the object is resized.
+ * @param mask The mask, or nullptr to test the object by its bounding box.
+ */
+void td::RenderObject::setCollisionMask(std::shared_ptr<const td::CollisionMask> mask) {
+    this->collision_mask = std::move(mask);
+    this->mask_file.clear();
+}
+
+/**
+ * @brief Get the object's collision mask.
+ * @return A pointer to the mask, or nullptr if the object has none.
+ */
+const td::CollisionMask* td::RenderObject::getCollisionMask() const {
+    return this->collision_mask.get();
+}
+
+/**
+ * @brief Check if the solid pixels of two objects overlap.
+ * The bounding boxes are tested first. Then the collision masks are tested against each other, at the objects'
+ * positions rounded to whole pixels. An object without a mask is solid throughout its bounding box.
+ * @param other The other object.
+ * @return Boolean. True = the objects touch, False = they do not.
+ */
+bool td::RenderObject::touchesPixels(const td::RenderObject& other) const {
+    if (!this->getBounds().intersects(other.getBounds())) return false;
+    const td::CollisionMask* mask = this->collision_mask.get();
+    const td::CollisionMask* other_mask = other.collision_mask.get();
+    int dx = (int)std::lround(other.x - this->x);
+    int dy = (int)std::lround(other.y - this->y);
+    if (mask && other_mask) return mask->overlaps(*other_mask, dx, dy);
+    if (mask) return mask->overlaps(dx, dy, dx + other.width, dy + other.height);
+    if (other_mask) return other_mask->overlaps(-dx, -dy, this->width - dx, this->height - dy);
+    return true;
 }
 //------------------------------------------------------------------------------------------------------------------
 
@@ -1193,7 +5329,10 @@ td::Player::Player() {
     this->max_health = 100;
     this->health = this->max_health;
     this->inventory = std::vector<td::Item*>();
-    this->checkpoint = td::Tile('0', this->map.getTileType(td::Map::TileTypes::CHECKPOINT).front(), 0, 0);
+    this->checkpoint = td::Tile('0', 'c', 0, 0);
+
+    // Streamed world
+    this->world = nullptr;
 }
 /**
  * @brief Player class destructor.
@@ -1206,52 +5345,68 @@ td::Player::~Player() = default;
  * @param m A td::Map instance.
  */
 void td::Player::setMap(td::Map &m) {
-    this->map = m;
+    this->map = &m;
     this->checkpoint = m.getPlayerStartTile();
     this->spawn();
 }
 
+/**
+ * @brief Place the player in a streamed world. From then on the player's position is kept as a chunk-relative
+ * td::World::Position, and move() collides with the world's chunks instead of the map. The player's pixel position
+ * (used for drawing and by getPosition()) follows the world's floating origin.
+ * @param w A td::World instance.
+ * @param position The position of the player's top-left corner.
+ */
+void td::Player::setWorld(td::World& w, const td::World::Position& position) {
+    this->world = &w;
+    this->world_position = w.normalize(position);
+    sf::Vector2f pixels = w.toPixels(this->world_position);
+    this->x = pixels.x;
+    this->y = pixels.y;
+}
+
+/**
+ * @brief Get the player's position in the streamed world set with setWorld().
+ * @return The position of the player's top-left corner.
+ */
+const td::World::Position& td::Player::getWorldPosition() const {
+    return this->world_position;
+}
+
 /**
  * @brief Listen for player movement. Upon correct key presses, update the player's position.
  * @param elapsed The time delta from the last frame to this one.
  * Ensures consistent movement speeds across all fps values.
  */
 void td::Player::move(float elapsed) {
-    float new_x = this->x;
-    float new_y = this->y;
+    this->move_start = sf::Vector2f(this->x, this->y);
     float move_amount = this->speed * elapsed;
-
-    // Handle keyboard inputs:
-    // Each handler section optimistically sets the new coordinate position.
-    // If that position turns out to intersect with a wall, then instead move the remaining distance.
-    // This has the effect of clamping the position to align with the tile size.
-    if (sf::Keyboard::isKeyPressed(this->up_key)) {     // UP
-        new_y = this->y - move_amount;
-        sf::RectangleShape rect = td::Shapes::rect(new_x, new_y, this->width, this->height);
-        if (td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::WALL), rect))
-            new_y = std::floor(this->y) - (float)((int)this->y % this->map.getTileSize());
-    }
-    if (sf::Keyboard::isKeyPressed(this->down_key)) {   // DOWN
-        new_y = this->y + move_amount;
-        sf::RectangleShape rect = td::Shapes::rect(new_x, new_y, this->width, this->height);
-        if (td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::WALL), rect))
-            new_y = std::floor(this->y) + ((float)((int)(this->map.getTileSize() - ((int)(this->y + (float)this->height) % this->map.getTileSize())) % this->map.getTileSize()));
-    }
-    if (sf::Keyboard::isKeyPressed(this->left_key)) {   // LEFT
-        new_x = this->x - move_amount;
-        sf::RectangleShape rect = td::Shapes::rect(new_x, new_y, this->width, this->height);
-        if (td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::WALL), rect))
-            new_x = std::floor(this->x) - (float)((int)this->x % this->map.getTileSize());
-    }
-    if (sf::Keyboard::isKeyPressed(this->right_key)) {  // RIGHT
-        new_x = this->x + move_amount;
-        sf::RectangleShape rect = td::Shapes::rect(new_x, new_y, this->width, this->height);
-        if (td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::WALL), rect))
-            new_x = std::floor(this->x) + ((float)((int)(this->map.getTileSize() - ((int)(this->x + (float)this->width) % this->map.getTileSize())) % this->map.getTileSize()));
+    td::Map::TileMask walls = td::Map::mask(td::Map::TileTypes::WALL);
+
+    // Handle keyboard inputs. Opposite keys cancel out
+    sf::Vector2f delta;
+    if (sf::Keyboard::isKeyPressed(this->up_key)) delta.y -= move_amount;     // UP
+    if (sf::Keyboard::isKeyPressed(this->down_key)) delta.y += move_amount;   // DOWN
+    if (sf::Keyboard::isKeyPressed(this->left_key)) delta.x -= move_amount;   // LEFT
+    if (sf::Keyboard::isKeyPressed(this->right_key)) delta.x += move_amount;  // RIGHT
+
+    // In a streamed world, sweep in chunk-local space across the resident chunks
+    if (this->world != nullptr) {
+        this->world_position = this->world->move(this->world_position,
+                                                 sf::Vector2f((float)this->width, (float)this->height), delta, walls);
+        sf::Vector2f pixels = this->world->toPixels(this->world_position);
+        this->x = pixels.x;
+        this->y = pixels.y;
+        this->move_end = pixels;
+        return;
     }
 
-    this->x = new_x;
-    this->y = new_y;
+    // Sweep the player's bounding box along the motion, stopping flush against walls and sliding along them
+    sf::FloatRect rect(this->x, this->y, (float)this->width, (float)this->height);
+    sf::Vector2f position = this->map->sweep(walls, rect, delta);
+    this->x = position.x;
+    this->y = position.y;
+    this->move_end = position;
 }
 
 /**
@@ -1274,7 +5429,28 @@ void td::Player::setMovementKeys(sf::Keyboard::Key up, sf::Keyboard::Key left, s
  * @param move_speed Float speed.
  */
 void td::Player::setMoveSpeed(float move_speed) {
-    this->speed = move_speed * ((float)this->map.getTileSize()/8);
+    int tile_size = this->world != nullptr ? this->world->getTileSize() : this->map->getTileSize();
+    this->speed = move_speed * ((float)tile_size/8);
+}
+
+/**
+ * @brief Get how far the player moved in the last call to move, for continuous collision tests.
+ * If the player has been placed somewhere else since, such as by a respawn, it counts as not having moved.
+ * @return The change in position, in pixels.
+ */
+sf::Vector2f td::Player::getLastMove() const {
+    if (this->x != this->move_end.x || this->y != this->move_end.y) return {0, 0};
+    return this->move_end - this->move_start;
+}
+
+/**
+ * @brief Get the box the player's bounds swept over in the last call to move.
+ * @return The bounds at the start and the end of the move, and everything between.
+ */
+sf::FloatRect td::Player::getSweptBounds() const {
+    sf::Vector2f last_move = this->getLastMove();
+    return {std::min(this->x, this->x - last_move.x), std::min(this->y, this->y - last_move.y),
+            (float)this->width + std::abs(last_move.x), (float)this->height + std::abs(last_move.y)};
 }
 
 /**
@@ -1283,10 +5459,10 @@ void td::Player::setMoveSpeed(float move_speed) {
  */
 void td::Player::spawn() {
     this->health = this->max_health;
-    td::Tile tile = this->map.getPlayerStartTile();
-    sf::Vector2i pos = tile.getPosition(this->map.getTileSize());
-    this->x = pos.x + ((float)(this->map.getTileSize()-this->width)/2);
-    this->y = pos.y + ((float)(this->map.getTileSize()-this->height)/2);
+    td::Tile tile = this->map->getPlayerStartTile();
+    sf::Vector2i pos = tile.getPosition(this->map->getTileSize());
+    this->x = pos.x + ((float)(this->map->getTileSize()-this->width)/2);
+    this->y = pos.y + ((float)(this->map->getTileSize()-this->height)/2);
 }
 
 /**
@@ -1295,9 +5471,23 @@ void td::Player::spawn() {
  */
 void td::Player::respawn() {
     this->health = this->max_health;
-    sf::Vector2i pos = this->checkpoint.getPosition(this->map.getTileSize());
-    this->x = pos.x + ((float)(this->map.getTileSize()-this->width)/2);
-    this->y = pos.y + ((float)(this->map.getTileSize()-this->height)/2);
+    sf::Vector2i pos = this->checkpoint.getPosition(this->map->getTileSize());
+    this->x = pos.x + ((float)(this->map->getTileSize()-this->width)/2);
+    this->y = pos.y + ((float)(this->map->getTileSize()-this->height)/2);
+}
+
+/**
+ * @brief Display the player. In a streamed world, the pixel position is refreshed first, since the world's
+ * floating origin may have moved since the player last moved.
+ * @param target An SFML RenderTarget on which to draw the player.
+ */
+void td::Player::draw(sf::RenderTarget* target) {
+    if (this->world != nullptr) {
+        sf::Vector2f pixels = this->world->toPixels(this->world_position);
+        this->x = pixels.x;
+        this->y = pixels.y;
+    }
+    td::RenderObject::draw(target);
 }
 
 /**
@@ -1305,8 +5495,7 @@ void td::Player::respawn() {
  * @return Boolean. True = player is currently on a checkpoint tile, False = player is not on a checkpoint tile.
  */
 bool td::Player::onCheckpoint() {
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    return td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::CHECKPOINT), p_rect);
+    return this->map->collides(td::Map::mask(td::Map::TileTypes::CHECKPOINT), this->getBounds());
 }
 
 /**
@@ -1317,16 +5506,25 @@ bool td::Player::onCheckpoint() {
  * It thus supports both formal checkpoints and informal save points.
  */
 void td::Player::setCheckpoint() {
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    std::vector<td::Tile> checkpoints = td::Map::getCollisions(this->map, this->map.getTileType(td::Map::TileTypes::CHECKPOINT), p_rect);
-    if (!checkpoints.empty()) {
-        this->checkpoint = checkpoints.back();
-    }
-    else {
-        this->checkpoint = this->map.getTile(this->x, this->y);
+    bool found = false;
+    this->map->forEachCollision(td::Map::mask(td::Map::TileTypes::CHECKPOINT), this->getBounds(),
+                                [&](const td::Tile& tile) {
+        this->checkpoint = tile;
+        found = true;
+    });
+    if (!found) {
+        this->checkpoint = this->map->getTile(this->x, this->y);
     }
 }
 
+/**
+ * @brief Set the player's checkpoint to a given tile, such as a checkpoint tile reported by a td::ContactManifold.
+ * @param tile The tile to respawn at.
+ */
+void td::Player::setCheckpoint(const td::Tile& tile) {
+    this->checkpoint = tile;
+}
+
 
 /**
  * @brief Returns the current checkpoint tile.
@@ -1340,12 +5538,11 @@ td::Tile td::Player::getCheckpoint() {
  * @return Boolean. True = player is currently on an end tile, False = player is not on an end tile.
  */
 bool td::Player::onEnd() {
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    return td::Map::collides(this->map, this->map.getTileType(td::Map::TileTypes::END), p_rect);
+    return this->map->collides(td::Map::mask(td::Map::TileTypes::END), this->getBounds());
 }
 
 /**
- * @brief Check if the player is currently colliding with an enemy. Uses td::Player::getTouchingEnemies.
+ * @brief Check if the player is currently colliding with an enemy. Uses the map's spatial grid of enemies.
  * @return Boolean. True = player is currently colliding with an enemy, False = player is not touching an enemy.
  */
 bool td::Player::isTouchingEnemy() {
@@ -1354,20 +5551,14 @@ bool td::Player::isTouchingEnemy() {
 
 /**
  * @brief Get the enemies that the player is touching.
- * Iterates over each enemy and checks if its bounding box is overlapping that of the player.
+ * Checks the enemies near the player, found through the map's spatial grid, for a bounding box overlapping that
+ * of the player.
  * @return A vector of pointers to all enemies the player is currently colliding with.
  */
 std::vector<td::Enemy*> td::Player::getTouchingEnemies() {
     std::vector<td::Enemy*> touching_enemies = std::vector<td::Enemy*>();
 
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    for (auto enemy : *this->map.getEnemies()) {
-        sf::RectangleShape enemy_rect = td::Shapes::rect(
-                enemy->getPosition().x, enemy->getPosition().y, enemy->getSize().width, enemy->getSize().height);
-        if (p_rect.getGlobalBounds().intersects(enemy_rect.getGlobalBounds())) {
-            touching_enemies.emplace_back(enemy);
-        }
-    }
+    this->map->findEnemiesTouching(this->getBounds(), false, touching_enemies);
     return touching_enemies;
 }
 
@@ -1381,53 +5572,128 @@ bool td::Player::isTouchingCircleEnemy() {
 
 /**
  * @brief Additional implementation of td::Player::getTouchingEnemies(), just now with circles.
- * Treats each enemy as a circle object instead of a rectangle.
+ * Treats each enemy as a circle object instead of a rectangle. The radius is half the enemy's width, centered in
+ * the enemy, which gives some grace at the corners.
  * This is especially useful when the texture on an enemy makes it look circular.
  * @return A vector of pointers to all enemies the player is currently colliding with.
  */
 std::vector<td::Enemy*> td::Player::getTouchingCircleEnemies() {
     std::vector<td::Enemy*> touching_enemies = std::vector<td::Enemy*>();
 
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    for (auto enemy : *this->map.getEnemies()) {
-        // Create a temporary circle object for the enemy. The radius is manipulated to give some grace.
-        sf::CircleShape enemy_circ = td::Shapes::circ(
-                enemy->getPosition().x + (float)(enemy->getSize().width)/2,
-                enemy->getPosition().y + (float)(enemy->getSize().height)/2,
-                (float)enemy->getSize().width/2);
-        if (td::Util::intersects(enemy_circ, p_rect)) {
-            touching_enemies.emplace_back(enemy);
-        }
-    }
+    this->map->findEnemiesTouching(this->getBounds(), true, touching_enemies);
+    return touching_enemies;
+}
+
+/**
+ * @brief Find when an enemy, treated as a circle like in td::Player::getTouchingCircleEnemies, first touched a
+ * player's bounding box over their last moves. Both are taken to move in a straight line from where they started
+ * to where they are now.
+ * @param enemy The enemy.
+ * @param p_start The player's bounding box before its last move.
+ * @param p_move How far the player moved.
+ * @return The fraction of the move, from 0 to 1, at which they first touched, or -1 if they did not.
+ */
+static float circleContactTime(const td::Enemy* enemy, const td::AABB& p_start, const sf::Vector2f& p_move) {
+    sf::Vector2f e_move = enemy->getLastMove();
+    sf::Vector2f center = enemy->getPosition() - e_move + sf::Vector2f((float)enemy->getSize().width/2,
+                                                                       (float)enemy->getSize().height/2);
+    return td::Util::contactTime(td::Circle(center, (float)enemy->getSize().width/2), e_move - p_move, p_start);
+}
+
+/**
+ * @brief Continuous version of td::Player::isTouchingCircleEnemy(). Instead of only testing where the player and
+ * the enemies are now, sweeps both along their last moves, so that a fast enemy can not pass through the player
+ * between frames. Call it after both the player and the enemies have moved.
+ * @return The fraction of the last move, from 0 to 1, at which the player first touched an enemy, or -1 if the
+ * player did not touch any enemy.
+ */
+float td::Player::getCircleEnemyContactTime() {
+    sf::Vector2f p_move = this->getLastMove();
+    td::AABB p_start = td::AABB::fromSize({this->x - p_move.x, this->y - p_move.y},
+                                          {(float)this->width, (float)this->height});
+    float earliest = -1;
+    this->map->forEachEnemyNear(this->getSweptBounds(), [&](const td::Enemy* enemy) {
+        float time = circleContactTime(enemy, p_start, p_move);
+        if (time >= 0 && (earliest < 0 || time < earliest)) earliest = time;
+    });
+    return earliest;
+}
+
+/**
+ * @brief Continuous version of td::Player::getTouchingCircleEnemies(). See td::Player::getCircleEnemyContactTime.
+ * @return A vector of pointers to all enemies the player touched during the last move, in the order they were
+ * first touched.
+ */
+std::vector<td::Enemy*> td::Player::getSweptCircleEnemies() {
+    std::vector<std::pair<float, td::Enemy*>> contacts;
+    sf::Vector2f p_move = this->getLastMove();
+    td::AABB p_start = td::AABB::fromSize({this->x - p_move.x, this->y - p_move.y},
+                                          {(float)this->width, (float)this->height});
+    this->map->forEachEnemyNear(this->getSweptBounds(), [&](td::Enemy* enemy) {
+        float time = circleContactTime(enemy, p_start, p_move);
+        if (time >= 0) contacts.emplace_back(time, enemy);
+    });
+    std::stable_sort(contacts.begin(), contacts.end(),
+                     [](const std::pair<float, td::Enemy*>& a, const std::pair<float, td::Enemy*>& b) {
+                         return a.first < b.first;
+                     });
+
+    std::vector<td::Enemy*> touching_enemies = std::vector<td::Enemy*>();
+    for (const auto& contact : contacts) touching_enemies.emplace_back(contact.second);
+    return touching_enemies;
+}
+
+/**
+ * @brief Additional implementation of td::Player::isTouchingEnemy(), just now with collision masks.
+ * @return Boolean. True = player is currently colliding with an enemy, False = player is not touching an enemy.
+ */
+bool td::Player::isTouchingPixelEnemy() {
+    return !this->getTouchingPixelEnemies().empty();
+}
+
+/**
+ * @brief Additional implementation of td::Player::getTouchingEnemies(), just now with collision masks.
+ * The enemies whose bounding boxes touch the player's, found through the map's spatial grid, are then tested pixel by
+ * pixel (see td::RenderObject::touchesPixels), so that only the visible parts of the textures count.
+ * @return A vector of pointers to all enemies the player is currently colliding with.
+ */
+std::vector<td::Enemy*> td::Player::getTouchingPixelEnemies() {
+    std::vector<td::Enemy*> touching_enemies = std::vector<td::Enemy*>();
+
+    this->map->findEnemiesTouching(this->getBounds(), false, touching_enemies);
+    touching_enemies.erase(std::remove_if(touching_enemies.begin(), touching_enemies.end(), [this](td::Enemy* enemy) {
+        return !this->touchesPixels(*enemy);
+    }), touching_enemies.end());
     return touching_enemies;
 }
 
 /**
- * @brief Check if the player is currently colliding with any un-obtained items. Uses td::Player::getTouchingItems.
+ * @brief Check if the player is currently colliding with any un-obtained items. Uses the map's spatial grid of items.
  * @return Boolean. True = player is currently colliding with an un-obtained object, False = player is not.
  */
 bool td::Player::isTouchingItem() {
-    return !this->getTouchingItems().empty();
+    td::AABB p_box = this->getBounds();
+    bool touching = false;
+    this->map->forEachItemNear(p_box.toRect(), [&](const td::Item* item) {
+        touching = touching || (!item->isObtained() && p_box.intersects(item->getBounds()));
+    });
+    return touching;
 }
 
 /**
  * @brief Get the items that the player is touching.
- * Iterates over each item and checks if the item's bounds overlap with that of the player.
+ * Checks the items near the player, found through the map's spatial grid, for bounds overlapping those of the player.
  * @return A vector of pointers to all items the player is currently colliding with.
  */
 std::vector<td::Item*> td::Player::getTouchingItems() {
     std::vector<td::Item*> touching_items = std::vector<td::Item*>();
 
-    sf::RectangleShape p_rect = td::Shapes::rect(this->x, this->y, this->width, this->height);
-    for (auto& item : *this->map.getItems()) {
-        if (!item->isObtained()) {
-            sf::RectangleShape item_rect = td::Shapes::rect(
-                    item->getPosition().x, item->getPosition().y, item->getSize().width, item->getSize().height);
-            if (p_rect.getGlobalBounds().intersects(item_rect.getGlobalBounds())) {
-                touching_items.emplace_back(item);
-            }
+    td::AABB p_box = this->getBounds();
+    this->map->forEachItemNear(p_box.toRect(), [&](td::Item* item) {
+        if (!item->isObtained() && p_box.intersects(item->getBounds())) {
+            touching_items.emplace_back(item);
         }
-    }
+    });
     return touching_items;
 }
 
@@ -1442,9 +5708,9 @@ void td::Player::obtainItem(td::Item* item) {
 
 /**
  * @brief Get the player's obtained items.
- * @return A vector of pointers to all items the player has obtained.
+ * @return A reference to the vector of pointers to all items the player has obtained.
  */
-std::vector<td::Item*> td::Player::getInventory() {
+const std::vector<td::Item*>& td::Player::getInventory() const {
     return this->inventory;
 }
 
@@ -1546,7 +5812,7 @@ td::Enemy::Enemy() {
  * @param harm The amount of harm the enemy deals when colliding with a Player instance. Default value: 1.
  */
 td::Enemy::Enemy(const td::Map& map, int width, int height, sf::Color color, int harm) {
-    this->map = map;
+    this->map = &map;
     this->width = width;
     this->height = height;
     this->color = color;
@@ -1582,7 +5848,7 @@ void td::Enemy::reset() {
  * @param m The td::Map instance that the enemy will move on and interact with.
  */
 void td::Enemy::setMap(td::Map& m) {
-    this->map = m;
+    this->map = &m;
 }
 
 /**
@@ -1614,10 +5880,10 @@ void td::Enemy::setWaypoints(const std::vector<sf::Vector2f>& enemy_waypoints, b
     if (tiles) {
         for (auto& waypoint : position_waypoints) {
             // Rows stored in x, columns stored in y. Switch them and multiply by tile_size
-            float translated_col = waypoint.y * (float)this->map.getTileSize()
-                    + ((float)(this->map.getTileSize()-this->width)/2);
-            float translated_row = waypoint.x * (float)this->map.getTileSize()
-                    + ((float)(this->map.getTileSize()-this->height)/2);
+            float translated_col = waypoint.y * (float)this->map->getTileSize()
+                    + ((float)(this->map->getTileSize()-this->width)/2);
+            float translated_row = waypoint.x * (float)this->map->getTileSize()
+                    + ((float)(this->map->getTileSize()-this->height)/2);
             waypoint.x = translated_col;
             waypoint.y = translated_row;
         }
@@ -1659,8 +5925,8 @@ void td::Enemy::setStartPosition(float start_x, float start_y) {
 void td::Enemy::setStartTile(int row, int col) {
     if (!this->waypoints.empty()) {
         this->waypoints[0] = {
-                (float)(col * this->map.getTileSize()) + ((float)(this->map.getTileSize()-this->width)/2),
-                (float)(row * this->map.getTileSize()) + ((float)(this->map.getTileSize()-this->height)/2)
+                (float)(col * this->map->getTileSize()) + ((float)(this->map->getTileSize()-this->width)/2),
+                (float)(row * this->map->getTileSize()) + ((float)(this->map->getTileSize()-this->height)/2)
         };
     }
 }
@@ -1683,6 +5949,7 @@ void td::Enemy::move(float elapsed) {
 
     float current_x = this->x;
     float current_y = this->y;
+    this->move_start = sf::Vector2f(current_x, current_y);
 
     // Move the enemy toward the target waypoint
     float target_x = target_waypoint.x;
@@ -1746,6 +6013,7 @@ void td::Enemy::move(float elapsed) {
     // Update the enemy's x and y
     this->x = new_x;
     this->y = new_y;
+    this->move_end = sf::Vector2f(new_x, new_y);
 }
 //------------------------------------------------------------------------------------------------------------------
 
@@ -1767,7 +6035,7 @@ td::Item::Item() : RenderObject() {
  * @param color Item fill color.
  */
 td::Item::Item(const td::Map& map, int width, int height, sf::Color color) : RenderObject() {
-    this->map = map;
+    this->map = &map;
     this->obtained = false;
     this->committed = false;
     this->width = width;
@@ -1831,3 +6099,360 @@ bool td::Item::isCommitted() const {
 void td::Item::setCommitted(bool item_committed) {
     this->committed = item_committed;
 }
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* ContactManifold */
+
+/**
+ * @brief Register a listener for one kind of contact.
+ * @param kind TILE, ENEMY, or ITEM.
+ * @param phases The phases to listen for, combined with |.
+ * @param types For tiles, a bitmask of the tile types to listen for.
+ * @param listener The function to call.
+ * @return An id to pass to removeListener.
+ */
+int td::ContactManifold::addListener(int kind, int phases, td::Map::TileMask types, Listener listener) {
+    Subscription subscription;
+    subscription.id = this->next_listener_id++;
+    subscription.kind = kind;
+    subscription.phases = phases;
+    subscription.types = types;
+    subscription.listener = std::move(listener);
+    this->subscriptions.push_back(std::move(subscription));
+    return this->subscriptions.back().id;
+}
+
+/**
+ * @brief Call the listeners that listen for a contact in a phase.
+ * @param entry The contact.
+ * @param phase ENTER, STAY, or EXIT.
+ */
+void td::ContactManifold::dispatch(const Entry& entry, Phase phase) const {
+    for (const auto& subscription : this->subscriptions) {
+        if (subscription.kind != entry.kind || (subscription.phases & phase) == 0) continue;
+        if (entry.kind == Kind::TILE && (subscription.types & entry.contact.tile_types) == 0) continue;
+        subscription.listener(entry.contact, phase);
+    }
+}
+
+/**
+ * @brief Listen for contacts with tiles of certain types. Each tile the player touches is its own contact, so
+ * touching two checkpoint tiles at once calls the listener twice. A tile whose type changes while the player touches
+ * it ends one contact and begins another.
+ * @param phases The phases to listen for, combined with |, e.g. ENTER | STAY.
+ * @param types A bitmask of tile types, built with td::Map::mask.
+ * @param listener A function taking the contact and its phase. Must not add or remove listeners.
+ * @return An id to pass to removeListener.
+ */
+int td::ContactManifold::addTileListener(int phases, td::Map::TileMask types, Listener listener) {
+    return this->addListener(Kind::TILE, phases, types, std::move(listener));
+}
+
+/**
+ * @brief Listen for contacts with enemies, tested according to setEnemyShape.
+ * @param phases The phases to listen for, combined with |.
+ * @param listener A function taking the contact and its phase. Must not add or remove listeners.
+ * @return An id to pass to removeListener.
+ */
+int td::ContactManifold::addEnemyListener(int phases, Listener listener) {
+    return this->addListener(Kind::ENEMY, phases, 0, std::move(listener));
+}
+
+/**
+ * @brief Listen for contacts with items that have not been obtained. Obtaining an item ends its contact.
+ * @param phases The phases to listen for, combined with |.
+ * @param listener A function taking the contact and its phase. Must not add or remove listeners.
+ * @return An id to pass to removeListener.
+ */
+int td::ContactManifold::addItemListener(int phases, Listener listener) {
+    return this->addListener(Kind::ITEM, phases, 0, std::move(listener));
+}
+
+/**
+ * @brief Stop calling a listener.
+ * @param id The id returned when the listener was added.
+ */
+void td::ContactManifold::removeListener(int id) {
+    for (auto it = this->subscriptions.begin(); it != this->subscriptions.end(); ++it) {
+        if (it->id == id) {
+            this->subscriptions.erase(it);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Set how enemies are tested against the player. Default value: BOXES.
+ * @param shape BOXES, CIRCLES, SWEPT_CIRCLES, or PIXELS.
+ */
+void td::ContactManifold::setEnemyShape(td::ContactManifold::EnemyShape shape) {
+    this->enemy_shape = shape;
+}
+
+/**
+ * @brief Gather everything the player touches, and call the listeners.
+ * Only the kinds of contact that are listened for are gathered: one tile query for all the tile types listened
+ * for, and one query each of the enemies and the items near the player. Then the contacts are compared with the
+ * last update's, and the listeners are called for each contact, tiles first, then enemies, then items.
+ * Call it once per tick, after the player and the enemies have moved.
+ * @param player The player.
+ */
+void td::ContactManifold::update(td::Player& player) {
+    std::swap(this->previous, this->contacts);
+    this->contacts.clear();
+
+    // Find out what is listened for
+    td::Map::TileMask tile_types = 0;
+    bool enemies = false;
+    bool items = false;
+    for (const auto& subscription : this->subscriptions) {
+        if (subscription.kind == Kind::TILE) tile_types |= subscription.types;
+        enemies = enemies || subscription.kind == Kind::ENEMY;
+        items = items || subscription.kind == Kind::ITEM;
+    }
+
+    // Gather the contacts
+    const td::Map* map = player.getMap();
+    if (tile_types != 0 && map != nullptr) {
+        map->forEachCollision(tile_types, player.getBounds(), [&](const td::Tile& tile) {
+            Entry entry;
+            entry.kind = Kind::TILE;
+            entry.key = ((std::uint64_t)(std::uint32_t)tile.row << 32) | ((std::uint64_t)(std::uint32_t)tile.col << 8) |
+                        (unsigned char)tile.type_id;
+            entry.contact.tile = tile;
+            entry.contact.tile_types = map->getTypeMask(tile.type_id);
+            this->contacts.push_back(entry);
+        });
+    }
+    if (enemies) {
+        std::vector<td::Enemy*> touching = this->enemy_shape == EnemyShape::SWEPT_CIRCLES
+                ? player.getSweptCircleEnemies()
+                : this->enemy_shape == EnemyShape::CIRCLES ? player.getTouchingCircleEnemies()
+                : this->enemy_shape == EnemyShape::PIXELS ? player.getTouchingPixelEnemies()
+                                                          : player.getTouchingEnemies();
+        for (td::Enemy* enemy : touching) {
+            Entry entry;
+            entry.kind = Kind::ENEMY;
+            entry.key = (std::uint64_t)(std::uintptr_t)enemy;
+            entry.contact.enemy = enemy;
+            this->contacts.push_back(entry);
+        }
+    }
+    if (items) {
+        for (td::Item* item : player.getTouchingItems()) {
+            Entry entry;
+            entry.kind = Kind::ITEM;
+            entry.key = (std::uint64_t)(std::uintptr_t)item;
+            entry.contact.item = item;
+            this->contacts.push_back(entry);
+        }
+    }
+    auto before = [](const Entry& a, const Entry& b) { return a.kind != b.kind ? a.kind < b.kind : a.key < b.key; };
+    std::sort(this->contacts.begin(), this->contacts.end(), before);
+
+    // Compare with the last update's contacts. Both are sorted, so walk them side by side
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < this->contacts.size() || j < this->previous.size()) {
+        if (j == this->previous.size() || (i < this->contacts.size() && before(this->contacts[i], this->previous[j]))) {
+            this->dispatch(this->contacts[i++], Phase::ENTER);
+        } else if (i == this->contacts.size() || before(this->previous[j], this->contacts[i])) {
+            this->dispatch(this->previous[j++], Phase::EXIT);
+        } else {
+            this->dispatch(this->contacts[i++], Phase::STAY);
+            j++;
+        }
+    }
+}
+
+/**
+ * @brief Forget all contacts without calling any listeners, such as when the player moves to another map. The next
+ * update reports everything the player touches as new.
+ */
+void td::ContactManifold::clear() {
+    this->contacts.clear();
+    this->previous.clear();
+}
+
+/**
+ * @brief Get the number of contacts found by the last update.
+ * @return The number of contacts.
+ */
+std::size_t td::ContactManifold::size() const {
+    return this->contacts.size();
+}
+//------------------------------------------------------------------------------------------------------------------
+
+
+/* TileTriggers */
+
+/**
+ * @brief Call the triggers that listen for a tile in a phase.
+ * @param entity The entity that entered or left the tile.
+ * @param hit The tile and its types.
+ * @param phase ENTER or EXIT.
+ */
+void td::TileTriggers::dispatch(td::RenderObject& entity, const Hit& hit, Phase phase) const {
+    for (const auto& trigger : this->triggers) {
+        if (trigger.listener && (trigger.phases & phase) != 0 && (trigger.types & hit.types) != 0)
+            trigger.listener(entity, hit.tile, phase);
+    }
+}
+
+/**
+ * @brief Listen for entities entering or leaving tiles of certain types. Each tile is its own trigger, so stepping
+ * onto two checkpoint tiles at once calls the listener twice. A tile whose type changes under an entity is left as
+ * its old type and entered as its new one.
+ * Tiles that entities already overlap are reported as entered on their next update.
+ * @param phases The phases to listen for, combined with |, e.g. ENTER | EXIT.
+ * @param types A bitmask of tile types, built with td::Map::mask.
+ * @param listener A function taking the entity, the tile, and the phase. Must not add or remove triggers, or update
+ * or forget entities. May be empty, to only track the tiles for touches.
+ * @return An id to pass to removeTrigger.
+ */
+int td::TileTriggers::addTrigger(int phases, td::Map::TileMask types, Listener listener) {
+    Trigger trigger;
+    trigger.id = this->next_trigger_id++;
+    trigger.phases = phases;
+    trigger.types = types;
+    trigger.listener = std::move(listener);
+    this->triggers.push_back(std::move(trigger));
+    this->trigger_types |= types;
+    this->trigger_revision++;
+    return this->triggers.back().id;
+}
+
+/**
+ * @brief Stop calling a trigger's listener.
+ * @param id The id returned when the trigger was added.
+ */
+void td::TileTriggers::removeTrigger(int id) {
+    for (auto it = this->triggers.begin(); it != this->triggers.end(); ++it) {
+        if (it->id == id) {
+            this->triggers.erase(it);
+            break;
+        }
+    }
+    this->trigger_types = 0;
+    for (const auto& trigger : this->triggers) this->trigger_types |= trigger.types;
+    this->trigger_revision++;
+}
+
+/**
+ * @brief Check which trigger tiles an entity overlaps, and call the listeners for the tiles it entered and left
+ * since its last update. Tiles are reported row by row, the ones left before the ones entered at the same spot.
+ * Entities are tracked from their first update, and an entity that moves to another map leaves all its tiles on the
+ * old one. Call it after the entity moves, e.g. once per tick.
+ * If the entity overlaps the same range of tiles as at its last update, on the same map, and neither the map's tiles
+ * nor the triggers have changed since, nothing is looked up at all.
+ * @param entity The entity, such as the player or an enemy.
+ * @return True if the entity's tiles were looked at again, False if the cached range was still good.
+ */
+bool td::TileTriggers::update(td::RenderObject& entity) {
+    Occupant& occupant = this->occupants[&entity];
+    const td::Map* map = entity.getMap();
+    td::AABB bounds = entity.getBounds();
+    int r_start = 0;
+    int c_start = 0;
+    int r_end = -1;
+    int c_end = -1;
+    if (map != nullptr) map->getTileRange(bounds, r_start, c_start, r_end, c_end);
+
+    // Still over the same tiles, so nothing was entered or left
+    std::uint32_t tile_revision = map != nullptr ? map->getTileRevision() : 0;
+    if (r_start == occupant.r_start && c_start == occupant.c_start && r_end == occupant.r_end &&
+        c_end == occupant.c_end && map == occupant.map && tile_revision == occupant.tile_revision &&
+        this->trigger_revision == occupant.trigger_revision) return false;
+
+    this->found.clear();
+    if (map != nullptr && this->trigger_types != 0) {
+        map->forEachCollision(this->trigger_types, bounds, [&](const td::Tile& tile) {
+            Hit hit;
+            hit.tile = tile;
+            hit.types = map->getTypeMask(tile.type_id);
+            this->found.push_back(hit);
+        });
+    }
+    bool same_map = map == occupant.map;
+    occupant.map = map;
+    occupant.tile_revision = tile_revision;
+    occupant.trigger_revision = this->trigger_revision;
+    occupant.r_start = r_start;
+    occupant.c_start = c_start;
+    occupant.r_end = r_end;
+    occupant.c_end = c_end;
+
+    // Swap in the new tiles before calling the listeners, so that they see the entity where it is now
+    std::swap(occupant.hits, this->found);
+    const std::vector<Hit>& before = this->found;
+    const std::vector<Hit>& after = occupant.hits;
+    if (!same_map) {
+        for (const auto& hit : before) this->dispatch(entity, hit, Phase::EXIT);
+        for (const auto& hit : after) this->dispatch(entity, hit, Phase::ENTER);
+        return true;
+    }
+
+    // Both lists are row by row, so walk them side by side
+    auto precedes = [](const td::Tile& a, const td::Tile& b) {
+        return a.row != b.row ? a.row < b.row : a.col < b.col;
+    };
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < before.size() || j < after.size()) {
+        if (j == after.size() || (i < before.size() && precedes(before[i].tile, after[j].tile))) {
+            this->dispatch(entity, before[i++], Phase::EXIT);
+        } else if (i == before.size() || precedes(after[j].tile, before[i].tile)) {
+            this->dispatch(entity, after[j++], Phase::ENTER);
+        } else {
+            // Same spot. Only a change of type counts
+            if (before[i].tile.type_id != after[j].tile.type_id || before[i].types != after[j].types) {
+                this->dispatch(entity, before[i], Phase::EXIT);
+                this->dispatch(entity, after[j], Phase::ENTER);
+            }
+            i++;
+            j++;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check if an entity overlapped a trigger tile of certain types at its last update.
+ * Only the types listened for by some trigger are tracked.
+ * @param entity The entity.
+ * @param types A bitmask of tile types, built with td::Map::mask.
+ * @return Boolean. True = the entity overlaps such a tile, False = it does not, or it has never been updated.
+ */
+bool td::TileTriggers::touches(const td::RenderObject& entity, td::Map::TileMask types) const {
+    auto it = this->occupants.find(&entity);
+    if (it == this->occupants.end()) return false;
+    for (const auto& hit : it->second.hits) {
+        if ((hit.types & types) != 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Stop tracking an entity without calling any listeners, such as when it is destroyed. If it is updated
+ * again, every trigger tile it overlaps is reported as entered.
+ * @param entity The entity.
+ */
+void td::TileTriggers::forget(const td::RenderObject& entity) {
+    this->occupants.erase(&entity);
+}
+
+/**
+ * @brief Stop tracking all entities without calling any listeners, such as when the player moves to another map.
+ */
+void td::TileTriggers::clear() {
+    this->occupants.clear();
+}
+
+/**
+ * @brief Get the number of entities being tracked.
+ * @return The number of entities.
+ */
+std::size_t td::TileTriggers::size() const {
+    return this->occupants.size();
+}
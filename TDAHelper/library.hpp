@@ -18,6 +18,21 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <tuple>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 /**
  * @namespace td
@@ -27,6 +42,130 @@ namespace td {
     // Forward declarations
     class Enemy;
     class Item;
+    class LevelTemplate;
+    class Rooms;
+
+    // Geometry:
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @struct Vec2
+     * @brief A point or offset in pixels. A plain value type with constexpr arithmetic, for collision code that would
+     * otherwise pass sf::Vector2f around. Converts implicitly from sf::Vector2f.
+     */
+    struct Vec2 {
+        float x;
+        float y;
+
+        Vec2() = default;
+        constexpr Vec2(float x, float y) : x(x), y(y) {}
+        Vec2(const sf::Vector2f& vector) : x(vector.x), y(vector.y) {}
+        sf::Vector2f toVector() const { return {this->x, this->y}; }
+
+        constexpr Vec2 operator+(const Vec2& other) const { return {this->x + other.x, this->y + other.y}; }
+        constexpr Vec2 operator-(const Vec2& other) const { return {this->x - other.x, this->y - other.y}; }
+        constexpr Vec2 operator*(float scale) const { return {this->x * scale, this->y * scale}; }
+        constexpr bool operator==(const Vec2& other) const { return this->x == other.x && this->y == other.y; }
+        constexpr bool operator!=(const Vec2& other) const { return !(*this == other); }
+        constexpr float dot(const Vec2& other) const { return this->x * other.x + this->y * other.y; }
+        constexpr float lengthSquared() const { return this->dot(*this); }
+        float length() const { return std::sqrt(this->lengthSquared()); }
+    };
+
+    /**
+     * @struct AABB
+     * @brief An axis-aligned box, stored by its edges. A plain value type for collision code, in place of building
+     * sf::RectangleShape objects only to ask for their bounds. Converts implicitly from sf::FloatRect; use
+     * td::AABB::of for SFML shapes.
+     */
+    struct AABB {
+        float left;
+        float top;
+        float right;
+        float bottom;
+
+        AABB() = default;
+        constexpr AABB(float left, float top, float right, float bottom)
+                : left(left), top(top), right(right), bottom(bottom) {}
+        AABB(const sf::FloatRect& rect)
+                : left(rect.left), top(rect.top), right(rect.left + rect.width), bottom(rect.top + rect.height) {}
+        static constexpr AABB fromSize(const Vec2& position, const Vec2& size) {
+            return {position.x, position.y, position.x + size.x, position.y + size.y};
+        }
+        // The bounds of an unrotated, unscaled shape
+        static AABB of(const sf::RectangleShape& shape) {
+            return fromSize(shape.getPosition() - shape.getOrigin(), shape.getSize());
+        }
+        sf::FloatRect toRect() const { return {this->left, this->top, this->width(), this->height()}; }
+
+        constexpr float width() const { return this->right - this->left; }
+        constexpr float height() const { return this->bottom - this->top; }
+        constexpr Vec2 center() const { return {(this->left + this->right) / 2, (this->top + this->bottom) / 2}; }
+        constexpr bool isEmpty() const { return this->right <= this->left || this->bottom <= this->top; }
+
+        // Boxes that only share an edge do not intersect, like sf::FloatRect::intersects
+        constexpr bool intersects(const AABB& other) const {
+            return std::max(this->left, other.left) < std::min(this->right, other.right) &&
+                   std::max(this->top, other.top) < std::min(this->bottom, other.bottom);
+        }
+        // The left and top edges are inside and the right and bottom ones are not, like sf::FloatRect::contains
+        constexpr bool contains(const Vec2& point) const {
+            return point.x >= this->left && point.x < this->right && point.y >= this->top && point.y < this->bottom;
+        }
+        constexpr bool contains(const AABB& other) const {
+            return other.left >= this->left && other.right <= this->right &&
+                   other.top >= this->top && other.bottom <= this->bottom;
+        }
+        constexpr AABB merged(const AABB& other) const {
+            return {std::min(this->left, other.left), std::min(this->top, other.top),
+                    std::max(this->right, other.right), std::max(this->bottom, other.bottom)};
+        }
+        constexpr AABB grown(float margin) const {
+            return {this->left - margin, this->top - margin, this->right + margin, this->bottom + margin};
+        }
+        constexpr AABB moved(const Vec2& offset) const {
+            return {this->left + offset.x, this->top + offset.y, this->right + offset.x, this->bottom + offset.y};
+        }
+        // Squared distance from a point to the nearest point of the box, or 0 inside it
+        constexpr float distanceSquared(const Vec2& point) const {
+            return Vec2(std::max(std::max(this->left - point.x, point.x - this->right), 0.f),
+                        std::max(std::max(this->top - point.y, point.y - this->bottom), 0.f)).lengthSquared();
+        }
+    };
+
+    /**
+     * @struct Circle
+     * @brief A circle, by its center and radius. A plain value type for collision code, in place of sf::CircleShape.
+     * Use td::Circle::of for SFML shapes.
+     */
+    struct Circle {
+        Vec2 center;
+        float radius;
+
+        Circle() = default;
+        constexpr Circle(const Vec2& center, float radius) : center(center), radius(radius) {}
+        // The circle of an unscaled shape, wherever its origin is
+        static Circle of(const sf::CircleShape& shape) {
+            float r = shape.getRadius();
+            return {Vec2(shape.getPosition() - shape.getOrigin()) + Vec2(r, r), r};
+        }
+        constexpr AABB bounds() const {
+            return {this->center.x - this->radius, this->center.y - this->radius,
+                    this->center.x + this->radius, this->center.y + this->radius};
+        }
+
+        // Touching counts as intersecting
+        constexpr bool intersects(const AABB& box) const {
+            return box.distanceSquared(this->center) <= this->radius * this->radius;
+        }
+        constexpr bool intersects(const Circle& other) const {
+            return (other.center - this->center).lengthSquared() <=
+                   (this->radius + other.radius) * (this->radius + other.radius);
+        }
+        constexpr bool contains(const Vec2& point) const {
+            return (point - this->center).lengthSquared() <= this->radius * this->radius;
+        }
+    };
 
     // Classes:
     //------------------------------------------------------------------------------------------------------------------
@@ -38,9 +177,9 @@ namespace td {
     class Util {
     public:
         template <typename V>
-        static int find(std::vector<V> vector, V val);
+        static int find(const std::vector<V>& vector, const V& val);
         template<typename K, typename V>
-        static bool keyInMap(std::map<K, V> map, K key);
+        static bool keyInMap(const std::map<K, V>& map, const K& key);
         /**
          * @struct size
          * @brief Helpful struct for storing a pair of width and height values.
@@ -49,8 +188,80 @@ namespace td {
             int width{0};
             int height{0};
         };
+        /**
+         * @struct Circles
+         * @brief A batch of circles, stored as one array per field so that they can be tested several at a time.
+         */
+        struct Circles {
+            std::vector<float> x;
+            std::vector<float> y;
+            std::vector<float> radius;
+            void clear() { this->x.clear(); this->y.clear(); this->radius.clear(); }
+            void add(const td::Circle& circle) {
+                this->x.push_back(circle.center.x); this->y.push_back(circle.center.y);
+                this->radius.push_back(circle.radius);
+            }
+            std::size_t size() const { return this->x.size(); }
+        };
+        /**
+         * @struct Rects
+         * @brief A batch of rectangles, stored as one array per field so that they can be tested several at a time.
+         */
+        struct Rects {
+            std::vector<float> left;
+            std::vector<float> top;
+            std::vector<float> right;
+            std::vector<float> bottom;
+            void clear() { this->left.clear(); this->top.clear(); this->right.clear(); this->bottom.clear(); }
+            void add(const td::AABB& box) {
+                this->left.push_back(box.left); this->top.push_back(box.top);
+                this->right.push_back(box.right); this->bottom.push_back(box.bottom);
+            }
+            std::size_t size() const { return this->left.size(); }
+        };
         static float dist(float x1, float y1, float x2, float y2);
         static bool intersects(const sf::CircleShape& circle, const sf::RectangleShape& rect);
+        static bool intersects(const td::Circle& circle, const td::AABB& box);
+        static void intersects(const Circles& circles, const td::AABB& box, std::vector<std::uint64_t>& hits);
+        static void intersects(const Rects& rects, const td::AABB& box, std::vector<std::uint64_t>& hits);
+        static const char* batchInstructionSet();
+        static float contactTime(const td::Circle& circle, const td::Vec2& motion, const td::AABB& box);
+        static std::string directoryOf(const std::string& path);
+        static std::string joinPath(const std::string& directory, const std::string& path);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class View
+     * @brief A non-owning, read-only view over a contiguous range of elements, similar to std::span.
+     * Lets accessors hand out tiles, rows, and entity lists without copying them.
+     * A view is only valid until the container it looks at is resized or destroyed.
+     * @tparam T The element type.
+     */
+    template <typename T>
+    class View {
+    private:
+        const T* first;
+        std::size_t count;
+    public:
+        // Constructors
+        View() : first(nullptr), count(0) {}
+        View(const T* data, std::size_t size) : first(data), count(size) {}
+        View(const std::vector<T>& vector) : first(vector.data()), count(vector.size()) {}  // NOLINT: implicit on purpose
+
+        // Iteration
+        const T* begin() const { return this->first; }
+        const T* end() const { return this->first + this->count; }
+
+        // Access
+        const T& operator[](std::size_t i) const { return this->first[i]; }
+        const T& front() const { return this->first[0]; }
+        const T& back() const { return this->first[this->count - 1]; }
+        const T* data() const { return this->first; }
+
+        // Size
+        std::size_t size() const { return this->count; }
+        bool empty() const { return this->count == 0; }
     };
     //------------------------------------------------------------------------------------------------------------------
 
@@ -167,6 +378,11 @@ namespace td {
         // Highlighting rectangles
         std::vector<std::vector<sf::RectangleShape>> menuItemRects;
 
+        // Cached button text and outlines, rebuilt only when the menu's content or styling changes
+        std::vector<std::vector<sf::Text>> menuItemTexts;
+        std::vector<std::vector<sf::RectangleShape>> menuItemOutlines;
+        bool renderCacheDirty{};
+
         // Colors
         sf::Color onHoverColor;
         sf::Color outlineColor;
@@ -181,9 +397,10 @@ namespace td {
 
         void initVariables();
         void createOnHoverRectangles();
+        void createRenderCache();
 
         // Getters
-        std::vector<std::vector<std::string>> getMenuItems();
+        const std::vector<std::vector<std::string>>& getMenuItems() const;
         sf::Vector2f getPosition() const;
 
         // Setters
@@ -208,9 +425,172 @@ namespace td {
     };
     //------------------------------------------------------------------------------------------------------------------
 
+    /**
+     * @class HUDWidget
+     * @brief A retained heads-up display text element, bound to a live int, string, or timer value.
+     * The text is only re-formatted and re-laid out when the bound value or the view changes.
+     * Otherwise, drawing re-submits the cached text geometry.
+     */
+    class HUDWidget {
+    private:
+        /**
+         * @enum Binding
+         * @brief The kind of value the widget displays.
+         */
+        enum Binding {
+            NONE = 0,
+            INT = 1,
+            STRING = 2,
+            TIMER = 3
+        };
+        Binding binding;
+
+        // Bound values
+        const int* int_value;
+        int int_offset;
+        const std::string* string_value;
+        const float* timer_value;
+
+        // Last displayed values
+        int last_int;
+        std::string last_string;
+        int last_seconds;
+
+        // Last view the text was laid out for
+        sf::Vector2f last_view_center;
+        sf::Vector2f last_view_size;
+        float last_view_rotation;
+        sf::FloatRect last_viewport;
+        sf::Vector2u last_target_size;
+
+        // Text
+        std::string label;
+        td::Text::Config config;
+        bool relativeToView;
+        sf::Text text;
+
+        // Cache state
+        bool format_dirty;
+        bool layout_dirty;
+
+        void initVariables();
+        bool valueChanged() const;
+        bool viewChanged(const sf::RenderTarget* target) const;
+        void format();
+        void layout(const sf::RenderTarget* target);
+    public:
+        // Constructor/destructor
+        HUDWidget();
+        HUDWidget(const std::string& label, const td::Text::Config& config, bool relativeToView=true);
+        ~HUDWidget();
+
+        // Binding
+        void bind(const int* value, int offset = 0);
+        void bind(const std::string* value);
+        void bindTimer(const float* seconds);
+        void unbind();
+
+        // Setters
+        void setLabel(const std::string& l);
+        void setTextConfig(const td::Text::Config& c);
+        void invalidate();
+
+        // Render
+        void draw(sf::RenderTarget* target);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @struct EmbeddedFile
+     * @brief A file compiled into the program as constexpr data by the td_embed_assets CMake function
+     * (TDAHelper/cmake/EmbedAssets.cmake). The data is followed by a NUL byte that is not counted in size.
+     */
+    struct EmbeddedFile {
+        const char* path;
+        const unsigned char* data;
+        std::size_t size;
+    };
+
+    /**
+     * @class Embedded
+     * @brief Registry of files compiled into the program, consulted before the disk whenever TDAHelper loads a map,
+     * level manifest, or texture. Mounting a table only stores a pointer to it, so an embedded file costs nothing
+     * until it is loaded, and compiled maps are read straight from the program's read-only data without copying.
+     */
+    class Embedded {
+    private:
+        struct Mount {
+            const td::EmbeddedFile* files;
+            std::size_t count;
+            std::string prefix;
+        };
+        static std::vector<Mount> mounts;
+        static std::mutex mutex;
+        static std::string normalize(const std::string& path);
+    public:
+        static void mount(const td::EmbeddedFile* files, std::size_t count, const std::string& prefix = "");
+        template <std::size_t N>
+        static void mount(const td::EmbeddedFile (&files)[N], const std::string& prefix = "") {
+            td::Embedded::mount(files, N, prefix);
+        }
+        static const td::EmbeddedFile* find(const std::string& path);
+        static std::unique_ptr<std::istream> open(const std::string& path);
+        static bool loadTexture(sf::Texture& texture, const std::string& file);
+        static bool loadImage(sf::Image& image, const std::string& file);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class TextureCache
+     * @brief Loads each texture file once and shares it between everything that uses it.
+     * The cache only holds weak references, so a texture is freed once nothing uses it any more.
+     * Safe to use from the td::World loader thread.
+     */
+    class TextureCache {
+    private:
+        static std::map<std::string, std::weak_ptr<sf::Texture>> textures;
+        static std::mutex mutex;
+    public:
+        static std::shared_ptr<sf::Texture> load(const std::string& file);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class CollisionMask
+     * @brief Which pixels of an object are solid, taken from the alpha of its texture scaled to the object's size.
+     * Each row is packed into 64-bit words, the leftmost pixel in the lowest bit, so two masks are tested against
+     * each other a word at a time: each row of one is shifted to line up with the other and the two are ANDed.
+     * Masks are immutable once built, and td::CollisionMask::load shares them between objects.
+     */
+    class CollisionMask {
+    private:
+        int width;
+        int height;
+        int words;                         // Words per row
+        std::vector<std::uint64_t> rows;   // height rows of words each. Bits past the width are always clear
+
+        static std::map<std::tuple<std::string, int, int>, std::weak_ptr<const td::CollisionMask>> masks;
+        static std::mutex mutex;
+
+        std::uint64_t bits(int row, int first) const;
+    public:
+        static const std::uint8_t DEFAULT_MIN_ALPHA = 128;
+
+        CollisionMask(const sf::Image& image, int width, int height, std::uint8_t min_alpha = DEFAULT_MIN_ALPHA);
+        static std::shared_ptr<const td::CollisionMask> load(const std::string& file, int width, int height);
+
+        int getWidth() const;
+        int getHeight() const;
+        bool isSet(int x, int y) const;
+        bool overlaps(const td::CollisionMask& other, int dx, int dy) const;
+        bool overlaps(int left, int top, int right, int bottom) const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
     /**
      * @class SpriteSheet
      * @brief Defines a mapping between rectangle shapes and textures.
+     * Copies of a sprite sheet share its textures, which are freed once the last copy is destroyed.
      */
     class SpriteSheet {
     public:
@@ -219,6 +599,7 @@ namespace td {
         ~SpriteSheet();
 
         std::map<char, sf::RectangleShape> mapping;
+        std::vector<std::shared_ptr<sf::Texture>> textures;
         void addSprite(char id, sf::Color color);
         void addTexture(char id, const std::string& file);
     };
@@ -229,6 +610,7 @@ namespace td {
      * @brief An individual tile within a tile grid.
      * Stores information about sprite_id (what sprite is on the tile)
      * and type_id (the tile's type and how the tile should behave).
+     * Maps do not store Tile objects; a Tile is a lightweight value built on request from the map's grid.
      */
     class Tile {
     public:
@@ -248,36 +630,152 @@ namespace td {
         // Get tile rect
         sf::RectangleShape getRect(int tile_size = td::Tile::DEFAULT_TILE_SIZE) const;
         // Get sprite
-        sf::RectangleShape getSprite(td::SpriteSheet& sprite_sheet, int tile_size = td::Tile::DEFAULT_TILE_SIZE) const;
+        sf::RectangleShape getSprite(const td::SpriteSheet& sprite_sheet, int tile_size = td::Tile::DEFAULT_TILE_SIZE) const;
         sf::Vector2i getPosition(int tile_size = td::Tile::DEFAULT_TILE_SIZE) const;
     };
     //------------------------------------------------------------------------------------------------------------------
 
     /**
-     * @class Map
-     * @brief A tile grid map composed of Tile objects.
-     * Stores key game information such as enemies and items.
-     * Also handles crucial functions like player-tile collision detection.
+     * @class SpatialGrid
+     * @brief A uniform grid of square cells that buckets objects by the cell under their top-left corner, so that
+     * the objects near a box can be found without looking at all of them.
+     * Objects are identified by ids from 0 to count - 1, such as their index in a list. Objects outside of the grid's
+     * area are kept in the nearest edge cell. Moving an object within its cell costs nothing, and moving it to
+     * another cell is a swap-remove from one cell's list and an append to the other's.
      */
-    class Map {
+    class SpatialGrid {
     private:
-        // Game map
-        std::vector<std::vector<char>> map_raw;
-        std::vector<std::vector<td::Tile>> map;
+        /**
+         * @struct Slot
+         * @brief Where an object is stored: its cell, and its index in that cell's list.
+         */
+        struct Slot {
+            std::int32_t cell{-1};
+            std::uint32_t index{};
+        };
 
-        // Special tile types mapper
-        std::map<int, std::vector<char>> tile_types;
+        float cell_size{1};
+        int rows{};
+        int cols{};
+        std::vector<std::vector<std::uint32_t>> cells;
+        std::vector<Slot> slots;
 
-        // Tile configurations
-        int tile_size{};
-        int max_allowed_tile_size{};
+        // The largest object placed so far. A query looks this far up and to the left of its box
+        sf::Vector2f max_size;
 
-        // Sprites
-        td::SpriteSheet sprite_sheet{};
+        int cellAt(float x, float y) const;
+    public:
+        // Setup
+        void reset(const sf::Vector2i& area, float size, std::size_t count);
+        void clear();
 
-        // Player
-        int player_start_row{};
-        int player_start_col{};
+        // Objects
+        void place(std::uint32_t id, const sf::FloatRect& bounds);
+        void remove(std::uint32_t id);
+
+        // Queries
+        void query(const sf::FloatRect& bounds, std::vector<std::uint32_t>& ids) const;
+
+        // Getters
+        std::size_t size() const;
+        float getCellSize() const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class SweepAndPrune
+     * @brief A broadphase that finds the pairs of objects whose boxes overlap, by keeping the boxes sorted by their
+     * left edge and sweeping along the x axis. Objects move little between frames, so the order is kept with an
+     * insertion sort, which costs close to nothing when little has changed.
+     * Objects are identified by ids from 0 to count - 1, like in td::SpatialGrid. Each belongs to one of
+     * MAX_GROUPS groups, such as enemies, items, or projectiles, and only pairs from groups set to collide are
+     * reported.
+     */
+    class SweepAndPrune {
+    private:
+        /**
+         * @struct Box
+         * @brief An object's edges, id, and group.
+         */
+        struct Box {
+            float left{};
+            float right{};
+            float top{};
+            float bottom{};
+            std::uint32_t id{};
+            int group{};
+        };
+
+        std::vector<Box> boxes;            // Sorted by left edge whenever pairs are found
+        std::vector<std::int32_t> slots;   // Index of each object's box, or -1 if it is not placed
+        std::uint32_t group_masks[32]{};   // Bit b of group_masks[a] is set if groups a and b collide
+
+        void sort();
+    public:
+        static const int MAX_GROUPS = 32;
+
+        // Setup
+        void reset(std::size_t count);
+        void clear();
+        void setGroupsCollide(int group_a, int group_b, bool collide = true);
+        bool groupsCollide(int group_a, int group_b) const;
+
+        // Objects
+        void place(std::uint32_t id, const sf::FloatRect& bounds, int group);
+        void remove(std::uint32_t id);
+
+        // Queries
+        void findPairs(std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs);
+
+        // Getters
+        std::size_t size() const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class WorkerPool
+     * @brief A fixed set of threads that stay asleep between jobs, for splitting one batch of work, such as
+     * td::Map's batched line of sight tests, without starting threads for every batch.
+     * A job is a number of tasks, numbered from 0, which the workers and the calling thread take in turn. Jobs from
+     * different threads run one at a time. Tasks must not throw, or start a job on the same pool.
+     */
+    class WorkerPool {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;               // Guards everything below
+        std::mutex running;             // Held for the length of a job
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(std::size_t)>* task{};
+        std::size_t task_count{};
+        std::size_t next_task{};
+        std::size_t unfinished{};
+        bool stopping{};
+
+        bool runNext(std::unique_lock<std::mutex>& lock);
+        void workerLoop();
+    public:
+        explicit WorkerPool(std::size_t worker_count);
+        ~WorkerPool();
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        void run(std::size_t count, const std::function<void(std::size_t)>& job);
+        std::size_t getWorkerCount() const;
+        static td::WorkerPool& shared();
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @struct MapState
+     * @brief The per-instance values of a td::Map, copied as they are when the map is copied.
+     * Kept apart from the members that need more care on a copy (tile listeners and spawned entities), so that a
+     * member added here is copied without td::Map's copy operations having to list it.
+     */
+    struct MapState {
+        // Level data shared between instances: tiles, tile types, sprite sheet, tile size
+        std::shared_ptr<const td::LevelTemplate> level;
+        std::uint32_t tile_revision{};  // Changed along with the tiles, tile types or tile size. See getTileRevision
 
         // Enemies
         std::vector<td::Enemy*> enemies;
@@ -285,12 +783,87 @@ namespace td {
         // Items
         std::vector<td::Item*> items;
 
+        // Textures of the spawned entities
+        std::vector<std::shared_ptr<sf::Texture>> entity_textures;
+
+        // Checkpoints
+        std::vector<sf::Vector2f> checkpointList;
+
+        // Spatial grids of the enemies and items, by index into the lists above. Kept up to date by moveEnemies,
+        // and rebuilt on the next query after the lists change
+        mutable td::SpatialGrid enemy_grid;
+        mutable td::SpatialGrid item_grid;
+        mutable bool enemy_grid_dirty{true};
+        mutable bool item_grid_dirty{true};
+        mutable std::vector<std::uint32_t> grid_candidates;
+        mutable td::Util::Circles enemy_circles;  // Shapes of the enemies near a query, tested as a batch
+        mutable td::Util::Rects enemy_rects;
+        mutable std::vector<std::uint64_t> enemy_hits;
+        mutable std::vector<sf::FloatRect> sweep_candidates;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class Map
+     * @brief A tile grid map composed of Tile objects.
+     * Stores key game information such as enemies and items.
+     * Also handles crucial functions like player-tile collision detection.
+     * A Map is a lightweight level instance: the tiles, tile types, and sprite sheet live in a shared
+     * td::LevelTemplate, and the map itself only holds per-session state such as enemies, items, and checkpoints.
+     * Copying a map gives an independent instance, with its own clones of the entities it spawned and no tile
+     * listeners.
+     */
+    class Map : private td::MapState {
+    public:
+        /**
+         * @struct PaletteEntry
+         * @brief A distinct (sprite_id, type_id) pair used by the map. Each grid cell stores an index into the
+         * map's palette of these, rather than its own copy of the pair.
+         */
+        struct PaletteEntry {
+            char sprite_id{};
+            char type_id{};
+        };
+        typedef std::uint16_t TileIndex;
+        typedef std::uint32_t TileMask;
+        typedef std::function<void(const td::Tile& old_tile, const td::Tile& new_tile)> TileListener;
+        /**
+         * @struct RayHit
+         * @brief Where a ray cast with td::Map::raycast stopped.
+         */
+        struct RayHit {
+            td::Tile tile;  // The blocking tile
+            sf::Vector2f point;  // Where the ray entered the tile
+            sf::Vector2f normal;  // The side of the tile it entered through, e.g. (-1, 0) for the left side
+            float distance{};  // From the start of the ray to the point, in pixels
+        };
+    private:
+        // Called after setTile changes a tile, by listener id. Not copied with the map
+        std::vector<std::pair<int, TileListener>> tile_listeners;
+        int next_listener_id{};
+
+        // Enemies and items created by spawnEntities. Owned by the map; copies of the map get their own clones
+        std::unique_ptr<std::vector<td::Enemy>> spawned_enemies;
+        std::unique_ptr<std::vector<td::Item>> spawned_items;
+
+        void syncEnemyGrid() const;
+        void syncItemGrid() const;
+        bool getRoomArea(int room, sf::FloatRect& area) const;
+
         // Initialization
         void initVariables();
+        void readManifest(const std::string& path);
+        void cloneSpawnedEntities(const td::Map& other);
+
+        // Copy-on-write access to the level template
+        td::LevelTemplate& editLevel();
     public:
         // Constructor/destructor
         Map();
         explicit Map(const std::string& path);
+        explicit Map(std::shared_ptr<const td::LevelTemplate> level_template);
+        Map(const td::Map& other);
+        td::Map& operator=(const td::Map& other);
         ~Map();
 
         /**
@@ -305,10 +878,13 @@ namespace td {
             DOOR = 5,
             KEY = 6
         };
+        static const int MAX_TILE_TYPE = 31;
+        static TileMask mask(int type);
+        static int tileTypeFromName(const std::string& name);
 
         // Read in the map
         void readMap(const std::string& path);
-        std::vector<sf::Vector2f> checkpointList;
+        using td::MapState::checkpointList;
 
         // Render
         void draw(sf::RenderTarget* target);
@@ -317,18 +893,49 @@ namespace td {
 
         // Getters
         int getTileSize() const;
-        td::Tile getTile(float x, float y);
+        td::Tile getTile(float x, float y) const;
+        td::Tile getTileAt(int row, int col) const;
+        TileIndex getTileIndex(int row, int col) const;
+        const PaletteEntry& getPaletteEntry(TileIndex index) const;
+        bool inBounds(int row, int col) const;
+        std::size_t getMergedRectCount() const;
+        float getMergeRatio() const;
         std::vector<std::vector<td::Tile>> getMap();
-        std::vector<char> getTileType(int type);
-        td::Tile getPlayerStartTile();
-        sf::Vector2i getMapSize(bool rows_cols = false);
+        td::View<TileIndex> getGrid() const;
+        td::View<TileIndex> getRow(int row) const;
+        td::View<PaletteEntry> getPalette() const;
+        const std::vector<char>& getTileType(int type) const;
+        TileMask getTypeMask(char type_id) const;
+        bool isType(char type_id, int type) const;
+        td::Tile getPlayerStartTile() const;
+        std::vector<td::Tile> getTilesOfType(int type) const;
+        std::size_t countTilesOfType(int type) const;
+        bool getNearestTileOfType(int type, float x, float y, td::Tile& nearest) const;
+        const td::Rooms& getRooms() const;
+        int getRoom(float x, float y) const;
+        std::vector<td::Enemy*> getEnemiesInRoom(int room) const;
+        std::vector<td::Item*> getItemsInRoom(int room) const;
+        sf::Vector2i getMapSize(bool rows_cols = false) const;
+        std::shared_ptr<const td::LevelTemplate> getLevel() const;
         std::vector<td::Enemy*>* getEnemies();
         std::vector<td::Item*>* getItems();
+        td::View<td::Enemy*> getEnemyView() const;
+        td::View<td::Item*> getItemView() const;
 
         // Setters
         void setSpriteSheet(const td::SpriteSheet& sheet);
         void setTileSize(int size);
         void setTileType(int type, std::vector<char> type_id);
+        void setIndexedTypes(TileMask types);
+        void setTile(int row, int col, char sprite_id, char type_id);
+
+        // Tile changes
+        int addTileListener(TileListener listener);
+        void removeTileListener(int id);
+        std::uint32_t getTileRevision() const;
+
+        // Rooms
+        void buildRooms();
 
         // Enemies
         void addEnemy(td::Enemy* enemy);
@@ -339,10 +946,552 @@ namespace td {
         void addItem(td::Item* item);
         void resetItems();
 
+        // Proximity
+        static const int GRID_CELL_TILES = 2;
+        template <typename Visitor>
+        void forEachEnemyNear(const sf::FloatRect& bounds, Visitor&& visit) const;
+        template <typename Visitor>
+        void forEachItemNear(const sf::FloatRect& bounds, Visitor&& visit) const;
+        void findEnemiesTouching(const td::AABB& bounds, bool circles, std::vector<td::Enemy*>& touching) const;
+
+        // Entities defined by the level
+        void spawnEntities();
+
 
         // Collision
         static bool collides(td::Map& map, const std::vector<char>& type_ids, const sf::RectangleShape& rect);
         static std::vector<td::Tile> getCollisions(td::Map& map, const std::vector<char>& type_ids, const sf::RectangleShape& rect);
+        bool collides(TileMask types, const td::AABB& bounds) const;
+        std::vector<td::Tile> getCollisions(TileMask types, const td::AABB& bounds) const;
+        void getCollisions(TileMask types, const td::AABB& bounds, std::vector<td::Tile>& tiles) const;
+        sf::Vector2f sweep(TileMask types, const sf::FloatRect& bounds, const sf::Vector2f& delta) const;
+        static sf::Vector2f sweep(const std::vector<sf::FloatRect>& walls, const sf::FloatRect& bounds,
+                                  const sf::Vector2f& delta);
+        void getMergedRects(TileMask types, const td::AABB& bounds, std::vector<sf::FloatRect>& rects,
+                            const sf::Vector2f& offset = sf::Vector2f()) const;
+        bool getTileRange(const td::AABB& bounds, int& r_start, int& c_start, int& r_end, int& c_end) const;
+        template <typename Visitor>
+        void forEachCollision(TileMask types, const td::AABB& bounds, Visitor&& visit) const;
+
+        // Line of sight. Batches get one thread of td::WorkerPool::shared per PARALLEL_RAYS rays
+        // (see tdbench --mode rays)
+        static const std::size_t PARALLEL_RAYS = 2048;
+        bool raycast(TileMask types, const sf::Vector2f& from, const sf::Vector2f& to, RayHit& hit) const;
+        bool lineOfSight(TileMask types, const sf::Vector2f& from, const sf::Vector2f& to) const;
+        void lineOfSight(TileMask types, const std::vector<sf::Vector2f>& from, const sf::Vector2f& to,
+                         std::vector<std::uint64_t>& visible) const;
+        void lineOfSight(TileMask types, const std::vector<sf::Vector2f>& from, const std::vector<sf::Vector2f>& to,
+                         std::vector<std::uint64_t>& visible) const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class Rooms
+     * @brief Segmentation of a level's open (non-wall) tiles into rooms and the doorways between them.
+     * A doorway is a chokepoint: a DOOR tile, or an open tile that joins others but is not part of any open
+     * 2 x 2 block, such as a gap in a wall or a one tile wide corridor. Connected doorway tiles form one doorway,
+     * and the open tiles left over form the rooms. Rooms and doorways share one id space and make up a graph,
+     * in which each room is linked to the doorways touching it, and each doorway to the rooms it joins.
+     * When a tile changes, only the rooms and doorways near it are labeled again.
+     */
+    class Rooms {
+    public:
+        /**
+         * @struct Room
+         * @brief A room or doorway: its tiles, bounding box (in tiles), and neighbors in the room graph.
+         */
+        struct Room {
+            bool doorway{};
+            std::vector<std::uint32_t> cells;
+            sf::IntRect bounds;
+            std::vector<int> neighbors;
+        };
+        static const int NONE = -1;
+    private:
+        int rows{};
+        int cols{};
+        bool built{};
+
+        // Room id for each cell, row-major. NONE for walls
+        std::vector<int> labels;
+        std::vector<Room> rooms;
+        std::vector<int> free_ids;
+
+        // Labeling
+        static bool isOpen(const td::LevelTemplate& level, int row, int col);
+        static bool isDoorway(const td::LevelTemplate& level, int row, int col);
+        int newRoom();
+        void fill(const td::LevelTemplate& level, std::uint32_t start, int id);
+        void link(int id);
+    public:
+        // Build/update
+        void build(const td::LevelTemplate& level);
+        void update(const td::LevelTemplate& level, int row, int col);
+        void clear();
+        bool isBuilt() const;
+
+        // Queries
+        int getRoomAt(int row, int col) const;
+        const Room& getRoom(int id) const;
+        std::size_t getRoomCount() const;
+        std::vector<int> getConnectedRooms(int id) const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class LevelTemplate
+     * @brief The immutable part of a level: the tile grid, palette, tile type tables, sprite sheet, and tile size.
+     * Shared between td::Map instances through a reference-counted pointer, so copying a map or loading a level
+     * never copies tiles. A map that is edited while its template is shared first makes its own copy.
+     */
+    class LevelTemplate {
+    public:
+        // Constructor/destructor
+        LevelTemplate();
+        ~LevelTemplate();
+
+        // Tile grid, stored row-major as one contiguous grid of palette indices.
+        // The grid is either owned (tiles) or borrowed from a compiled map file that backing keeps mapped
+        std::vector<td::Map::TileIndex> tiles;
+        const td::Map::TileIndex* external_tiles{};
+        std::shared_ptr<const void> backing;
+        const td::Map::TileIndex* tileData() const;
+        std::vector<td::Map::PaletteEntry> palette;
+        int rows{};
+        int cols{};
+
+        // Special tile types mapper
+        std::map<int, std::vector<char>> tile_types;
+        // Classification table: the bitmask of tile types for each type_id char. Rebuilt by setTileType
+        td::Map::TileMask type_masks[256]{};
+        void rebuildTypeMasks();
+
+        // Position index: the cells (row * cols + col) of each tile type, in ascending order.
+        // Only the types in indexed_types are kept. Walls are left out by default, since they are usually most of the map
+        std::vector<std::uint32_t> type_cells[td::Map::MAX_TILE_TYPE + 1];
+        td::Map::TileMask indexed_types{};
+        void rebuildTypeIndex();
+        void updateTypeIndex(std::uint32_t cell, td::Map::TileMask old_types, td::Map::TileMask new_types);
+
+        // Room segmentation. Only built on request, with td::Map::buildRooms
+        td::Rooms rooms;
+
+        /**
+         * @struct TileRect
+         * @brief A rectangle of identical tiles (the same palette entry), in tiles.
+         */
+        struct TileRect {
+            std::int32_t row{};
+            std::int32_t col{};
+            std::uint16_t rows{};
+            std::uint16_t cols{};
+            td::Map::TileIndex tile{};
+        };
+        // Merged tiles: the tiles of each MERGE_CHUNK_SIZE x MERGE_CHUNK_SIZE chunk, greedily merged into rectangles.
+        // Used for collision, and to draw solid color tiles as single quads. Rebuilt one chunk at a time by setTile
+        static const int MERGE_CHUNK_SIZE = 16;
+        std::vector<std::vector<TileRect>> tile_rects;
+        int rect_chunk_cols{};
+        std::size_t rect_count{};
+        void mergeTiles();
+        void mergeChunk(int chunk_row, int chunk_col);
+
+        // Tile configurations
+        int tile_size{};
+        int max_allowed_tile_size{};
+
+        // Sprites
+        td::SpriteSheet sprite_sheet{};
+
+        // Player start and checkpoints, as found in the map file
+        int player_start_row{};
+        int player_start_col{};
+        std::vector<sf::Vector2f> checkpoints;
+        void findSpecialTiles();
+
+        // Marks an unused index into the strings table
+        static const std::uint32_t NO_STRING = 0xFFFFFFFF;
+
+        /**
+         * @enum EntityKind
+         * @brief The kind of object an entity definition creates.
+         */
+        enum EntityKind {
+            ENEMY = 1,
+            ITEM = 2
+        };
+        /**
+         * @struct EntityDef
+         * @brief A compact, fixed-size definition of an enemy or item placed on the level.
+         * Waypoints (row, col pairs, in tiles) are stored in one shared table and referenced by range.
+         * An item's single waypoint is its position. Sizes are in tiles, so they follow the map's tile size.
+         * The texture is an index into the strings table.
+         */
+        struct EntityDef {
+            std::uint8_t kind{};
+            std::uint8_t move_option{};
+            std::uint16_t reserved{};
+            float speed{};
+            float width{};
+            float height{};
+            std::int32_t harm{};
+            std::uint32_t color{};
+            std::uint32_t first_waypoint{};
+            std::uint32_t waypoint_count{};
+            std::uint32_t texture{NO_STRING};
+        };
+        std::vector<EntityDef> entities;
+        std::vector<sf::Vector2f> waypoints;
+
+        /**
+         * @struct SpriteDef
+         * @brief A sprite sheet entry as declared by a level manifest: a color, or a texture from the strings table.
+         */
+        struct SpriteDef {
+            char sprite_id{};
+            std::uint8_t reserved[3]{};
+            std::uint32_t color{};
+            std::uint32_t texture{NO_STRING};
+        };
+        std::vector<SpriteDef> sprites;
+        void buildSpriteSheet();
+
+        // File paths used by the level. Relative paths are relative to base_dir, the level file's directory
+        std::vector<std::string> strings;
+        std::string base_dir;
+        std::string resolvePath(std::uint32_t string_index) const;
+    };
+
+    /**
+     * @brief Call a function for every tile of certain types that a bounding box is colliding with, without
+     * allocating. The tiles are visited row by row.
+     * Defined here rather than in library.cpp since it is a template, and after td::LevelTemplate since it reads
+     * the tile grid directly.
+     * @param types A bitmask of tile types to check against, built with td::Map::mask.
+     * @param bounds The bounding box to test, such as a player's bounds.
+     * @param visit A function taking a const td::Tile&, called for each colliding tile.
+     */
+    template <typename Visitor>
+    void Map::forEachCollision(TileMask types, const td::AABB& bounds, Visitor&& visit) const {
+        int r_start, c_start, r_end, c_end;
+        if (!this->getTileRange(bounds, r_start, c_start, r_end, c_end)) return;
+
+        // Every tile in the range overlaps the box, so only the tile types need checking
+        const td::LevelTemplate& level = *this->level;
+        const TileIndex* grid = level.tileData();
+        for (int r=r_start; r<=r_end; r++) {
+            for (int c=c_start; c<=c_end; c++) {
+                const PaletteEntry& entry = level.palette[grid[r * level.cols + c]];
+                if (level.type_masks[(unsigned char)entry.type_id] & types)
+                    visit(td::Tile(entry.sprite_id, entry.type_id, r, c));  // Collision!
+            }
+        }
+    }
+
+    /**
+     * @brief Call a function for each enemy that may overlap a bounding box, found through the map's spatial grid.
+     * Every enemy that overlaps the box is visited, along with a few nearby ones, so test the exact shape in the
+     * function. Enemies are visited in the order they are stored in the map.
+     * Enemies moved by td::Map::moveEnemies are tracked by the grid, by the box each one swept over its last move;
+     * after moving an enemy any other way, call td::Map::getEnemies so that the grid is rebuilt.
+     * @param bounds The bounding box to look around.
+     * @param visit A function taking a td::Enemy*.
+     */
+    template <typename Visitor>
+    void Map::forEachEnemyNear(const sf::FloatRect& bounds, Visitor&& visit) const {
+        this->syncEnemyGrid();
+        this->grid_candidates.clear();
+        this->enemy_grid.query(bounds, this->grid_candidates);
+        std::sort(this->grid_candidates.begin(), this->grid_candidates.end());
+        for (std::uint32_t id : this->grid_candidates) visit(this->enemies[id]);
+    }
+
+    /**
+     * @brief Call a function for each item that may overlap a bounding box, found through the map's spatial grid.
+     * Like td::Map::forEachEnemyNear. Obtained items are visited too.
+     * @param bounds The bounding box to look around.
+     * @param visit A function taking a td::Item*.
+     */
+    template <typename Visitor>
+    void Map::forEachItemNear(const sf::FloatRect& bounds, Visitor&& visit) const {
+        this->syncItemGrid();
+        this->grid_candidates.clear();
+        this->item_grid.query(bounds, this->grid_candidates);
+        std::sort(this->grid_candidates.begin(), this->grid_candidates.end());
+        for (std::uint32_t id : this->grid_candidates) visit(this->items[id]);
+    }
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class MappedFile
+     * @brief A read-only memory mapping of a whole file, released when the object is destroyed.
+     * Uses mmap on POSIX systems and MapViewOfFile on Windows.
+     */
+    class MappedFile {
+    private:
+        const void* address{};
+        std::size_t length{};
+    public:
+        // Constructor/destructor
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Getters
+        const void* data() const;
+        std::size_t size() const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class MapFile
+     * @brief Reads and writes compiled .tdmap level files.
+     * A compiled map is a header followed by fixed-layout sections: the palette, the 256-entry tile type mask table,
+     * the contiguous tile grid, checkpoints, entity definitions, waypoints, a string table, and sprite definitions.
+     * Loading maps the file into memory and points the level template at the tile section, so no per-tile parsing
+     * is done. All values are stored little-endian. Compiled maps are produced (and validated) by the tdmapc tool.
+     */
+    class MapFile {
+    public:
+        static const std::uint32_t VERSION = 2;
+
+        /**
+         * @struct Header
+         * @brief The fixed-size header at the start of every .tdmap file. Offsets are in bytes from the file start.
+         */
+        struct Header {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t header_size;
+            std::uint32_t file_size;
+            std::int32_t rows;
+            std::int32_t cols;
+            std::int32_t tile_size;
+            std::int32_t player_start_row;
+            std::int32_t player_start_col;
+            std::uint32_t palette_offset;
+            std::uint32_t palette_count;
+            std::uint32_t type_masks_offset;
+            std::uint32_t tiles_offset;
+            std::uint32_t checkpoints_offset;
+            std::uint32_t checkpoint_count;
+            std::uint32_t entities_offset;
+            std::uint32_t entity_count;
+            std::uint32_t waypoints_offset;
+            std::uint32_t waypoint_count;
+            std::uint32_t strings_offset;
+            std::uint32_t strings_size;
+            std::uint32_t sprites_offset;
+            std::uint32_t sprite_count;
+        };
+
+        static void write(const td::LevelTemplate& level, const std::string& path);
+        static std::shared_ptr<const td::LevelTemplate> load(const std::string& path);
+        static std::vector<std::string> validate(const std::string& txt_path, const td::LevelTemplate& types);
+        static bool isCompiled(const std::string& path);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class LevelManifest
+     * @brief A level described in a text file that sits alongside the map file: which map file to use, the tile size
+     * and tile types, the sprite sheet, the checkpoint order, and the level's enemies and items.
+     * The manifest is parsed once into the same compact tables that td::LevelTemplate stores, and is read by
+     * td::Map::readMap for paths ending in .level. See the Game2 README for the format.
+     */
+    class LevelManifest {
+    private:
+        td::LevelTemplate::EntityDef enemy_defaults;
+        td::LevelTemplate::EntityDef item_defaults;
+        void parse(const std::string& path, const std::string& prefix, int depth);
+        void parseEntity(const std::vector<std::string>& words, std::size_t i, const std::string& prefix,
+                         const std::string& where, td::LevelTemplate::EntityDef& entity, bool defaults);
+        std::uint32_t addString(const std::string& str);
+    public:
+        // Constructor/destructor
+        explicit LevelManifest(const std::string& path);
+        ~LevelManifest();
+
+        // Parsed tables. Paths are relative to base_dir, the manifest's directory
+        std::string tiles;
+        int tile_size{};
+        std::vector<std::pair<int, std::vector<char>>> tile_types;
+        std::vector<int> checkpoint_order;
+        std::vector<td::LevelTemplate::SpriteDef> sprites;
+        std::vector<td::LevelTemplate::EntityDef> entities;
+        std::vector<sf::Vector2f> waypoints;
+        std::vector<std::string> strings;
+        std::string base_dir;
+
+        static bool isManifest(const std::string& path);
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class World
+     * @brief A very large map streamed from disk in fixed-size chunks.
+     * The world is compiled by tdmapc into a small .tdworld index plus one .tdmap file per chunk. A background
+     * thread maps chunk files into memory, and update() keeps the chunks within a radius of the given focus points
+     * (the camera or players) resident, evicting the rest. Each resident chunk is a td::Map with its own enemies and
+     * items, created from the chunk's entity definitions when the chunk arrives and deleted when it is evicted,
+     * so memory stays bounded by the radius rather than the world size.
+     * Each chunk's map works in its own local coordinates, with (0, 0) at the chunk's origin.
+     * A float can not hold a pixel position far from the world's corner precisely, so locations are kept as a
+     * td::World::Position instead: a chunk plus a small offset within it. Pixel positions passed to and returned by
+     * the world (view centers, focus points, bounding boxes) are relative to a floating origin chunk, which the game
+     * moves along with the camera using rebase(), so the numbers that reach SFML always stay small.
+     * Rows and columns are world rows and columns.
+     */
+    class World {
+    public:
+        static const std::uint32_t VERSION = 1;
+
+        /**
+         * @struct Header
+         * @brief The contents of a .tdworld index file.
+         */
+        struct Header {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t header_size;
+            std::int32_t rows;
+            std::int32_t cols;
+            std::int32_t chunk_size;
+            std::int32_t tile_size;
+            std::int32_t player_start_row;
+            std::int32_t player_start_col;
+        };
+
+        /**
+         * @struct Stats
+         * @brief Streaming statistics. Latency is measured from a chunk being requested to it becoming resident.
+         */
+        struct Stats {
+            std::size_t resident_chunks{};
+            std::size_t pending_chunks{};
+            std::size_t resident_entities{};
+            std::size_t chunks_loaded{};
+            std::size_t chunks_evicted{};
+            float last_load_ms{};
+            float average_load_ms{};
+            float max_load_ms{};
+        };
+
+        /**
+         * @struct Position
+         * @brief A location in the world: the chunk it is in, plus its offset in pixels from that chunk's origin.
+         * A normalized position has an offset within [0, chunk size in pixels).
+         */
+        struct Position {
+            int chunk_row{};
+            int chunk_col{};
+            sf::Vector2f offset;
+        };
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // A chunk that finished loading on the loader thread, waiting to be made resident by update()
+        struct LoadedChunk {
+            int key{};
+            std::shared_ptr<const td::LevelTemplate> level;
+            std::string error;
+        };
+
+        // World layout, from the index file
+        std::string path;
+        Header header{};
+        int chunk_rows{};
+        int chunk_cols{};
+
+        // Floating origin: the chunk that pixel positions are relative to
+        int origin_row{};
+        int origin_col{};
+
+        // Streaming settings
+        int radius{};
+        td::SpriteSheet sprite_sheet;
+
+        // Resident chunks by key (chunk_row * chunk_cols + chunk_col), and requested chunks with their request time
+        std::map<int, std::unique_ptr<td::Map>> chunks;
+        std::map<int, Clock::time_point> requested;
+
+        // Loader thread. The queue and finished list are shared with it and guarded by the mutex
+        std::thread loader;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::deque<int> queue;
+        std::vector<LoadedChunk> finished;
+        bool loading{};
+        bool stopping{};
+        void loaderLoop();
+
+        // Statistics
+        Stats stats;
+        double total_load_ms{};
+
+        // Walls gathered for td::World::move
+        mutable std::vector<sf::FloatRect> sweep_candidates;
+
+        // Helpers
+        static std::string getChunkPath(const std::string& world_path, int chunk_row, int chunk_col);
+        void integrateFinished();
+        void makeResident(LoadedChunk& loaded);
+        std::map<int, std::unique_ptr<td::Map>>::iterator evict(std::map<int, std::unique_ptr<td::Map>>::iterator it);
+        void drawChunks(sf::RenderTarget* target, void (td::Map::*drawLayer)(sf::RenderTarget*), bool cull);
+    public:
+        // Constructor/destructor
+        explicit World(const std::string& path);
+        ~World();
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        // Compile
+        static void write(const td::LevelTemplate& level, int chunk_size, const std::string& path);
+
+        // Coordinates
+        Position normalize(Position position) const;
+        Position toPosition(const sf::Vector2f& point) const;
+        sf::Vector2f toPixels(const Position& position) const;
+        Position getTilePosition(int row, int col) const;
+        void rebase(const Position& camera);
+        void setOrigin(int chunk_row, int chunk_col);
+        sf::Vector2i getOrigin() const;
+
+        // Streaming
+        void update(const std::vector<Position>& focus_points);
+        void update(const Position& focus_point);
+        void update(const std::vector<sf::Vector2f>& focus_points);
+        void update(const sf::Vector2f& focus_point);
+        void finishLoading();
+        void setRadius(int chunks);
+        void setSpriteSheet(const td::SpriteSheet& sheet);
+
+        // Render
+        void draw(sf::RenderTarget* target);
+        void drawEnemies(sf::RenderTarget* target);
+        void drawItems(sf::RenderTarget* target);
+
+        // Enemies
+        void moveEnemies(float elapsed);
+
+        // Getters
+        Stats getStats() const;
+        int getTileSize() const;
+        int getChunkSize() const;
+        sf::Vector2i getMapSize(bool rows_cols = false) const;
+        td::Tile getPlayerStartTile() const;
+        sf::Vector2f getChunkOrigin(int chunk_row, int chunk_col) const;
+        td::Map* getChunk(int chunk_row, int chunk_col) const;
+        bool isLoaded(int row, int col) const;
+        td::Tile getTileAt(int row, int col) const;
+
+        // Collision
+        bool collides(td::Map::TileMask types, const sf::FloatRect& bounds) const;
+        bool collides(td::Map::TileMask types, const Position& position, const sf::Vector2f& size) const;
+        Position move(const Position& position, const sf::Vector2f& size, const sf::Vector2f& delta,
+                      td::Map::TileMask walls) const;
     };
     //------------------------------------------------------------------------------------------------------------------
 
@@ -363,22 +1512,27 @@ namespace td {
 
         // Color/texture
         sf::Color color;
-        sf::Texture* texture;
+        std::shared_ptr<sf::Texture> texture;  // Loaded by setTexture(file), and shared with copies of the object
         sf::Texture* CPTexture;
 
-        // Map
-        td::Map map;
+        // Map. Not owned: the object refers to the level instance it is placed on
+        const td::Map* map;
 
         // Render
         sf::RectangleShape drawable;
         sf::RectangleShape CPdrawable;
 
+        // Collision mask, and the texture file it was built from so that it can follow the object's size
+        std::shared_ptr<const td::CollisionMask> collision_mask;
+        std::string mask_file;
+
     public:
         RenderObject();
         ~RenderObject();
 
         // Map
         virtual void setMap(td::Map& m);
+        const td::Map* getMap() const;
 
         // Position
         sf::Vector2f getPosition(bool center=false) const;
@@ -391,11 +1545,19 @@ namespace td {
         virtual void drawFileImage(sf::RenderTarget* target, int x, int y, const std::string& file);
         void setColor(sf::Color c);
         void setTexture(const std::string& file);
+        void setTexture(const sf::Texture& shared_texture);
         void setCPTexture(const std::string& file);
 
         // Size
         td::Util::size getSize() const;
+        td::AABB getBounds() const;
         void setSize(int w, int h, bool center_in_tile = false);
+
+        // Collision mask
+        void setCollisionMask(const std::string& file);
+        void setCollisionMask(std::shared_ptr<const td::CollisionMask> mask);
+        const td::CollisionMask* getCollisionMask() const;
+        bool touchesPixels(const td::RenderObject& other) const;
     };
 
     //------------------------------------------------------------------------------------------------------------------
@@ -416,9 +1578,15 @@ namespace td {
         // Gameplay
         std::vector<td::Item*> inventory;
         td::Tile checkpoint;
+
+        // Streamed world. Not owned. When set, the player's position is kept in chunk-relative coordinates
+        td::World* world;
+        td::World::Position world_position;
     protected:
         // Movement
         float speed;
+        sf::Vector2f move_start;  // The position before and after the last call to move
+        sf::Vector2f move_end;
 
         // Gameplay
         int health;
@@ -430,20 +1598,28 @@ namespace td {
 
         // Map
         void setMap(td::Map& m) override;
+        void setWorld(td::World& w, const td::World::Position& position);
+        const td::World::Position& getWorldPosition() const;
 
         // Movement
         virtual void move(float elapsed);
         void setMovementKeys(sf::Keyboard::Key up, sf::Keyboard::Key left, sf::Keyboard::Key down,
                              sf::Keyboard::Key right);
         void setMoveSpeed(float move_speed);
+        sf::Vector2f getLastMove() const;
+        sf::FloatRect getSweptBounds() const;
 
         // Position
         void spawn();
         void respawn();
 
+        // Render
+        void draw(sf::RenderTarget* target) override;
+
         // Checkpoints
         bool onCheckpoint();
         void setCheckpoint();
+        void setCheckpoint(const td::Tile& tile);
         td::Tile getCheckpoint();
 
         // End tiles
@@ -454,6 +1630,10 @@ namespace td {
         std::vector<td::Enemy*> getTouchingEnemies();
         bool isTouchingCircleEnemy();
         std::vector<td::Enemy*> getTouchingCircleEnemies();
+        float getCircleEnemyContactTime();
+        std::vector<td::Enemy*> getSweptCircleEnemies();
+        bool isTouchingPixelEnemy();
+        std::vector<td::Enemy*> getTouchingPixelEnemies();
 
         // Item interaction
         bool isTouchingItem();
@@ -461,7 +1641,7 @@ namespace td {
         void obtainItem(td::Item* item);
 
         // Inventory
-        std::vector<td::Item*> getInventory();
+        const std::vector<td::Item*>& getInventory() const;
         void clearInventory();
         void resetInventory();
 
@@ -550,6 +1730,175 @@ namespace td {
         bool isCommitted() const;
         void setCommitted(bool item_committed);
     };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class ContactManifold
+     * @brief Everything a player touches, gathered in one pass per tick: tiles of the types being listened for,
+     * enemies, and un-obtained items. Each update is compared with the one before, and listeners are called for the
+     * contacts that began (ENTER), went on (STAY), or ended (EXIT), so that game code doesn't have to poll for each
+     * kind of contact separately.
+     */
+    class ContactManifold {
+    public:
+        /**
+         * @enum Phase
+         * @brief Whether a contact began this tick, went on from the last one, or ended. Combine them with | to
+         * listen for several.
+         */
+        enum Phase {
+            ENTER = 1,
+            STAY = 2,
+            EXIT = 4
+        };
+        /**
+         * @enum EnemyShape
+         * @brief How enemies are tested against the player: by bounding box, as circles, as circles swept along
+         * the last moves (see td::Player::getSweptCircleEnemies), or by the solid pixels of their textures
+         * (see td::Player::getTouchingPixelEnemies).
+         */
+        enum EnemyShape {
+            BOXES = 1,
+            CIRCLES = 2,
+            SWEPT_CIRCLES = 3,
+            PIXELS = 4
+        };
+        /**
+         * @struct Contact
+         * @brief One thing the player touches: a tile, an enemy, or an item. The pointers of the other kinds are null.
+         */
+        struct Contact {
+            td::Tile tile;
+            td::Map::TileMask tile_types{};  // The types of the tile, or 0 if the contact is not a tile
+            td::Enemy* enemy{};
+            td::Item* item{};
+        };
+        typedef std::function<void(const Contact& contact, Phase phase)> Listener;
+    private:
+        enum Kind {
+            TILE = 0,
+            ENEMY = 1,
+            ITEM = 2
+        };
+        /**
+         * @struct Entry
+         * @brief A contact and the key it is sorted and matched by: its kind, then the tile's position and type_id or
+         * the entity's address.
+         */
+        struct Entry {
+            int kind{};
+            std::uint64_t key{};
+            Contact contact;
+        };
+        /**
+         * @struct Subscription
+         * @brief A listener and the contacts it listens for.
+         */
+        struct Subscription {
+            int id{};
+            int kind{};
+            int phases{};
+            td::Map::TileMask types{};
+            Listener listener;
+        };
+
+        EnemyShape enemy_shape{BOXES};
+        std::vector<Entry> contacts;
+        std::vector<Entry> previous;
+        std::vector<Subscription> subscriptions;
+        int next_listener_id{};
+
+        int addListener(int kind, int phases, td::Map::TileMask types, Listener listener);
+        void dispatch(const Entry& entry, Phase phase) const;
+    public:
+        // Listeners
+        int addTileListener(int phases, td::Map::TileMask types, Listener listener);
+        int addEnemyListener(int phases, Listener listener);
+        int addItemListener(int phases, Listener listener);
+        void removeListener(int id);
+
+        // Contacts
+        void setEnemyShape(EnemyShape shape);
+        void update(td::Player& player);
+        void clear();
+        std::size_t size() const;
+    };
+    //------------------------------------------------------------------------------------------------------------------
+
+    /**
+     * @class TileTriggers
+     * @brief Calls listeners when an entity starts or stops overlapping trigger tiles, such as checkpoints, the end,
+     * doors, and keys. Any td::RenderObject can be tracked: the player, enemies, or items.
+     * The range of tiles each entity overlaps is cached, so updating an entity that is still within the same tiles
+     * costs a few integer compares. The tiles themselves are only looked at again when the range changes, or when the
+     * map's tiles do.
+     */
+    class TileTriggers {
+    public:
+        /**
+         * @enum Phase
+         * @brief Whether an entity started or stopped overlapping a tile. Combine them with | to listen for both.
+         */
+        enum Phase {
+            ENTER = 1,
+            EXIT = 2
+        };
+        typedef std::function<void(td::RenderObject& entity, const td::Tile& tile, Phase phase)> Listener;
+    private:
+        /**
+         * @struct Trigger
+         * @brief A listener and the tiles it listens for.
+         */
+        struct Trigger {
+            int id{};
+            int phases{};
+            td::Map::TileMask types{};
+            Listener listener;
+        };
+        /**
+         * @struct Hit
+         * @brief A trigger tile overlapped by an entity, with the tile's types as they were when it was found.
+         */
+        struct Hit {
+            td::Tile tile;
+            td::Map::TileMask types{};
+        };
+        /**
+         * @struct Occupant
+         * @brief What is cached for each entity: the map and range of tiles it overlapped at its last update, and
+         * the trigger tiles in that range, row by row.
+         */
+        struct Occupant {
+            const td::Map* map{};
+            std::uint32_t tile_revision{};
+            std::uint32_t trigger_revision{};
+            int r_start{};
+            int c_start{};
+            int r_end{-1};
+            int c_end{-1};
+            std::vector<Hit> hits;
+        };
+
+        std::vector<Trigger> triggers;
+        td::Map::TileMask trigger_types{};  // All the types listened for
+        std::uint32_t trigger_revision{};  // Changed along with the triggers, so that every entity is looked at again
+        std::unordered_map<const td::RenderObject*, Occupant> occupants;
+        std::vector<Hit> found;
+        int next_trigger_id{};
+
+        void dispatch(td::RenderObject& entity, const Hit& hit, Phase phase) const;
+    public:
+        // Triggers
+        int addTrigger(int phases, td::Map::TileMask types, Listener listener);
+        void removeTrigger(int id);
+
+        // Entities
+        bool update(td::RenderObject& entity);
+        bool touches(const td::RenderObject& entity, td::Map::TileMask types) const;
+        void forget(const td::RenderObject& entity);
+        void clear();
+        std::size_t size() const;
+    };
 }
 
 #endif //ENGINE_LIBRARY_HPP
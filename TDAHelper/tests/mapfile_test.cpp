@@ -0,0 +1,149 @@
+/**
+ * @file mapfile_test.cpp
+ * @brief Tests for loading compiled .tdmap files. A small map is compiled with td::MapFile::write, then copies of
+ * it with single header fields corrupted are loaded from memory through td::Embedded, and each must be rejected
+ * with std::invalid_argument rather than loaded. Level manifests that name a compiled map must apply their tile
+ * size and tile types to it, just as they do to a text map.
+ *
+ * Exits with status 1 if any check fails.
+ */
+
+#include "library.hpp"
+#include <deque>
+
+static int failures = 0;
+
+/**
+ * @brief Report a check that failed.
+ * @param ok Whether the check passed.
+ * @param what What was checked.
+ */
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    std::cerr << "FAILED: " << what << std::endl;
+    failures++;
+}
+
+/**
+ * @brief Make a file available to the loaders under a path, without writing it to disk.
+ * @param path The path the file is loaded from.
+ * @param bytes The file's contents.
+ */
+static void mountFile(const std::string& path, const std::string& bytes) {
+    // Mounted files must stay put for the rest of the run
+    static std::deque<std::string> paths;
+    static std::deque<std::string> contents;
+    static std::deque<td::EmbeddedFile> files;
+    paths.push_back(path);
+    contents.push_back(bytes);
+    files.push_back({paths.back().c_str(), (const unsigned char*)contents.back().data(), contents.back().size()});
+    td::Embedded::mount(&files.back(), 1);
+}
+
+/**
+ * @brief Compile a map to the .tdmap format.
+ * @param txt_path The path of the map's text file.
+ * @return The compiled file's contents.
+ */
+static std::string compile(const std::string& txt_path) {
+    td::Map map(txt_path);
+    const std::string path = "mapfile_test.tdmap";
+    td::MapFile::write(*map.getLevel(), path);
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(path.c_str());
+    return bytes;
+}
+
+/**
+ * @brief Check whether a compiled map loads.
+ * @param path The path of the compiled map.
+ * @return Boolean. True = loaded, False = rejected with std::invalid_argument.
+ */
+static bool loads(const std::string& path) {
+    try {
+        td::MapFile::load(path);
+        return true;
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+}
+
+/**
+ * @brief Mount a copy of a compiled map with its header changed, and check that it is rejected.
+ * @param valid The valid compiled map.
+ * @param name A name for the case.
+ * @param corrupt Changes the header.
+ */
+template <typename Corrupt>
+static void checkRejected(const std::string& valid, const std::string& name, Corrupt&& corrupt) {
+    td::MapFile::Header header{};
+    std::memcpy(&header, valid.data(), sizeof(header));
+    corrupt(header);
+    std::string bytes = valid;
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    std::string path = "mapfile_test/" + name + ".tdmap";
+    mountFile(path, bytes);
+    check(!loads(path), "a map with " + name + " is rejected");
+}
+
+/**
+ * @brief Check that a level manifest's tile size and tile types were applied to its map.
+ * @param manifest_path The path of the level manifest.
+ */
+static void checkManifestApplied(const std::string& manifest_path) {
+    td::Map map(manifest_path);
+    const std::string name = "the manifest at " + manifest_path;
+    check(map.getTileSize() == 32, name + " sets the tile size");
+    check(map.isType('#', td::Map::TileTypes::WALL), name + " sets the wall tiles");
+    check(map.getPlayerStartTile().row == 3 && map.getPlayerStartTile().col == 4, name + " sets the start tile");
+    check(map.checkpointList.size() == 1 && map.checkpointList[0] == sf::Vector2f(2, 2),
+          name + " sets the checkpoints");
+}
+
+int main() {
+    // A 4 x 6 map with its start tile in the last row
+    mountFile("mapfile_test/map.txt", "wwwwwwwwwwww\n"
+                                      "ww        ww\n"
+                                      "ww  cc    ww\n"
+                                      "wwwwwwwwssww\n");
+    std::string valid = compile("mapfile_test/map.txt");
+    mountFile("mapfile_test/valid.tdmap", valid);
+    check(loads("mapfile_test/valid.tdmap"), "a valid map loads");
+    check(td::Map("mapfile_test/valid.tdmap").getPlayerStartTile().row == 3, "the start tile survives compiling");
+
+    // Tile sizes that the tile lookups would divide by
+    checkRejected(valid, "a zero tile size", [](td::MapFile::Header& h) { h.tile_size = 0; });
+    checkRejected(valid, "a negative tile size", [](td::MapFile::Header& h) { h.tile_size = -20; });
+
+    // Start tiles outside of the grid
+    checkRejected(valid, "the start row past the last row", [](td::MapFile::Header& h) {
+        h.player_start_row = h.rows;
+    });
+    checkRejected(valid, "a negative start row", [](td::MapFile::Header& h) { h.player_start_row = -1; });
+    checkRejected(valid, "the start column past the last column", [](td::MapFile::Header& h) {
+        h.player_start_col = h.cols;
+    });
+    checkRejected(valid, "a negative start column", [](td::MapFile::Header& h) { h.player_start_col = -1; });
+
+    // A map whose tile types only make sense with its manifest's. Compiled with the default types, it has no
+    // walls, start tile or checkpoints
+    mountFile("mapfile_test/custom.txt", "x#x#x#x#x#x#\n"
+                                         "x#        x#\n"
+                                         "x#  xC    x#\n"
+                                         "x#x#x#x#xSx#\n");
+    mountFile("mapfile_test/custom.tdmap", compile("mapfile_test/custom.txt"));
+    const std::string settings = "tile_size 32\n"
+                                 "type WALL #\n"
+                                 "type START S\n"
+                                 "type CHECKPOINT C\n";
+    mountFile("mapfile_test/text.level", "tiles custom.txt\n" + settings);
+    mountFile("mapfile_test/compiled.level", "tiles custom.tdmap\n" + settings);
+    checkManifestApplied("mapfile_test/text.level");
+    checkManifestApplied("mapfile_test/compiled.level");
+
+    if (failures > 0) return 1;
+    std::cout << "mapfile_test: all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * @file tdbench.cpp
+ * @brief Microbenchmarks for TDAHelper.
+ *
+ * contacts: Times testing a player's bounding box against many circle and rectangle enemies, one at a time and as a
+ * batch with td::Util::intersects, and reports the throughput of each in enemies per microsecond. The batch results
+ * are checked against the one-at-a-time results.
+ *
+ * views: Times a frame's worth of reads of the tiles, tile types, enemies, and inventory, once through the copying
+ * accessors (td::Map::getMap, td::Map::getEnemies, and copies of getTileType and getInventory) and once through the
+ * views and references (td::Map::getGrid, getRow, getEnemyView, and getTileType and getInventory by const&).
+ * Reports the time and the heap allocations per frame of each. The results of the two are checked against each other.
+ * Allocations are counted by replacing the global operator new, so on platforms where TDAHelper is a DLL with its own
+ * allocator, the copies made inside the library are not counted.
+ *
+ * rays: Times line of sight from many points to one, one ray at a time and as a batch with td::Map::lineOfSight,
+ * which splits batches past td::Map::PARALLEL_RAYS between the threads of td::WorkerPool::shared. Also times
+ * handing a batch to threads, by starting and joining threads for every batch and by waking a td::WorkerPool, and
+ * reports how many rays each costs, as a check that PARALLEL_RAYS amortizes it.
+ *
+ * Usage: tdbench [options]
+ *   --mode <name>         contacts, views, or rays. Defaults to contacts
+ *   --count <n>           Number of enemies, or of rays. Defaults to 10000
+ *
+ * Exits with status 1 if the two ways of doing the work give different results, or if the view frame allocates.
+ */
+
+#include "library.hpp"
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+// Heap allocations made since the program started, counted by the replaced global operator new below
+static std::atomic<std::size_t> allocations(0);
+
+void* operator new(std::size_t size) {
+    allocations++;
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Print the usage message.
+ */
+static void usage() {
+    std::cerr << "Usage: tdbench [--mode contacts|views|rays] [--count <n>]" << std::endl;
+}
+
+/**
+ * @brief Run a test over and over for at least 200 ms, and measure how fast it goes.
+ * @param count How many items of work one run of the test covers.
+ * @param test The test to run.
+ * @return The throughput, in items per microsecond.
+ */
+template <typename Test>
+static double throughput(std::size_t count, Test&& test) {
+    std::size_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::micro> elapsed(0);
+    while (elapsed.count() < 200000) {
+        test();
+        runs++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return (double)(runs * count) / elapsed.count();
+}
+
+/**
+ * @brief Time the enemy contact tests, one at a time and as a batch.
+ * @param count Number of enemies.
+ * @return The exit status. 1 = the batch results differ from the one-at-a-time results.
+ */
+static int benchContacts(std::size_t count) {
+    // Enemies spread over a 40 x 40 tile area around the player, about one in twenty touching it
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-400, 400);
+    std::uniform_real_distribution<float> size(8, 24);
+    td::AABB player(-40, -40, 40, 40);
+    td::Util::Circles circles;
+    td::Util::Rects rects;
+    for (std::size_t i=0; i<count; i++) {
+        float width = size(random);
+        sf::Vector2f corner(position(random), position(random));
+        circles.add(td::Circle(corner + sf::Vector2f(width/2, width/2), width/2));
+        rects.add(sf::FloatRect(corner, sf::Vector2f(width, size(random))));
+    }
+
+    // One at a time
+    std::vector<std::uint64_t> circle_hits;
+    std::vector<std::uint64_t> rect_hits;
+    auto testCircles = [&]() {
+        circle_hits.assign((count + 63) / 64, 0);
+        for (std::size_t i=0; i<count; i++) {
+            if (td::Util::intersects(td::Circle(td::Vec2(circles.x[i], circles.y[i]), circles.radius[i]), player))
+                circle_hits[i/64] |= (std::uint64_t)1 << (i % 64);
+        }
+    };
+    auto testRects = [&]() {
+        rect_hits.assign((count + 63) / 64, 0);
+        for (std::size_t i=0; i<count; i++) {
+            if (player.intersects(td::AABB(rects.left[i], rects.top[i], rects.right[i], rects.bottom[i])))
+                rect_hits[i/64] |= (std::uint64_t)1 << (i % 64);
+        }
+    };
+    double circle_single = throughput(count, testCircles);
+    double rect_single = throughput(count, testRects);
+
+    // As a batch
+    std::vector<std::uint64_t> batch_circle_hits;
+    std::vector<std::uint64_t> batch_rect_hits;
+    double circle_batch = throughput(count, [&]() { td::Util::intersects(circles, player, batch_circle_hits); });
+    double rect_batch = throughput(count, [&]() { td::Util::intersects(rects, player, batch_rect_hits); });
+
+    std::size_t touching = 0;
+    for (std::uint64_t word : circle_hits) touching += (std::size_t)std::bitset<64>(word).count();
+    std::cout << count << " enemies, " << touching << " circles touching, batch instructions: "
+              << td::Util::batchInstructionSet() << std::endl;
+    std::cout << "  circles:    one at a time " << circle_single << " /us, batched " << circle_batch << " /us ("
+              << circle_batch / circle_single << "x)" << std::endl;
+    std::cout << "  rectangles: one at a time " << rect_single << " /us, batched " << rect_batch << " /us ("
+              << rect_batch / rect_single << "x)" << std::endl;
+
+    if (batch_circle_hits != circle_hits || batch_rect_hits != rect_hits) {
+        std::cerr << "tdbench: batched results differ from one at a time" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Load a square map with a wall around the edge and a wall every eighth tile, embedded so no file is needed.
+ * Only called once per run, since each run benchmarks one mode.
+ * @param map The map to load into.
+ * @param size The map's width and height, in tiles.
+ */
+static void loadMap(td::Map& map, int size) {
+    static std::string tiles;
+    for (int r=0; r<size; r++) {
+        for (int c=0; c<size; c++) {
+            bool wall = r == 0 || c == 0 || r == size-1 || c == size-1 || (r % 8 == 0 && c % 8 == 0);
+            tiles += wall ? "#w" : ". ";
+        }
+        tiles += '\n';
+    }
+    static const td::EmbeddedFile files[] = {{"tdbench/map.txt", (const unsigned char*)tiles.data(), tiles.size()}};
+    td::Embedded::mount(files);
+    map.setTileType(td::Map::TileTypes::WALL, {'w'});
+    map.readMap("tdbench/map.txt");
+}
+
+/**
+ * @brief Time reading the tiles, tile types, enemies, and inventory through the copying accessors and through the
+ * views, and count the heap allocations each makes per frame.
+ * @param count Number of enemies.
+ * @return The exit status. 1 = the results differ, or the view frame allocates.
+ */
+static int benchViews(std::size_t count) {
+    const int size = 64;
+    td::Map map;
+    loadMap(map, size);
+
+    // Enemies spread over the map, and a player holding a few items
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, (float)(size * map.getTileSize()));
+    std::vector<td::Enemy> enemies;
+    enemies.reserve(count);
+    for (std::size_t i=0; i<count; i++) {
+        enemies.emplace_back(map, 16, 16, sf::Color::Red, 1);
+        enemies.back().setStartPosition(position(random), position(random));
+        map.addEnemy(&enemies.back());
+    }
+    std::vector<td::Item> items(8, td::Item(map, 16, 16, sf::Color::Yellow));
+    td::Player player;
+    player.setMap(map);
+    for (auto& item : items) player.obtainItem(&item);
+
+    // What a frame reads: the wall tiles, the enemies' positions, and the inventory
+    double copy_sum = 0;
+    auto copyingFrame = [&]() {
+        std::vector<std::vector<td::Tile>> grid = map.getMap();
+        std::vector<char> walls = map.getTileType(td::Map::TileTypes::WALL);
+        std::size_t wall_count = 0;
+        for (const auto& row : grid) {
+            for (const auto& tile : row) wall_count += std::count(walls.begin(), walls.end(), tile.type_id) > 0;
+        }
+        std::vector<td::Enemy*> frame_enemies = *map.getEnemies();
+        float x = 0;
+        for (auto enemy : frame_enemies) x += enemy->getPosition().x;
+        std::vector<td::Item*> inventory = player.getInventory();
+        copy_sum = (double)wall_count + x + (double)inventory.size();
+    };
+    double view_sum = 0;
+    auto viewFrame = [&]() {
+        const std::vector<char>& walls = map.getTileType(td::Map::TileTypes::WALL);
+        td::View<td::Map::PaletteEntry> palette = map.getPalette();
+        std::size_t wall_count = 0;
+        for (int r=0; r<size; r++) {
+            for (td::Map::TileIndex tile : map.getRow(r)) {
+                wall_count += std::count(walls.begin(), walls.end(), palette[tile].type_id) > 0;
+            }
+        }
+        float x = 0;
+        for (auto enemy : map.getEnemyView()) x += enemy->getPosition().x;
+        const std::vector<td::Item*>& inventory = player.getInventory();
+        view_sum = (double)wall_count + x + (double)inventory.size();
+    };
+
+    // Allocations per frame, then time per frame
+    const std::size_t frames = 100;
+    std::size_t before = allocations;
+    for (std::size_t i=0; i<frames; i++) copyingFrame();
+    double copy_allocations = (double)(allocations - before) / frames;
+    before = allocations;
+    for (std::size_t i=0; i<frames; i++) viewFrame();
+    double view_allocations = (double)(allocations - before) / frames;
+    double copy_rate = throughput(1, copyingFrame);
+    double view_rate = throughput(1, viewFrame);
+
+    std::cout << size << " x " << size << " tiles, " << count << " enemies, " << items.size() << " items" << std::endl;
+    std::cout << "  copying accessors: " << 1 / copy_rate << " us per frame, " << copy_allocations
+              << " allocations per frame" << std::endl;
+    std::cout << "  views:             " << 1 / view_rate << " us per frame, " << view_allocations
+              << " allocations per frame (" << view_rate / copy_rate << "x)" << std::endl;
+
+    if (copy_sum != view_sum) {
+        std::cerr << "tdbench: view results differ from copying results" << std::endl;
+        return 1;
+    }
+    if (view_allocations > 0) {
+        std::cerr << "tdbench: the view frame allocates" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Time line of sight tests one ray at a time and as a batch, and time handing a batch to threads.
+ * @param count Number of rays.
+ * @return The exit status. 1 = the batch results differ from the one-at-a-time results.
+ */
+static int benchRays(std::size_t count) {
+    const int size = 64;
+    td::Map map;
+    loadMap(map, size);
+
+    // Rays from points spread over the map to its center, about half of them blocked by the walls
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, (float)(size * map.getTileSize()));
+    std::vector<sf::Vector2f> from;
+    for (std::size_t i=0; i<count; i++) from.emplace_back(position(random), position(random));
+    sf::Vector2f to((float)(size * map.getTileSize()) / 2, (float)(size * map.getTileSize()) / 2);
+    td::Map::TileMask walls = td::Map::mask(td::Map::TileTypes::WALL);
+
+    std::vector<std::uint64_t> single_visible;
+    double single = throughput(count, [&]() {
+        single_visible.assign((count + 63) / 64, 0);
+        for (std::size_t i=0; i<count; i++) {
+            if (map.lineOfSight(walls, from[i], to)) single_visible[i/64] |= (std::uint64_t)1 << (i % 64);
+        }
+    });
+    std::vector<std::uint64_t> batch_visible;
+    double batch = throughput(count, [&]() { map.lineOfSight(walls, from, to, batch_visible); });
+
+    // Handing an empty batch to as many threads as a real one would use, with at least one worker
+    std::size_t workers = std::max<std::size_t>(1, td::WorkerPool::shared().getWorkerCount());
+    double spawn = throughput(1, [&]() {
+        std::vector<std::thread> threads;
+        for (std::size_t i=0; i<workers; i++) threads.emplace_back([]() {});
+        for (auto& thread : threads) thread.join();
+    });
+    td::WorkerPool pool(workers);
+    double wake = throughput(1, [&]() { pool.run(workers + 1, [](std::size_t) {}); });
+
+    std::size_t clear = 0;
+    for (std::uint64_t word : single_visible) clear += (std::size_t)std::bitset<64>(word).count();
+    std::cout << count << " rays, " << clear << " clear, " << td::WorkerPool::shared().getWorkerCount()
+              << " shared workers, batches split past " << td::Map::PARALLEL_RAYS << " rays" << std::endl;
+    std::cout << "  rays: one at a time " << single << " /us, batched " << batch << " /us ("
+              << batch / single << "x)" << std::endl;
+    std::cout << "  handing a batch to " << workers << " threads: starting threads " << 1 / spawn
+              << " us (" << single / spawn << " rays), waking a worker pool " << 1 / wake << " us ("
+              << single / wake << " rays)" << std::endl;
+
+    if (batch_visible != single_visible) {
+        std::cerr << "tdbench: batched results differ from one at a time" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = 10000;
+    std::string mode = "contacts";
+
+    // Read in the options
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i+1 < argc) {
+            int n = std::atoi(argv[++i]);
+            if (n <= 0) {
+                usage();
+                return 1;
+            }
+            count = (std::size_t)n;
+        } else if (arg == "--mode" && i+1 < argc) {
+            mode = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (mode == "contacts") return benchContacts(count);
+    if (mode == "views") return benchViews(count);
+    if (mode == "rays") return benchRays(count);
+    usage();
+    return 1;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file tdmapc.cpp
+ * @brief The TDAHelper map compiler. Validates map txt files and compiles them to the binary .tdmap format.
+ * Level manifests (.level) are compiled too, along with their sprites and entity definitions. A manifest's own
+ * tile size and tile types take precedence over the options below.
+ *
+ * Usage: tdmapc [options] <map.txt|level.level>...
+ *   -o <path>             Output path. Only allowed with a single input. Defaults to the input path with .tdmap
+ *   --tile-size <n>       Tile size to store in the compiled map
+ *   --chunk-size <n>      Compile a streaming world instead: a .tdworld index plus one .tdmap per n x n chunk
+ *   --type <type>=<ids>   Map type_id chars to a tile type before reading, e.g. --type WALL=# or --type 7=xz
+ *   --check               Validate only, do not write anything. Reports how well the tiles merge into rectangles
+ *   --time                Load each compiled map back and report how long loading took
+ *
+ * Exits with status 1 if any map fails to validate or compile.
+ */
+
+#include "library.hpp"
+#include <chrono>
+
+/**
+ * @brief Print the usage message.
+ */
+static void usage() {
+    std::cerr << "Usage: tdmapc [-o <path>] [--tile-size <n>] [--chunk-size <n>] [--type <type>=<ids>]... [--check] "
+                 "[--time] <map.txt|level.level>..." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> inputs;
+    std::string output;
+    int tile_size = 0;
+    int chunk_size = 0;
+    std::vector<std::pair<int, std::vector<char>>> types;
+    bool check_only = false;
+    bool time_load = false;
+
+    // Read in the options
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-o" || arg == "--tile-size" || arg == "--chunk-size" || arg == "--type") && i+1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (arg == "-o") {
+            output = argv[++i];
+        } else if (arg == "--tile-size") {
+            tile_size = std::atoi(argv[++i]);
+        } else if (arg == "--chunk-size") {
+            chunk_size = std::atoi(argv[++i]);
+            if (chunk_size <= 0) {
+                usage();
+                return 1;
+            }
+        } else if (arg == "--type") {
+            std::string spec = argv[++i];
+            std::size_t eq = spec.find('=');
+            int type = eq == std::string::npos ? -1 : td::Map::tileTypeFromName(spec.substr(0, eq));
+            if (type < 0) {
+                std::cerr << "tdmapc: bad tile type mapping '" << spec << "'" << std::endl;
+                return 1;
+            }
+            types.emplace_back(type, std::vector<char>(spec.begin() + (long)eq + 1, spec.end()));
+        } else if (arg == "--check") {
+            check_only = true;
+        } else if (arg == "--time") {
+            time_load = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty() || (!output.empty() && inputs.size() > 1)) {
+        usage();
+        return 1;
+    }
+
+    int failures = 0;
+    for (const std::string& input : inputs) {
+        // Set up the tile types first, since start tiles and checkpoints are found while reading
+        td::Map map;
+        if (tile_size > 0) map.setTileSize(tile_size);
+        for (const auto& type : types) map.setTileType(type.first, type.second);
+
+        // Manifests are checked as they are read, below
+        if (!td::LevelManifest::isManifest(input)) {
+            std::vector<std::string> problems = td::MapFile::validate(input, *map.getLevel());
+            for (const std::string& problem : problems) std::cerr << problem << std::endl;
+            if (!problems.empty()) {
+                failures++;
+                continue;
+            }
+        }
+
+        std::string path = output;
+        if (path.empty()) {
+            std::size_t dot = input.find_last_of('.');
+            std::size_t slash = input.find_last_of("/\\");
+            bool has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+            path = (has_extension ? input.substr(0, dot) : input) + (chunk_size > 0 ? ".tdworld" : ".tdmap");
+        }
+        try {
+            map.readMap(input);
+            if (check_only) {
+                std::cout << input << ": " << map.getMergedRectCount() << " merged rectangles, merge ratio "
+                          << map.getMergeRatio() << std::endl;
+                continue;
+            }
+            sf::Vector2i size = map.getMapSize(true);
+            if (chunk_size > 0) {
+                td::World::write(*map.getLevel(), chunk_size, path);
+                std::cout << input << " -> " << path << " (" << size.x << " x " << size.y << " tiles in "
+                          << chunk_size << " x " << chunk_size << " chunks)" << std::endl;
+                continue;
+            }
+            td::MapFile::write(*map.getLevel(), path);
+            std::cout << input << " -> " << path << " (" << size.x << " x " << size.y << " tiles, "
+                      << map.getPalette().size() << " palette entries, " << map.getMergedRectCount()
+                      << " merged rectangles, merge ratio " << map.getMergeRatio() << ")" << std::endl;
+
+            if (time_load) {
+                auto start = std::chrono::steady_clock::now();
+                std::shared_ptr<const td::LevelTemplate> level = td::MapFile::load(path);
+                auto end = std::chrono::steady_clock::now();
+                std::cout << "  loaded in " << std::chrono::duration<double, std::milli>(end - start).count()
+                          << " ms" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << input << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}